@@ -0,0 +1,160 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "arena.h"
+
+#define ARENA_BLOCK_SIZE (1024 * 1024)
+#define ARENA_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define ARENA_ALIGNMENT _Alignof(max_align_t)
+
+struct ArenaBlock {
+    ArenaBlock *previous;
+    size_t mapping_length;
+    size_t capacity;
+    size_t used;
+    _Alignas(max_align_t) char data[];
+};
+
+Arena arena_new(bool huge_pages) { return (Arena){.huge_pages = huge_pages}; }
+
+void *arena_map(size_t length, size_t alignment) {
+    size_t slack = alignment > ARENA_BLOCK_SIZE ? alignment : 0;
+
+    char *mapping = mmap(NULL, length + slack, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (mapping == MAP_FAILED) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    if (slack == 0) {
+        return mapping;
+    }
+
+    // Trim the mapping so it starts on the requested alignment, otherwise
+    // the kernel cannot back it with huge pages
+    char *start =
+        (char *)(((uintptr_t)mapping + alignment - 1) & ~(alignment - 1));
+
+    if (start != mapping) {
+        munmap(mapping, start - mapping);
+    }
+
+    if (start + length != mapping + length + slack) {
+        munmap(start + length, mapping + length + slack - (start + length));
+    }
+
+    return start;
+}
+
+ArenaBlock *arena_new_block(Arena *arena, size_t minimum_capacity) {
+    size_t granularity =
+        arena->huge_pages ? ARENA_HUGE_PAGE_SIZE : ARENA_BLOCK_SIZE;
+
+    size_t mapping_length = sizeof(ArenaBlock) + minimum_capacity;
+    mapping_length =
+        (mapping_length + granularity - 1) / granularity * granularity;
+
+    ArenaBlock *block = arena_map(mapping_length, granularity);
+
+    if (arena->huge_pages) {
+        madvise(block, mapping_length, MADV_HUGEPAGE);
+    }
+
+    block->previous = arena->current;
+    block->mapping_length = mapping_length;
+    block->capacity = mapping_length - sizeof(ArenaBlock);
+    block->used = 0;
+
+    arena->current = block;
+
+    return block;
+}
+
+void *arena_alloc_aligned(Arena *arena, size_t size, size_t alignment) {
+    ArenaBlock *block = arena->current;
+
+    if (block != NULL) {
+        size_t start = (block->used + alignment - 1) & ~(alignment - 1);
+
+        if (start + size <= block->capacity) {
+            block->used = start + size;
+
+            return &block->data[start];
+        }
+    }
+
+    block = arena_new_block(arena, size);
+    block->used = size;
+
+    return block->data;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    return arena_alloc_aligned(arena, size, ARENA_ALIGNMENT);
+}
+
+void *arena_realloc(Arena *arena, void *old, size_t old_size, size_t new_size) {
+    ArenaBlock *block = arena->current;
+
+    // The most recent allocation can grow in place while its block has room
+    if (old != NULL && block != NULL &&
+        (char *)old + old_size == &block->data[block->used] &&
+        (char *)old + new_size <= &block->data[block->capacity]) {
+        block->used = (char *)old + new_size - block->data;
+
+        return old;
+    }
+
+    void *new = arena_alloc(arena, new_size);
+
+    if (old != NULL) {
+        memcpy(new, old, old_size < new_size ? old_size : new_size);
+    }
+
+    return new;
+}
+
+void *arena_memdup(Arena *arena, const void *p, size_t n) {
+    return memcpy(arena_alloc(arena, n), p, n);
+}
+
+char *arena_strndup(Arena *arena, const char *s, size_t n) {
+    char *d = arena_alloc_aligned(arena, n + 1, 1);
+
+    memcpy(d, s, n);
+    d[n] = '\0';
+
+    return d;
+}
+
+ArenaCheckpoint arena_checkpoint(Arena *arena) {
+    return (ArenaCheckpoint){
+        .block = arena->current,
+        .used = arena->current != NULL ? arena->current->used : 0,
+    };
+}
+
+void arena_rollback(Arena *arena, ArenaCheckpoint checkpoint) {
+    while (arena->current != checkpoint.block) {
+        ArenaBlock *previous = arena->current->previous;
+
+        munmap(arena->current, arena->current->mapping_length);
+
+        arena->current = previous;
+    }
+
+    if (arena->current != NULL) {
+        arena->current->used = checkpoint.used;
+    }
+}
+
+void arena_free(Arena *arena) {
+    arena_rollback(arena, (ArenaCheckpoint){0});
+}
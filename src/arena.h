@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct ArenaBlock ArenaBlock;
+
+// Bump-pointer allocator, everything allocated from an arena is released at
+// once by arena_free (or back to a checkpoint by arena_rollback)
+typedef struct {
+    ArenaBlock *current;
+    bool huge_pages;
+} Arena;
+
+typedef struct {
+    ArenaBlock *block;
+    size_t used;
+} ArenaCheckpoint;
+
+Arena arena_new(bool huge_pages);
+void *arena_alloc(Arena *arena, size_t size);
+void *arena_realloc(Arena *arena, void *old, size_t old_size, size_t new_size);
+void *arena_memdup(Arena *arena, const void *p, size_t n);
+char *arena_strndup(Arena *arena, const char *s, size_t n);
+ArenaCheckpoint arena_checkpoint(Arena *arena);
+void arena_rollback(Arena *arena, ArenaCheckpoint checkpoint);
+void arena_free(Arena *arena);
+
+#define arena_da_append(arena, da, item)                                       \
+    do {                                                                       \
+        if ((da)->count >= (da)->capacity) {                                   \
+            size_t old_capacity = (da)->capacity;                              \
+            (da)->capacity = old_capacity == 0 ? 2 : old_capacity * 2;         \
+            (da)->items = arena_realloc(                                       \
+                (arena), (da)->items, old_capacity * sizeof(*(da)->items),     \
+                (da)->capacity * sizeof(*(da)->items));                        \
+        }                                                                      \
+                                                                               \
+        (da)->items[(da)->count++] = (item);                                   \
+    } while (0)
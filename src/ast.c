@@ -0,0 +1,87 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "arena.h"
+#include "ast.h"
+
+ASTRoot ast_new(Arena *arena) { return (ASTRoot){.arena = arena}; }
+
+#define ast_grow_column(arena, pool, column, old_capacity)                     \
+    (pool)->column = arena_realloc(                                            \
+        (arena), (pool)->column, (old_capacity) * sizeof(*(pool)->column),     \
+        (pool)->capacity * sizeof(*(pool)->column))
+
+#define ast_grow_columns_1(arena, pool, old_capacity, a)                       \
+    ast_grow_column(arena, pool, a, old_capacity)
+
+#define ast_grow_columns_2(arena, pool, old_capacity, a, b)                    \
+    ast_grow_column(arena, pool, a, old_capacity);                             \
+    ast_grow_column(arena, pool, b, old_capacity)
+
+#define ast_grow_columns_select(_1, _2, name, ...) name
+
+#define ast_grow_columns(arena, pool, old_capacity, ...)                       \
+    ast_grow_columns_select(__VA_ARGS__, ast_grow_columns_2,                   \
+                            ast_grow_columns_1)(arena, pool, old_capacity,     \
+                                                __VA_ARGS__)
+
+#define ast_grow_pool(arena, pool, ...)                                        \
+    do {                                                                       \
+        if ((pool)->count >= (pool)->capacity) {                               \
+            size_t old_capacity = (pool)->capacity;                            \
+            (pool)->capacity = old_capacity == 0 ? 16 : old_capacity * 2;      \
+            ast_grow_column(arena, pool, kinds, old_capacity);                 \
+            ast_grow_column(arena, pool, locs, old_capacity);                  \
+            ast_grow_columns(arena, pool, old_capacity, __VA_ARGS__);          \
+        }                                                                      \
+    } while (0)
+
+ASTIndex ast_add_expr(ASTRoot *root, ASTExprKind kind, SourceLoc loc,
+                      ASTExprValue value) {
+    ASTExprs *exprs = &root->exprs;
+
+    ast_grow_pool(root->arena, exprs, values, types);
+
+    exprs->kinds[exprs->count] = kind;
+    exprs->locs[exprs->count] = loc;
+    exprs->values[exprs->count] = value;
+    exprs->types[exprs->count] = TY_VOID;
+
+    return exprs->count++;
+}
+
+ASTIndex ast_add_stmt(ASTRoot *root, ASTStmtKind kind, SourceLoc loc,
+                      ASTStmtValue value) {
+    ASTStmts *stmts = &root->stmts;
+
+    ast_grow_pool(root->arena, stmts, values);
+
+    stmts->kinds[stmts->count] = kind;
+    stmts->locs[stmts->count] = loc;
+    stmts->values[stmts->count] = value;
+
+    return stmts->count++;
+}
+
+ASTIndex ast_add_declaration(ASTRoot *root, ASTDeclarationKind kind,
+                             SourceLoc loc, ASTIndex index) {
+    ASTDeclarations *declarations = &root->declarations;
+
+    ast_grow_pool(root->arena, declarations, indices);
+
+    declarations->kinds[declarations->count] = kind;
+    declarations->locs[declarations->count] = loc;
+    declarations->indices[declarations->count] = index;
+
+    return declarations->count++;
+}
+
+ASTRange ast_add_extra(ASTRoot *root, const ASTIndex *items, size_t count) {
+    ASTRange range = {.start = root->extra.count, .count = count};
+
+    for (size_t i = 0; i < count; i++) {
+        arena_da_append(root->arena, &root->extra, items[i]);
+    }
+
+    return range;
+}
@@ -2,24 +2,44 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
+#include "arena.h"
+#include "interner.h"
 #include "type.h"
 
-typedef struct {
-    size_t line;
-    size_t column;
-} SourceLoc;
+// Byte offset into the source buffer, resolved to a line and column only when
+// a diagnostic is reported
+typedef uint32_t SourceLoc;
 
 typedef struct {
-    char *buffer;
+    Atom atom;
     SourceLoc loc;
 } Name;
 
-typedef struct ASTExpr ASTExpr;
+// Declarations are numbered by sema in the order they are declared, so later
+// stages can keep per-declaration data in flat arrays
+typedef uint32_t SymbolId;
+
+#define SYMBOL_ID_NONE UINT32_MAX
+
+// Nodes live in per-kind pools owned by the ASTRoot and refer to each other by
+// 32-bit indices into those pools, AST_NONE marks an absent node
+typedef uint32_t ASTIndex;
+
+#define AST_NONE UINT32_MAX
 
 typedef struct {
-    Name name;
-} ASTIdentifier;
+    ASTIndex *items;
+    size_t count;
+    size_t capacity;
+} ASTIndices;
+
+// A run of consecutive entries in one of the pools of the root
+typedef struct {
+    ASTIndex start;
+    uint32_t count;
+} ASTRange;
 
 typedef enum {
     UO_MINUS,
@@ -28,7 +48,7 @@ typedef enum {
 
 typedef struct {
     ASTUnaryOperator unary_operator;
-    ASTExpr *rhs;
+    ASTIndex rhs;
 } ASTUnaryOperation;
 
 typedef enum {
@@ -36,32 +56,39 @@ typedef enum {
     BO_MINUS,
     BO_STAR,
     BO_FORWARD_SLASH,
+    BO_PERCENT,
 } ASTBinaryOperator;
 
 typedef struct {
-    ASTExpr *lhs;
+    ASTIndex lhs;
+    ASTIndex rhs;
     ASTBinaryOperator binary_operator;
-    ASTExpr *rhs;
 } ASTBinaryOperation;
 
 typedef struct {
-    ASTExpr *items;
-    size_t count;
-    size_t capacity;
-} ASTExprs;
+    ASTIndex callable;
+    ASTRange arguments; // Expression indices in extra
+} ASTCall;
 
 typedef struct {
-    ASTExpr *callable;
-    ASTExprs arguments;
-} ASTCall;
+    Name name;
+    SymbolId symbol; // Resolved by sema
+} ASTIdentifier;
 
+// Implicit conversion inserted by sema, converts the operand to the type of
+// the cast expression
 typedef struct {
+    ASTIndex operand;
+} ASTCast;
+
+typedef union {
     unsigned long long intval;
-    long double floatval;
+    double floatval;
     ASTIdentifier identifier;
     ASTUnaryOperation unary;
     ASTBinaryOperation binary;
     ASTCall call;
+    ASTCast cast;
 } ASTExprValue;
 
 typedef enum {
@@ -71,26 +98,31 @@ typedef enum {
     EK_UNARY_OPERATION,
     EK_BINARY_OPERATION,
     EK_CALL,
+    EK_CAST,
 } ASTExprKind;
 
-struct ASTExpr {
-    ASTExprValue value;
-    ASTExprKind kind;
-    SourceLoc loc;
-};
-
 typedef struct {
-    ASTExpr value;
-    bool none;
-} ASTReturn;
+    uint8_t *kinds;
+    SourceLoc *locs;
+    ASTExprValue *values;
+    TypeId *types; // Computed by sema
+    size_t count;
+    size_t capacity;
+} ASTExprs;
 
 typedef struct {
-    Type type;
+    TypeId type;
     Name name;
-    ASTExpr value;
-    bool default_initialized;
+    ASTIndex value; // AST_NONE when default initialized
+    SymbolId symbol;
 } ASTVariable;
 
+typedef struct {
+    ASTVariable *items;
+    size_t count;
+    size_t capacity;
+} ASTVariables;
+
 typedef enum {
     SK_RETURN,
     SK_VARIABLE_DECLARATION,
@@ -98,52 +130,53 @@ typedef enum {
 } ASTStmtKind;
 
 typedef union {
-    ASTReturn ret;
-    ASTVariable variable_declaration;
-    ASTExpr expr;
+    ASTIndex ret; // Expression returned, AST_NONE when returning nothing
+    ASTIndex variable_declaration;
+    ASTIndex expr;
 } ASTStmtValue;
 
 typedef struct {
-    ASTStmtValue value;
-    ASTStmtKind kind;
-    SourceLoc loc;
-} ASTStmt;
-
-typedef struct {
-    ASTStmt *items;
+    uint8_t *kinds;
+    SourceLoc *locs;
+    ASTStmtValue *values;
     size_t count;
     size_t capacity;
 } ASTStmts;
 
 typedef struct {
-    Type expected_type;
+    TypeId expected_type;
     Name name;
+    SymbolId symbol;
 } ASTFunctionParameter;
 
 typedef struct {
     ASTFunctionParameter *items;
     size_t count;
     size_t capacity;
-
-    bool variadic;
 } ASTFunctionParameters;
 
 typedef struct {
-    Type return_type;
+    TypeId return_type;
     Name name;
-    ASTFunctionParameters parameters;
+    ASTRange parameters;
+    bool variadic;
     bool definition;
+
+    // Set by sema, redeclarations of a function share its symbol
+    TypeId type;
+    SymbolId symbol;
 } ASTFunctionPrototype;
 
 typedef struct {
     ASTFunctionPrototype prototype;
-    ASTStmts body;
+    ASTRange body; // Statement indices in extra
 } ASTFunction;
 
-typedef union {
-    ASTFunction function;
-    ASTVariable variable;
-} ASTDeclarationValue;
+typedef struct {
+    ASTFunction *items;
+    size_t count;
+    size_t capacity;
+} ASTFunctions;
 
 typedef enum {
     DK_FUNCTION,
@@ -151,17 +184,35 @@ typedef enum {
 } ASTDeclarationKind;
 
 typedef struct {
-    ASTDeclarationValue value;
-    ASTDeclarationKind kind;
-    SourceLoc loc;
-} ASTDeclaration;
-
-typedef struct {
-    ASTDeclaration *items;
+    uint8_t *kinds;
+    SourceLoc *locs;
+    ASTIndex *indices; // Into functions or variables depending on the kind
     size_t count;
     size_t capacity;
 } ASTDeclarations;
 
 typedef struct {
+    Arena *arena;
+
+    ASTExprs exprs;
+    ASTStmts stmts;
+    ASTVariables variables;
+    ASTFunctionParameters parameters;
+    ASTFunctions functions;
     ASTDeclarations declarations;
+
+    // Variable length lists of node indices (call arguments, function bodies)
+    ASTIndices extra;
+
+    // Number of symbols numbered by sema
+    SymbolId symbol_count;
 } ASTRoot;
+
+ASTRoot ast_new(Arena *arena);
+ASTIndex ast_add_expr(ASTRoot *root, ASTExprKind kind, SourceLoc loc,
+                      ASTExprValue value);
+ASTIndex ast_add_stmt(ASTRoot *root, ASTStmtKind kind, SourceLoc loc,
+                      ASTStmtValue value);
+ASTIndex ast_add_declaration(ASTRoot *root, ASTDeclarationKind kind,
+                             SourceLoc loc, ASTIndex index);
+ASTRange ast_add_extra(ASTRoot *root, const ASTIndex *items, size_t count);
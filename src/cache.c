@@ -0,0 +1,561 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <llvm-c/Core.h>
+#include <llvm-c/TargetMachine.h>
+#include <llvm/Config/llvm-config.h>
+
+#include "cache.h"
+#include "compile_options.h"
+#include "dynamic_array.h"
+#include "hash.h"
+#include "input_file.h"
+
+#define CACHE_DEFAULT_MAX_SIZE (1024ull * 1024 * 1024)
+
+// Eviction goes below the limit, so it does not run again on the next store
+#define CACHE_EVICTION_TARGET(max_size) ((max_size) / 10 * 9)
+
+// Kept in directory/stats, read and written under an flock of the file
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stores;
+    uint64_t evictions;
+    uint64_t size;
+} CacheStats;
+
+typedef struct {
+    char *path;
+    uint64_t size;
+    struct timespec mtime;
+} CacheEntry;
+
+typedef struct {
+    CacheEntry *items;
+    size_t count;
+    size_t capacity;
+} CacheEntries;
+
+static char *cache_format(const char *format, const char *a, const char *b) {
+    size_t length = snprintf(NULL, 0, format, a, b) + 1;
+    char *text = malloc(length);
+
+    if (text == NULL) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    snprintf(text, length, format, a, b);
+
+    return text;
+}
+
+static bool cache_make_directories(char *path) {
+    for (char *slash = strchr(path + 1, '/'); slash != NULL;
+         slash = strchr(slash + 1, '/')) {
+        *slash = '\0';
+
+        bool made = mkdir(path, 0777) == 0 || errno == EEXIST;
+
+        *slash = '/';
+
+        if (!made) {
+            return false;
+        }
+    }
+
+    return mkdir(path, 0777) == 0 || errno == EEXIST;
+}
+
+static uint64_t cache_parse_size(const char *text) {
+    char *end;
+    uint64_t size = strtoull(text, &end, 10);
+
+    switch (*end) {
+    case 'K':
+    case 'k':
+        return size << 10;
+
+    case 'M':
+    case 'm':
+        return size << 20;
+
+    case 'G':
+    case 'g':
+        return size << 30;
+
+    default:
+        return size;
+    }
+}
+
+bool cache_open(Cache *cache) {
+    const char *directory = getenv("YCC_CACHE_DIR");
+    const char *xdg_cache_home = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+
+    if (directory != NULL && directory[0] != '\0') {
+        cache->directory = strdup(directory);
+    } else if (xdg_cache_home != NULL && xdg_cache_home[0] != '\0') {
+        cache->directory = cache_format("%s%s", xdg_cache_home, "/ycc");
+    } else if (home != NULL && home[0] != '\0') {
+        cache->directory = cache_format("%s%s", home, "/.cache/ycc");
+    } else {
+        return false;
+    }
+
+    atomic_init(&cache->hits, 0);
+    atomic_init(&cache->misses, 0);
+
+    const char *max_size = getenv("YCC_CACHE_SIZE");
+
+    cache->max_size = max_size != NULL ? cache_parse_size(max_size)
+                                       : CACHE_DEFAULT_MAX_SIZE;
+
+    if (!cache_make_directories(cache->directory)) {
+        free(cache->directory);
+        return false;
+    }
+
+    return true;
+}
+
+// The executable stands for the compiler version, any rebuild of ycc changes
+// its inode, size or modification time and so misses every older entry
+static char cache_compiler[128];
+static pthread_once_t cache_compiler_once = PTHREAD_ONCE_INIT;
+
+static void cache_identify_compiler(void) {
+    struct stat exe_stat = {0};
+
+    stat("/proc/self/exe", &exe_stat);
+
+    snprintf(cache_compiler, sizeof(cache_compiler),
+             "ycc %lu %ld %ld.%09ld llvm " LLVM_VERSION_STRING,
+             (unsigned long)exe_stat.st_ino, (long)exe_stat.st_size,
+             (long)exe_stat.st_mtim.tv_sec, (long)exe_stat.st_mtim.tv_nsec);
+}
+
+// Everything besides the source that changes the output, -march=native is
+// resolved here since the same flag means different code on another host
+static char *cache_key_text(const InputFile *input_file,
+                            const CompileOptions *options) {
+    pthread_once(&cache_compiler_once, cache_identify_compiler);
+
+    char *host_cpu = NULL;
+    char *host_features = NULL;
+
+    const char *cpu = options->cpu != NULL ? options->cpu : "";
+    const char *features = "";
+
+    if (strcmp(cpu, "native") == 0) {
+        host_cpu = LLVMGetHostCPUName();
+        host_features = LLVMGetHostCPUFeatures();
+
+        cpu = host_cpu;
+        features = host_features;
+    }
+
+    const char *format = "%s\n%s\nwrapv=%d level=%d passes=%s output=%d "
+                         "shards=%u lto=%d\ntarget=%s cpu=%s features=%s "
+                         "mattr=%s";
+
+#define CACHE_KEY_ARGUMENTS                                                    \
+    cache_compiler, input_file->file_path, options->wrapv,                     \
+        options->optimization_level,                                           \
+        options->passes != NULL ? options->passes : "",                        \
+        options->output_kind, options->codegen_shards, options->lto,           \
+        options->target_triple != NULL ? options->target_triple : "", cpu,     \
+        features, options->features != NULL ? options->features : ""
+
+    size_t length = snprintf(NULL, 0, format, CACHE_KEY_ARGUMENTS) + 1;
+    char *text = malloc(length);
+
+    if (text == NULL) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    snprintf(text, length, format, CACHE_KEY_ARGUMENTS);
+
+#undef CACHE_KEY_ARGUMENTS
+
+    if (host_cpu != NULL) {
+        LLVMDisposeMessage(host_cpu);
+        LLVMDisposeMessage(host_features);
+    }
+
+    return text;
+}
+
+// Two passes with independent seeds give the 128 bits of the key
+CacheKey cache_key(const InputFile *input_file, const CompileOptions *options) {
+    char *text = cache_key_text(input_file, options);
+    size_t text_length = strlen(text);
+
+    uint64_t high = hash_bytes(input_file->file_content,
+                               input_file->file_length, 0x9e3779b97f4a7c15ull);
+    uint64_t low = hash_bytes(input_file->file_content,
+                              input_file->file_length, 0xc2b2ae3d27d4eb4full);
+
+    CacheKey key = {
+        .high = hash_bytes(text, text_length, high),
+        .low = hash_bytes(text, text_length, low),
+    };
+
+    free(text);
+
+    return key;
+}
+
+CacheKey cache_options_key(const InputFile *input_file,
+                           const CompileOptions *options) {
+    char *text = cache_key_text(input_file, options);
+    size_t text_length = strlen(text);
+
+    CacheKey key = {
+        .high = hash_bytes(text, text_length, 0x9e3779b97f4a7c15ull),
+        .low = hash_bytes(text, text_length, 0xc2b2ae3d27d4eb4full),
+    };
+
+    free(text);
+
+    return key;
+}
+
+// Entries are directory/xx/<32 hex digits of the key>, xx being the first two
+// digits, so no directory gets too large
+static char *cache_entry_path(const Cache *cache, CacheKey key) {
+    char digits[33];
+    char bucket[3];
+
+    snprintf(digits, sizeof(digits), "%016llx%016llx",
+             (unsigned long long)key.high, (unsigned long long)key.low);
+    snprintf(bucket, sizeof(bucket), "%.2s", digits);
+
+    char *bucket_path = cache_format("%s/%s", cache->directory, bucket);
+    char *path = cache_format("%s/%s", bucket_path, digits);
+
+    free(bucket_path);
+
+    return path;
+}
+
+static int cache_lock_stats(const Cache *cache, CacheStats *stats) {
+    char *path = cache_format("%s%s", cache->directory, "/stats");
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+    int error = errno;
+
+    free(path);
+
+    if (fd < 0) {
+        errno = error;
+        return -1;
+    }
+
+    int locked;
+
+    do {
+        locked = flock(fd, LOCK_EX);
+    } while (locked < 0 && errno == EINTR);
+
+    // The stats are not touched without the lock
+    if (locked < 0) {
+        error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+
+    *stats = (CacheStats){0};
+
+    if (pread(fd, stats, sizeof(*stats), 0) != sizeof(*stats)) {
+        *stats = (CacheStats){0};
+    }
+
+    return fd;
+}
+
+static void cache_unlock_stats(int fd, const CacheStats *stats) {
+    ssize_t count;
+
+    do {
+        count = pwrite(fd, stats, sizeof(*stats), 0);
+    } while (count < 0 && errno == EINTR);
+
+    if (count != sizeof(*stats)) {
+        fprintf(stderr, "warning: cannot write the cache statistics: %s\n",
+                count < 0 ? strerror(errno) : "short write");
+    }
+
+    // Closing the file releases the lock
+    close(fd);
+}
+
+static int cache_compare_entries(const void *a, const void *b) {
+    const CacheEntry *x = a;
+    const CacheEntry *y = b;
+
+    if (x->mtime.tv_sec != y->mtime.tv_sec) {
+        return x->mtime.tv_sec < y->mtime.tv_sec ? -1 : 1;
+    }
+
+    if (x->mtime.tv_nsec != y->mtime.tv_nsec) {
+        return x->mtime.tv_nsec < y->mtime.tv_nsec ? -1 : 1;
+    }
+
+    return strcmp(x->path, y->path);
+}
+
+static void cache_collect_entries(const Cache *cache, CacheEntries *entries) {
+    for (int bucket = 0; bucket < 256; bucket++) {
+        char bucket_name[3];
+        snprintf(bucket_name, sizeof(bucket_name), "%02x", bucket);
+
+        char *bucket_path = cache_format("%s/%s", cache->directory,
+                                         bucket_name);
+        DIR *directory = opendir(bucket_path);
+
+        if (directory == NULL) {
+            free(bucket_path);
+            continue;
+        }
+
+        struct dirent *dirent;
+
+        while ((dirent = readdir(directory)) != NULL) {
+            // Files being written are hidden until they are renamed
+            if (dirent->d_name[0] == '.') {
+                continue;
+            }
+
+            char *path = cache_format("%s/%s", bucket_path, dirent->d_name);
+            struct stat entry_stat;
+
+            if (stat(path, &entry_stat) < 0) {
+                free(path);
+                continue;
+            }
+
+            CacheEntry entry = {
+                .path = path,
+                .size = entry_stat.st_size,
+                .mtime = entry_stat.st_mtim,
+            };
+
+            da_append(entries, entry);
+        }
+
+        closedir(directory);
+        free(bucket_path);
+    }
+}
+
+static void cache_free_entries(CacheEntries *entries) {
+    for (size_t i = 0; i < entries->count; i++) {
+        free(entries->items[i].path);
+    }
+
+    da_free(*entries);
+}
+
+// Sets the size in the stats to what the entries take up, which only changes
+// behind the back of the stats when entries are removed by hand
+static void cache_recount(const Cache *cache, CacheStats *stats) {
+    CacheEntries entries = {0};
+
+    cache_collect_entries(cache, &entries);
+
+    stats->size = 0;
+
+    for (size_t i = 0; i < entries.count; i++) {
+        stats->size += entries.items[i].size;
+    }
+
+    cache_free_entries(&entries);
+}
+
+// Removes the least recently used entries, hits refresh the modification
+// time of an entry, the size in the stats is recounted while at it
+static void cache_evict(const Cache *cache, CacheStats *stats) {
+    CacheEntries entries = {0};
+
+    cache_collect_entries(cache, &entries);
+
+    qsort(entries.items, entries.count, sizeof(CacheEntry),
+          cache_compare_entries);
+
+    uint64_t size = 0;
+
+    for (size_t i = 0; i < entries.count; i++) {
+        size += entries.items[i].size;
+    }
+
+    for (size_t i = 0;
+         i < entries.count && size > CACHE_EVICTION_TARGET(cache->max_size);
+         i++) {
+        if (unlink(entries.items[i].path) == 0) {
+            size -= entries.items[i].size;
+            stats->evictions++;
+        }
+    }
+
+    stats->size = size;
+
+    cache_free_entries(&entries);
+}
+
+LLVMMemoryBufferRef cache_lookup(Cache *cache, CacheKey key) {
+    char *path = cache_entry_path(cache, key);
+
+    LLVMMemoryBufferRef output = NULL;
+    char *error = NULL;
+
+    if (LLVMCreateMemoryBufferWithContentsOfFile(path, &output, &error)) {
+        LLVMDisposeMessage(error);
+        output = NULL;
+    } else {
+        utimensat(AT_FDCWD, path, NULL, 0);
+    }
+
+    free(path);
+
+    atomic_fetch_add(output != NULL ? &cache->hits : &cache->misses, 1);
+
+    return output;
+}
+
+// The output is written to a hidden file which is renamed into place, so
+// concurrent lookups see either no entry or a complete one
+void cache_store(const Cache *cache, CacheKey key, LLVMMemoryBufferRef output) {
+    char *path = cache_entry_path(cache, key);
+
+    char *bucket_end = strrchr(path, '/');
+
+    *bucket_end = '\0';
+    mkdir(path, 0777);
+    char *temporary_path = cache_format("%s%s", path, "/.tmp-XXXXXX");
+    *bucket_end = '/';
+
+    int fd = mkstemp(temporary_path);
+
+    if (fd < 0) {
+        free(temporary_path);
+        free(path);
+        return;
+    }
+
+    const char *data = LLVMGetBufferStart(output);
+    size_t size = LLVMGetBufferSize(output);
+    size_t written = 0;
+
+    while (written < size) {
+        ssize_t count = write(fd, data + written, size - written);
+
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (count < 0) {
+            break;
+        }
+
+        written += count;
+    }
+
+    close(fd);
+
+    bool stored = written == size && rename(temporary_path, path) == 0;
+
+    if (!stored) {
+        unlink(temporary_path);
+    }
+
+    free(temporary_path);
+    free(path);
+
+    if (!stored) {
+        return;
+    }
+
+    CacheStats stats;
+    int stats_fd = cache_lock_stats(cache, &stats);
+
+    if (stats_fd < 0) {
+        return;
+    }
+
+    stats.stores++;
+    stats.size += size;
+
+    if (stats.size > cache->max_size) {
+        cache_evict(cache, &stats);
+    }
+
+    cache_unlock_stats(stats_fd, &stats);
+}
+
+bool cache_print_stats(const Cache *cache) {
+    CacheStats stats = {0};
+    int stats_fd = cache_lock_stats(cache, &stats);
+
+    if (stats_fd < 0) {
+        fprintf(stderr, "error: cannot read the cache statistics in '%s': %s\n",
+                cache->directory, strerror(errno));
+        return false;
+    }
+
+    // Entries removed by hand are only noticed by a recount, which leaves
+    // eviction to the next store
+    cache_recount(cache, &stats);
+    cache_unlock_stats(stats_fd, &stats);
+
+    uint64_t lookups = stats.hits + stats.misses;
+
+    printf("cache directory: %s\n", cache->directory);
+    printf("hits:            %llu\n", (unsigned long long)stats.hits);
+    printf("misses:          %llu\n", (unsigned long long)stats.misses);
+    printf("hit rate:        %.1f%%\n",
+           lookups == 0 ? 0.0 : 100.0 * stats.hits / lookups);
+    printf("stores:          %llu\n", (unsigned long long)stats.stores);
+    printf("evictions:       %llu\n", (unsigned long long)stats.evictions);
+    printf("size:            %.2f MiB of %.2f MiB\n",
+           stats.size / (1024.0 * 1024.0),
+           cache->max_size / (1024.0 * 1024.0));
+
+    return true;
+}
+
+void cache_close(Cache *cache) {
+    uint64_t hits = atomic_load(&cache->hits);
+    uint64_t misses = atomic_load(&cache->misses);
+
+    if (hits != 0 || misses != 0) {
+        CacheStats stats;
+        int stats_fd = cache_lock_stats(cache, &stats);
+
+        if (stats_fd >= 0) {
+            stats.hits += hits;
+            stats.misses += misses;
+
+            cache_unlock_stats(stats_fd, &stats);
+        }
+    }
+
+    free(cache->directory);
+
+    *cache = (Cache){0};
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <llvm-c/Types.h>
+
+#include "compile_options.h"
+#include "input_file.h"
+
+// Outputs of previous compilations addressed by a hash of everything they
+// depend on, shared by every ycc process using the same directory
+typedef struct {
+    char *directory;
+    uint64_t max_size;
+
+    // Lookups of this process, added to the shared stats by cache_close so
+    // hits never wait for the lock of the stats file
+    atomic_uint_least64_t hits;
+    atomic_uint_least64_t misses;
+} Cache;
+
+typedef struct {
+    uint64_t high;
+    uint64_t low;
+} CacheKey;
+
+// The directory is $YCC_CACHE_DIR, $XDG_CACHE_HOME/ycc or ~/.cache/ycc and
+// the size limit $YCC_CACHE_SIZE (a number of bytes with an optional K, M or G
+// suffix), returns false when there is no usable directory
+bool cache_open(Cache *cache);
+
+CacheKey cache_key(const InputFile *input_file, const CompileOptions *options);
+
+// Like cache_key but leaves out the source, it changes when the compiler, the
+// path or anything else besides the source changes the output
+CacheKey cache_options_key(const InputFile *input_file,
+                           const CompileOptions *options);
+
+// Returns NULL on a miss, never parses or initializes LLVM
+LLVMMemoryBufferRef cache_lookup(Cache *cache, CacheKey key);
+void cache_store(const Cache *cache, CacheKey key, LLVMMemoryBufferRef output);
+
+// Returns false when the stats cannot be read
+bool cache_print_stats(const Cache *cache);
+
+// Also adds the lookups of this process to the stats
+void cache_close(Cache *cache);
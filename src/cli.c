@@ -1,52 +1,225 @@
-#include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "cli.h"
 #include "dynamic_array.h"
-#include "dynamic_string.h"
+#include "input_file.h"
+#include "jobs.h"
 
-char *cli_read_file(const char *file_path) {
-    DynamicString file_content = {0};
+// Parses what follows -O, a bare -O is -O1 and levels above 3 are -O3
+static bool cli_parse_optimization_level(CLI *cli, const char *level) {
+    if (level[0] == '\0') {
+        cli->options.optimization_level = OL_O1;
+    } else if (strcmp(level, "s") == 0) {
+        cli->options.optimization_level = OL_OS;
+    } else if (strcmp(level, "z") == 0) {
+        cli->options.optimization_level = OL_OZ;
+    } else if (strspn(level, "0123456789") == strlen(level)) {
+        int number = atoi(level);
 
-    FILE *fd = fopen(file_path, "r");
+        cli->options.optimization_level = number > 3 ? OL_O3 : number;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+// Returns false when the argument is not a known option
+static bool cli_parse_option(CLI *cli, const char *argument) {
+    if (strcmp(argument, "-fwrapv") == 0) {
+        cli->options.wrapv = true;
+    } else if (strcmp(argument, "-fno-wrapv") == 0) {
+        cli->options.wrapv = false;
+    } else if (strcmp(argument, "-fcache") == 0) {
+        cli->options.cache = true;
+    } else if (strcmp(argument, "-fno-cache") == 0) {
+        cli->options.cache = false;
+    } else if (strcmp(argument, "-fincremental") == 0) {
+        cli->options.incremental = true;
+    } else if (strcmp(argument, "-fno-incremental") == 0) {
+        cli->options.incremental = false;
+    } else if (strcmp(argument, "--incremental-stats") == 0) {
+        cli->options.incremental_stats = true;
+    } else if (strcmp(argument, "-flto") == 0 ||
+               strcmp(argument, "-flto=full") == 0) {
+        cli->options.lto = LTO_FULL;
+    } else if (strcmp(argument, "-flto=thin") == 0) {
+        cli->options.lto = LTO_THIN;
+    } else if (strcmp(argument, "-fno-lto") == 0) {
+        cli->options.lto = LTO_NONE;
+    } else if (strncmp(argument, "-O", 2) == 0) {
+        return cli_parse_optimization_level(cli, argument + 2);
+    } else if (strncmp(argument, "-fpasses=", 9) == 0) {
+        cli->options.passes = argument + 9;
+    } else if (strncmp(argument, "-fcodegen-shards=", 17) == 0) {
+        int shards = atoi(argument + 17);
+
+        if (shards <= 0) {
+            return false;
+        }
 
-    if (fd == NULL) {
-        perror("error");
+        cli->options.codegen_shards = shards;
+    } else if (strncmp(argument, "--target=", 9) == 0) {
+        cli->options.target_triple = argument + 9;
+    } else if (strncmp(argument, "-march=", 7) == 0) {
+        cli->options.cpu = argument + 7;
+    } else if (strncmp(argument, "-mcpu=", 6) == 0) {
+        cli->options.cpu = argument + 6;
+    } else if (strncmp(argument, "-mattr=", 7) == 0) {
+        cli->options.features = argument + 7;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+// -c and -S pick between an object and assembly, -emit-llvm turns either into
+// its LLVM counterpart, as does -flto because code is only generated when
+// linking. -E stops after the preprocessor whatever else is given
+static OutputKind cli_output_kind(bool preprocess_only, bool compile_only,
+                                  bool assemble_only, bool emit_llvm,
+                                  bool lto) {
+    if (preprocess_only) {
+        return OK_PREPROCESSED;
+    }
+
+    emit_llvm = emit_llvm || ((compile_only || assemble_only) && lto);
+
+    if (assemble_only) {
+        return emit_llvm ? OK_LLVM_IR : OK_ASSEMBLY;
+    }
+
+    if (compile_only) {
+        return emit_llvm ? OK_LLVM_BITCODE : OK_OBJECT;
+    }
+
+    if (emit_llvm) {
+        fprintf(stderr, "error: -emit-llvm cannot be used when linking\n");
         exit(1);
     }
 
-    while (true) {
-        int ch = fgetc(fd);
+    return OK_EXECUTABLE;
+}
 
-        if (ferror(fd)) {
-            perror("error");
-            fclose(fd);
-            exit(1);
-        }
+static unsigned cli_parse_jobs(const char *jobs) {
+    if (jobs[0] == '\0' || strspn(jobs, "0123456789") != strlen(jobs) ||
+        atoi(jobs) == 0) {
+        fprintf(stderr, "error: invalid number of jobs '%s'\n", jobs);
+        exit(1);
+    }
 
-        if (ch == EOF) {
-            da_append(&file_content, '\0');
-            break;
-        } else {
-            da_append(&file_content, ch);
-        }
-    };
+    return atoi(jobs);
+}
+
+// The value of an option written either as '-Xvalue' or as '-X value'
+static const char *cli_option_value(int argc, const char **argv, int *i,
+                                    const char *missing) {
+    const char *value = argv[*i] + 2;
 
-    fclose(fd);
+    if (value[0] != '\0') {
+        return value;
+    }
 
-    return file_content.items;
+    if (*i + 1 == argc) {
+        fprintf(stderr, "error: missing %s after '%s'\n", missing, argv[*i]);
+        exit(1);
+    }
+
+    return argv[++*i];
 }
 
 CLI cli_parse(int argc, const char **argv) {
-    CLI cli = {.program_name = argv[0]};
+    CLI cli = {
+        .program_name = argv[0],
+        .options = {.cache = true,
+                    .jobs = jobs_default_thread_count(),
+                    .codegen_shards = 1},
+    };
+
+    int first_input = 0;
+    bool preprocess_only = false;
+    bool compile_only = false;
+    bool assemble_only = false;
+    bool emit_llvm = false;
 
     for (int i = 1; i < argc; i++) {
-        InputFile input_file = {.file_path = argv[i],
-                                .file_content = cli_read_file(argv[i])};
+        const char *argument = argv[i];
 
-        da_append(&cli.input_files, input_file);
+        // A lone '-' names the standard input
+        if (argument[0] != '-' || argument[1] == '\0') {
+            da_append(&cli.input_files, input_file_read(argument));
+
+            if (cli.input_files.count == 1) {
+                first_input = i;
+            }
+
+            if (cli.run) {
+                cli.run_argc = argc - i;
+                cli.run_argv = argv + i;
+                break;
+            }
+        } else if (strcmp(argument, "-o") == 0) {
+            if (i + 1 == argc) {
+                fprintf(stderr, "error: missing filename after '-o'\n");
+                exit(1);
+            }
+
+            cli.output_path = argv[++i];
+        } else if (strncmp(argument, "-o", 2) == 0) {
+            cli.output_path = argument + 2;
+        } else if (strcmp(argument, "-j") == 0) {
+            if (i + 1 == argc) {
+                fprintf(stderr, "error: missing number after '-j'\n");
+                exit(1);
+            }
+
+            cli.options.jobs = cli_parse_jobs(argv[++i]);
+        } else if (strncmp(argument, "-j", 2) == 0) {
+            cli.options.jobs = cli_parse_jobs(argument + 2);
+        } else if (strcmp(argument, "--cache-stats") == 0) {
+            cli.cache_stats = true;
+        } else if (strcmp(argument, "--dump-tokens") == 0) {
+            cli.dump_tokens = true;
+        } else if (strcmp(argument, "--run") == 0) {
+            cli.run = true;
+        } else if (strncmp(argument, "-I", 2) == 0) {
+            da_append(&cli.options.include_directories,
+                      cli_option_value(argc, argv, &i, "directory"));
+        } else if (strncmp(argument, "-D", 2) == 0 ||
+                   strncmp(argument, "-U", 2) == 0) {
+            CompileMacro macro = {
+                .definition = cli_option_value(argc, argv, &i, "macro name"),
+                .undefine = argument[1] == 'U',
+            };
+
+            da_append(&cli.options.macros, macro);
+        } else if (strcmp(argument, "-E") == 0) {
+            preprocess_only = true;
+        } else if (strcmp(argument, "-c") == 0) {
+            compile_only = true;
+        } else if (strcmp(argument, "-S") == 0) {
+            assemble_only = true;
+        } else if (strcmp(argument, "-emit-llvm") == 0) {
+            emit_llvm = true;
+        } else if (!cli_parse_option(&cli, argument)) {
+            fprintf(stderr, "error: unknown option '%s'\n", argument);
+            exit(1);
+        }
     }
 
+    // With --run after the input the program only gets its name
+    if (cli.run && cli.run_argv == NULL && first_input != 0) {
+        cli.run_argc = 1;
+        cli.run_argv = argv + first_input;
+    }
+
+    cli.options.output_kind =
+        cli_output_kind(preprocess_only, compile_only, assemble_only,
+                        emit_llvm, cli.options.lto != LTO_NONE);
+
     return cli;
 }
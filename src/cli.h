@@ -2,10 +2,8 @@
 
 #include <stddef.h>
 
-typedef struct {
-    const char *file_path;
-    char *file_content;
-} InputFile;
+#include "compile_options.h"
+#include "input_file.h"
 
 typedef struct {
     InputFile *items;
@@ -16,6 +14,21 @@ typedef struct {
 typedef struct {
     const char *program_name;
     InputFiles input_files;
+    CompileOptions options;
+
+    const char *output_path; // NULL when -o is not given
+
+    bool cache_stats; // --cache-stats prints the cache statistics and exits
+
+    // --dump-tokens prints the tokens the lexer produces for each input and
+    // exits, for checking the scanning kernels against each other
+    bool dump_tokens;
+
+    // --run executes the first input in memory, the arguments after it are
+    // the program's, starting with the input path as its argv[0]
+    bool run;
+    int run_argc;
+    const char **run_argv;
 } CLI;
 
 CLI cli_parse(int argc, const char **argv);
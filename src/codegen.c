@@ -7,493 +7,419 @@
 #include <llvm-c/Core.h>
 #include <llvm-c/Types.h>
 
+#include "arena.h"
 #include "ast.h"
 #include "codegen.h"
 #include "diagnostics.h"
-#include "dynamic_array.h"
-#include "memdup.h"
+#include "interner.h"
 #include "symbol_table.h"
 #include "type.h"
 
-CodeGen codegen_new(const char *source_file_path) {
-    LLVMModuleRef module = LLVMModuleCreateWithName(source_file_path);
+CodeGen codegen_new(Arena *arena, LLVMContextRef llvm_context,
+                    const char *source_file_path, const CompileOptions *options,
+                    const Target *target) {
+    LLVMModuleRef module =
+        LLVMModuleCreateWithNameInContext(source_file_path, llvm_context);
     LLVMSetSourceFileName(module, source_file_path, strlen(source_file_path));
+    LLVMSetTarget(module, target->triple);
 
-    LLVMBuilderRef builder = LLVMCreateBuilder();
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(llvm_context);
 
     return (CodeGen){
+        .arena = arena,
+        .options = options,
+        .target = target,
+        .llvm_context = llvm_context,
         .module = module,
         .builder = builder,
-        .symbol_table = symbol_table_new(),
     };
 }
 
-Type codegen_infer_type(CodeGen *gen, ASTExpr expr) {
-    Type type = {0};
+LLVMTypeRef codegen_get_llvm_type(CodeGen *gen, TypeId type);
 
-    switch (expr.kind) {
-    case EK_INT:
-        type.kind = TY_LONG_LONG;
-        break;
+static LLVMTypeRef codegen_lower_type(CodeGen *gen, TypeId type) {
+    // LLVM integers carry no signedness, it is picked per instruction
+    if (type_is_integer(type)) {
+        return LLVMIntTypeInContext(gen->llvm_context,
+                                    type_integer_bits(type));
+    }
 
-    case EK_FLOAT:
-        type.kind = TY_LONG_DOUBLE;
-        break;
+    switch (type_kind(type)) {
+    case TY_VOID:
+        return LLVMVoidTypeInContext(gen->llvm_context);
 
-    case EK_IDENTIFIER:
-        type =
-            symbol_table_lookup(&gen->symbol_table, expr.value.identifier.name)
-                .type;
-        break;
+    case TY_FLOAT:
+        return LLVMFloatTypeInContext(gen->llvm_context);
 
-    case EK_UNARY_OPERATION:
-        type = codegen_infer_type(gen, *expr.value.unary.rhs);
-        break;
+    case TY_DOUBLE:
+        return LLVMDoubleTypeInContext(gen->llvm_context);
 
-    case EK_BINARY_OPERATION: {
-        Type lhs_type = codegen_infer_type(gen, *expr.value.binary.lhs);
-        Type rhs_type = codegen_infer_type(gen, *expr.value.binary.rhs);
+    case TY_LONG_DOUBLE:
+        switch (type_target_layout.long_double) {
+        case TLD_X86_FP80:
+            return LLVMX86FP80TypeInContext(gen->llvm_context);
 
-        return lhs_type.kind > rhs_type.kind ? lhs_type : rhs_type;
-    }
+        case TLD_FP128:
+            return LLVMFP128TypeInContext(gen->llvm_context);
 
-    case EK_CALL: {
-        Type callable_type = codegen_infer_type(gen, *expr.value.call.callable);
+        case TLD_PPC_FP128:
+            return LLVMPPCFP128TypeInContext(gen->llvm_context);
 
-        if (callable_type.kind != TY_FUNCTION) {
-            errorf(expr.loc, "expected a callable");
+        default:
+            return LLVMDoubleTypeInContext(gen->llvm_context);
+        }
 
-            exit(1);
+    case TY_FUNCTION: {
+        const FunctionPrototype *prototype = &type_get(type)->prototype;
+
+        ArenaCheckpoint checkpoint = arena_checkpoint(gen->arena);
+
+        LLVMTypeRef *llvm_parameters = arena_alloc(
+            gen->arena, prototype->parameter_count * sizeof(LLVMTypeRef));
+
+        for (size_t i = 0; i < prototype->parameter_count; i++) {
+            llvm_parameters[i] =
+                codegen_get_llvm_type(gen, prototype->parameters[i]);
         }
 
-        type = *callable_type.data.prototype.return_type;
+        LLVMTypeRef llvm_type = LLVMFunctionType(
+            codegen_get_llvm_type(gen, prototype->return_type),
+            llvm_parameters, prototype->parameter_count, prototype->variadic);
 
-        break;
+        arena_rollback(gen->arena, checkpoint);
+
+        return llvm_type;
     }
 
     default:
         assert(false && "unreachable");
     }
-
-    return type;
 }
 
-typedef struct {
-    LLVMTypeRef *items;
-    size_t count;
-    size_t capacity;
-} LLVMTypes;
-
-typedef struct {
-    LLVMTypeRef return_type;
-    LLVMTypes parameters;
-    bool variadic;
-} LLVMFunctionPrototype;
-
-LLVMTypeRef codegen_get_llvm_type(CodeGen *gen, Type type) {
-    switch (type.kind) {
-    case TY_VOID:
-        return LLVMVoidType();
-
-    case TY_CHAR:
-        return LLVMInt8Type();
-
-    case TY_SHORT:
-        return LLVMInt16Type();
+// Types are canonical, so each one is lowered once and looked up by id after
+LLVMTypeRef codegen_get_llvm_type(CodeGen *gen, TypeId type) {
+    if (type >= gen->llvm_types.count) {
+        size_t count = type_count();
 
-    case TY_INT:
-        return LLVMInt32Type();
+        gen->llvm_types.items = arena_realloc(
+            gen->arena, gen->llvm_types.items,
+            gen->llvm_types.count * sizeof(LLVMTypeRef),
+            count * sizeof(LLVMTypeRef));
 
-    case TY_LONG:
-    case TY_LONG_LONG:
-        return LLVMInt64Type();
+        memset(&gen->llvm_types.items[gen->llvm_types.count], 0,
+               (count - gen->llvm_types.count) * sizeof(LLVMTypeRef));
 
-    case TY_FLOAT:
-        return LLVMFloatType();
+        gen->llvm_types.count = count;
+    }
 
-    case TY_DOUBLE:
-    case TY_LONG_DOUBLE:
-        return LLVMDoubleType();
+    if (gen->llvm_types.items[type] == NULL) {
+        gen->llvm_types.items[type] = codegen_lower_type(gen, type);
+    }
 
-    case TY_FUNCTION: {
-        LLVMFunctionPrototype llvm_function_prototype = {
-            .return_type =
-                codegen_get_llvm_type(gen, *type.data.prototype.return_type),
-            .variadic = type.data.prototype.variadic};
-
-        for (size_t i = 0; i < type.data.prototype.parameters.count; i++) {
-            da_append(&llvm_function_prototype.parameters,
-                      codegen_get_llvm_type(
-                          gen, type.data.prototype.parameters.items[i]));
-        }
+    return gen->llvm_types.items[type];
+}
 
-        return LLVMFunctionType(llvm_function_prototype.return_type,
-                                llvm_function_prototype.parameters.items,
-                                llvm_function_prototype.parameters.count,
-                                llvm_function_prototype.variadic);
-    }
+LLVMValueRef codegen_get_default_value(CodeGen *gen, TypeId type) {
+    assert(type_is_arithmetic(type));
 
-    default:
-        assert(false && "unreachable");
-    }
+    return LLVMConstNull(codegen_get_llvm_type(gen, type));
 }
 
-LLVMValueRef codegen_get_default_value(CodeGen *gen, Type type) {
-    switch (type.kind) {
-    case TY_CHAR:
-    case TY_SHORT:
-    case TY_INT:
-    case TY_LONG:
-    case TY_LONG_LONG:
-        return LLVMConstInt(codegen_get_llvm_type(gen, type), 0, false);
+LLVMValueRef codegen_cast_llvm_value(CodeGen *gen, TypeId original_type,
+                                     TypeId expected_type,
+                                     LLVMValueRef llvm_value) {
+    LLVMTypeRef expected_llvm_type = codegen_get_llvm_type(gen, expected_type);
 
-    case TY_FLOAT:
-    case TY_DOUBLE:
-    case TY_LONG_DOUBLE:
-        return LLVMConstReal(codegen_get_llvm_type(gen, type), 0.0);
+    if (type_is_float(original_type) && type_is_float(expected_type)) {
+        return LLVMBuildFPCast(gen->builder, llvm_value, expected_llvm_type,
+                               "");
+    }
 
-    default:
-        assert(false && "unreachable");
+    if (type_is_float(original_type)) {
+        return type_is_unsigned(expected_type)
+                   ? LLVMBuildFPToUI(gen->builder, llvm_value,
+                                     expected_llvm_type, "")
+                   : LLVMBuildFPToSI(gen->builder, llvm_value,
+                                     expected_llvm_type, "");
     }
-}
 
-LLVMValueRef codegen_cast_llvm_value(CodeGen *gen,
-                                     LLVMTypeRef expected_llvm_type,
-                                     Type original_type,
-                                     LLVMValueRef llvm_value) {
-    LLVMTypeKind expected_llvm_type_kind = LLVMGetTypeKind(expected_llvm_type);
-    LLVMTypeKind original_llvm_type_kind =
-        LLVMGetTypeKind(codegen_get_llvm_type(gen, original_type));
-
-    if (original_llvm_type_kind != expected_llvm_type_kind) {
-        if (original_type.kind >= TY_FLOAT &&
-            expected_llvm_type_kind == LLVMIntegerTypeKind) {
-            llvm_value = LLVMBuildFPToSI(gen->builder, llvm_value,
-                                         expected_llvm_type, "");
-        } else if (original_type.kind < TY_FLOAT &&
-                   (expected_llvm_type_kind == LLVMDoubleTypeKind ||
-                    expected_llvm_type_kind == LLVMFloatTypeKind)) {
-            llvm_value = LLVMBuildSIToFP(gen->builder, llvm_value,
-                                         expected_llvm_type, "");
-        } else if (original_type.kind < TY_FLOAT &&
-                   expected_llvm_type_kind == LLVMIntegerTypeKind) {
-            llvm_value = LLVMBuildIntCast2(gen->builder, llvm_value,
-                                           expected_llvm_type, true, "");
-        } else if (original_type.kind >= TY_FLOAT &&
-                   (expected_llvm_type_kind == LLVMDoubleTypeKind ||
-                    expected_llvm_type_kind == LLVMFloatTypeKind)) {
-            llvm_value = LLVMBuildFPCast(gen->builder, llvm_value,
-                                         expected_llvm_type, "");
-        }
+    if (type_is_float(expected_type)) {
+        return type_is_unsigned(original_type)
+                   ? LLVMBuildUIToFP(gen->builder, llvm_value,
+                                     expected_llvm_type, "")
+                   : LLVMBuildSIToFP(gen->builder, llvm_value,
+                                     expected_llvm_type, "");
     }
 
-    return llvm_value;
+    // Widening extends according to the signedness of the original value
+    return LLVMBuildIntCast2(gen->builder, llvm_value, expected_llvm_type,
+                             !type_is_unsigned(original_type), "");
 }
 
-LLVMValueRef codegen_compile_and_cast_expr(CodeGen *gen, Type expected_type,
-                                           Type original_type, ASTExpr expr,
-                                           bool constant_only);
+LLVMValueRef codegen_compile_expr(CodeGen *gen, ASTIndex expr);
 
-typedef struct {
-    LLVMValueRef *items;
-    size_t count;
-    size_t capacity;
-} LLVMValues;
+// Signed overflow is undefined unless -fwrapv is given, saying so lets LLVM
+// widen induction variables and reason about value ranges
+static bool codegen_has_no_signed_wrap(const CodeGen *gen, TypeId type) {
+    return !type_is_unsigned(type) && !gen->options->wrapv;
+}
 
-LLVMValueRef codegen_compile_expr(CodeGen *gen, LLVMTypeRef llvm_type,
-                                  ASTExpr expr, bool constant_only) {
-    switch (expr.kind) {
-    case EK_INT:
-        return LLVMConstInt(llvm_type, expr.value.intval, false);
+LLVMValueRef codegen_compile_unary_operation(CodeGen *gen, ASTIndex expr) {
+    const ASTUnaryOperation *unary = &gen->root->exprs.values[expr].unary;
 
-    case EK_FLOAT:
-        return LLVMConstReal(llvm_type, expr.value.floatval);
+    TypeId rhs_type = gen->root->exprs.types[unary->rhs];
+    LLVMValueRef rhs_value = codegen_compile_expr(gen, unary->rhs);
 
-    case EK_IDENTIFIER: {
-        if (constant_only) {
-            errorf(expr.loc, "expected a constant expression only");
+    switch (unary->unary_operator) {
+    case UO_MINUS:
+        if (type_is_float(rhs_type)) {
+            return LLVMBuildFNeg(gen->builder, rhs_value, "");
+        }
 
-            exit(1);
+        if (codegen_has_no_signed_wrap(gen, rhs_type)) {
+            return LLVMBuildNSWNeg(gen->builder, rhs_value, "");
         }
 
-        Symbol symbol =
-            symbol_table_lookup(&gen->symbol_table, expr.value.identifier.name);
+        return LLVMBuildNeg(gen->builder, rhs_value, "");
 
-        LLVMValueRef symbol_value = {0};
+    case UO_BANG: {
+        LLVMValueRef is_zero = {0};
 
-        if (symbol.type.kind == TY_FUNCTION) {
-            symbol_value = symbol.llvm_value;
+        if (type_is_float(rhs_type)) {
+            is_zero = LLVMBuildFCmp(gen->builder, LLVMRealOEQ, rhs_value,
+                                    LLVMConstNull(LLVMTypeOf(rhs_value)), "");
         } else {
-            symbol_value = LLVMBuildLoad2(
-                gen->builder, codegen_get_llvm_type(gen, symbol.type),
-                symbol.llvm_value, "");
+            is_zero = LLVMBuildICmp(gen->builder, LLVMIntEQ, rhs_value,
+                                    LLVMConstNull(LLVMTypeOf(rhs_value)), "");
         }
 
-        return codegen_cast_llvm_value(gen, llvm_type, symbol.type,
-                                       symbol_value);
+        return LLVMBuildZExt(
+            gen->builder, is_zero,
+            codegen_get_llvm_type(gen, gen->root->exprs.types[expr]), "");
     }
 
-    case EK_UNARY_OPERATION: {
-        LLVMValueRef rhs_value = codegen_compile_expr(
-            gen, llvm_type, *expr.value.unary.rhs, constant_only);
-
-        if (expr.value.unary.unary_operator == UO_MINUS) {
-            return LLVMConstNeg(rhs_value);
-        }
+    default:
+        assert(false && "unreachable");
+    }
+}
 
-        if (expr.value.unary.unary_operator == UO_BANG) {
-            return LLVMConstNot(rhs_value);
-        }
+// Both operands were converted to the type of the operation by sema
+LLVMValueRef codegen_compile_binary_operation(CodeGen *gen, ASTIndex expr) {
+    const ASTBinaryOperation *binary = &gen->root->exprs.values[expr].binary;
 
-        return LLVMConstNull(llvm_type);
-    }
+    TypeId type = gen->root->exprs.types[expr];
+    LLVMBuilderRef builder = gen->builder;
 
-    case EK_BINARY_OPERATION: {
-        LLVMValueRef lhs_value = codegen_compile_expr(
-            gen, llvm_type, *expr.value.binary.lhs, constant_only);
+    LLVMValueRef lhs = codegen_compile_expr(gen, binary->lhs);
+    LLVMValueRef rhs = codegen_compile_expr(gen, binary->rhs);
 
-        LLVMValueRef rhs_value = codegen_compile_expr(
-            gen, llvm_type, *expr.value.binary.rhs, constant_only);
+    if (type_is_float(type)) {
+        switch (binary->binary_operator) {
+        case BO_PLUS:
+            return LLVMBuildFAdd(builder, lhs, rhs, "");
 
-        if (expr.value.binary.binary_operator == BO_PLUS) {
-            return LLVMConstAdd(lhs_value, rhs_value);
-        }
+        case BO_MINUS:
+            return LLVMBuildFSub(builder, lhs, rhs, "");
 
-        if (expr.value.binary.binary_operator == BO_MINUS) {
-            return LLVMConstSub(lhs_value, rhs_value);
-        }
+        case BO_STAR:
+            return LLVMBuildFMul(builder, lhs, rhs, "");
 
-        if (expr.value.binary.binary_operator == BO_STAR) {
-            return LLVMConstMul(lhs_value, rhs_value);
-        }
+        case BO_FORWARD_SLASH:
+            return LLVMBuildFDiv(builder, lhs, rhs, "");
 
-        if (expr.value.binary.binary_operator == BO_FORWARD_SLASH) {
-            if (codegen_infer_type(gen, expr).kind < TY_FLOAT) {
-                return LLVMBuildUDiv(gen->builder, lhs_value, rhs_value, "");
-            } else {
-                return LLVMBuildFDiv(gen->builder, lhs_value, rhs_value, "");
-            }
+        default:
+            assert(false && "unreachable");
         }
-
-        return LLVMConstNull(llvm_type);
     }
 
-    case EK_CALL: {
-        if (constant_only) {
-            errorf(expr.loc, "expected a constant expression only");
+    bool no_signed_wrap = codegen_has_no_signed_wrap(gen, type);
+    bool is_unsigned = type_is_unsigned(type);
 
-            exit(1);
-        }
+    switch (binary->binary_operator) {
+    case BO_PLUS:
+        return no_signed_wrap ? LLVMBuildNSWAdd(builder, lhs, rhs, "")
+                              : LLVMBuildAdd(builder, lhs, rhs, "");
 
-        Type callable_type = codegen_infer_type(gen, *expr.value.call.callable);
+    case BO_MINUS:
+        return no_signed_wrap ? LLVMBuildNSWSub(builder, lhs, rhs, "")
+                              : LLVMBuildSub(builder, lhs, rhs, "");
 
-        if (callable_type.kind != TY_FUNCTION) {
-            errorf(expr.loc, "expected a callable");
+    case BO_STAR:
+        return no_signed_wrap ? LLVMBuildNSWMul(builder, lhs, rhs, "")
+                              : LLVMBuildMul(builder, lhs, rhs, "");
 
-            exit(1);
-        }
+    case BO_FORWARD_SLASH:
+        return is_unsigned ? LLVMBuildUDiv(builder, lhs, rhs, "")
+                           : LLVMBuildSDiv(builder, lhs, rhs, "");
 
-        if (expr.value.call.arguments.count !=
-                callable_type.data.prototype.parameters.count &&
-            !callable_type.data.prototype.variadic) {
-            errorf(expr.loc, "expected %d %s got %d",
-                   callable_type.data.prototype.parameters.count,
-                   expr.value.call.arguments.count != 1 ? "arguments"
-                                                        : "argument",
-                   expr.value.call.arguments.count);
+    case BO_PERCENT:
+        return is_unsigned ? LLVMBuildURem(builder, lhs, rhs, "")
+                           : LLVMBuildSRem(builder, lhs, rhs, "");
 
-            exit(1);
-        }
+    default:
+        assert(false && "unreachable");
+    }
+}
 
-        LLVMTypeRef llvm_callable_type =
-            codegen_get_llvm_type(gen, callable_type);
+LLVMValueRef codegen_compile_call(CodeGen *gen, ASTIndex expr) {
+    const ASTCall *call = &gen->root->exprs.values[expr].call;
 
-        LLVMValueRef llvm_callable_value = codegen_compile_expr(
-            gen, llvm_callable_type, *expr.value.call.callable, constant_only);
+    LLVMTypeRef llvm_callable_type =
+        codegen_get_llvm_type(gen, gen->root->exprs.types[call->callable]);
 
-        LLVMValues llvm_arguments = {0};
+    LLVMValueRef llvm_callable_value =
+        codegen_compile_expr(gen, call->callable);
 
-        for (size_t i = 0; i < expr.value.call.arguments.count; i++) {
-            da_append(
-                &llvm_arguments,
-                codegen_compile_and_cast_expr(
-                    gen, callable_type.data.prototype.parameters.items[i],
-                    codegen_infer_type(gen, expr.value.call.arguments.items[i]),
-                    expr.value.call.arguments.items[i], constant_only));
-        }
+    ArenaCheckpoint checkpoint = arena_checkpoint(gen->arena);
 
-        return codegen_cast_llvm_value(
-            gen, llvm_type, *callable_type.data.prototype.return_type,
-            LLVMBuildCall2(gen->builder, llvm_callable_type,
-                           llvm_callable_value, llvm_arguments.items,
-                           llvm_arguments.count, ""));
-    }
+    LLVMValueRef *llvm_arguments =
+        arena_alloc(gen->arena, call->arguments.count * sizeof(LLVMValueRef));
 
-    default:
-        assert(false && "unreachable");
+    for (size_t i = 0; i < call->arguments.count; i++) {
+        llvm_arguments[i] = codegen_compile_expr(
+            gen, gen->root->extra.items[call->arguments.start + i]);
     }
+
+    LLVMValueRef llvm_value =
+        LLVMBuildCall2(gen->builder, llvm_callable_type, llvm_callable_value,
+                       llvm_arguments, call->arguments.count, "");
+
+    arena_rollback(gen->arena, checkpoint);
+
+    return llvm_value;
 }
 
-#define COMPARE_AND_CAST_EXPRESSION_INT(dt, rt)                                \
-    if (type.kind == dt && expr.kind == EK_INT) {                              \
-        expr.value.intval = (rt)expr.value.intval;                             \
-    }                                                                          \
-                                                                               \
-    if (type.kind == dt && expr.kind == EK_FLOAT) {                            \
-        expr.kind = EK_INT;                                                    \
-        expr.value.intval = (rt)expr.value.floatval;                           \
-    }
+void codegen_compile_declaration(CodeGen *gen, ASTIndex declaration);
 
-#define COMPARE_AND_CAST_EXPRESSION_FLOAT(dt, rt)                              \
-    if (type.kind == dt && expr.kind == EK_INT) {                              \
-        expr.kind = EK_FLOAT;                                                  \
-        expr.value.floatval = (rt)expr.value.intval;                           \
-    }                                                                          \
-                                                                               \
-    if (type.kind == dt && expr.kind == EK_FLOAT) {                            \
-        expr.value.floatval = (rt)expr.value.floatval;                         \
+// Globals and functions defined outside of the shard are declared in its
+// module the first time they are used
+static LLVMValueRef codegen_get_symbol_value(CodeGen *gen, SymbolId symbol) {
+    if (gen->symbol_values.items[symbol] == NULL) {
+        codegen_compile_declaration(gen,
+                                    gen->symbol_declarations.items[symbol]);
     }
 
-ASTExpr codegen_cast_expr(Type type, ASTExpr expr) {
-    COMPARE_AND_CAST_EXPRESSION_INT(TY_CHAR, char)
-    COMPARE_AND_CAST_EXPRESSION_INT(TY_SHORT, short)
-    COMPARE_AND_CAST_EXPRESSION_INT(TY_INT, int)
-    COMPARE_AND_CAST_EXPRESSION_INT(TY_LONG, long)
-    COMPARE_AND_CAST_EXPRESSION_INT(TY_LONG_LONG, long long)
+    return gen->symbol_values.items[symbol];
+}
 
-    COMPARE_AND_CAST_EXPRESSION_FLOAT(TY_FLOAT, float)
-    COMPARE_AND_CAST_EXPRESSION_FLOAT(TY_DOUBLE, double)
-    COMPARE_AND_CAST_EXPRESSION_FLOAT(TY_LONG_DOUBLE, long double)
+// Every expression already carries its final type and every conversion is an
+// explicit EK_CAST node, so each node is compiled exactly once. Constant
+// subtrees were folded into literals by sema
+LLVMValueRef codegen_compile_expr(CodeGen *gen, ASTIndex expr) {
+    const ASTExprs *exprs = &gen->root->exprs;
+    const ASTExprValue *value = &exprs->values[expr];
 
-    if (expr.kind == EK_UNARY_OPERATION) {
-        *expr.value.unary.rhs = codegen_cast_expr(type, *expr.value.unary.rhs);
-    }
+    switch (exprs->kinds[expr]) {
+    case EK_INT:
+        return LLVMConstInt(codegen_get_llvm_type(gen, exprs->types[expr]),
+                            value->intval, false);
 
-    if (expr.kind == EK_BINARY_OPERATION) {
-        *expr.value.binary.lhs =
-            codegen_cast_expr(type, *expr.value.binary.lhs);
+    case EK_FLOAT:
+        return LLVMConstReal(codegen_get_llvm_type(gen, exprs->types[expr]),
+                             value->floatval);
+
+    case EK_IDENTIFIER: {
+        LLVMValueRef symbol_value =
+            codegen_get_symbol_value(gen, value->identifier.symbol);
+
+        if (type_kind(exprs->types[expr]) == TY_FUNCTION) {
+            return symbol_value;
+        }
 
-        *expr.value.binary.rhs =
-            codegen_cast_expr(type, *expr.value.binary.rhs);
+        return LLVMBuildLoad2(gen->builder,
+                              codegen_get_llvm_type(gen, exprs->types[expr]),
+                              symbol_value, "");
     }
 
-    return expr;
-}
+    case EK_UNARY_OPERATION:
+        return codegen_compile_unary_operation(gen, expr);
 
-LLVMValueRef codegen_compile_and_cast_expr(CodeGen *gen, Type expected_type,
-                                           Type original_type, ASTExpr expr,
-                                           bool constant_only) {
-    if (expected_type.kind == original_type.kind) {
-        return codegen_compile_expr(gen,
-                                    codegen_get_llvm_type(gen, expected_type),
-                                    expr, constant_only);
-    } else {
-        return codegen_compile_expr(
-            gen, codegen_get_llvm_type(gen, expected_type),
-            codegen_cast_expr(expected_type, expr), constant_only);
+    case EK_BINARY_OPERATION:
+        return codegen_compile_binary_operation(gen, expr);
+
+    case EK_CALL:
+        return codegen_compile_call(gen, expr);
+
+    case EK_CAST:
+        return codegen_cast_llvm_value(
+            gen, exprs->types[value->cast.operand], exprs->types[expr],
+            codegen_compile_expr(gen, value->cast.operand));
+
+    default:
+        assert(false && "unreachable");
     }
 }
 
-void codegen_compile_return_stmt(CodeGen *gen, ASTStmt stmt) {
-    if (stmt.value.ret.none) {
-        if (gen->context.function.prototype.return_type.kind != TY_VOID) {
-            errorf(stmt.loc, "expected non-void return type");
-
-            exit(1);
-        }
+void codegen_compile_return_stmt(CodeGen *gen, ASTIndex stmt) {
+    ASTIndex ret = gen->root->stmts.values[stmt].ret;
 
+    if (ret == AST_NONE) {
         LLVMBuildRetVoid(gen->builder);
     } else {
-        LLVMBuildRet(gen->builder,
-                     codegen_compile_and_cast_expr(
-                         gen, gen->context.function.prototype.return_type,
-                         codegen_infer_type(gen, stmt.value.ret.value),
-                         stmt.value.ret.value, false));
+        LLVMBuildRet(gen->builder, codegen_compile_expr(gen, ret));
     }
 
     gen->context.function_returned = true;
 }
 
-void codegen_compile_variable(CodeGen *gen, ASTVariable ast_variable,
-                              SymbolLinkage symbol_linkage) {
-    if (ast_variable.type.kind == TY_VOID) {
-        errorf(ast_variable.name.loc,
-               "a variable cannot have incomplete type 'void'");
+// Globals outside of the shard are declared without an initializer, the shard
+// defining them provides it at link time
+void codegen_compile_variable(CodeGen *gen, const ASTVariable *ast_variable,
+                              SymbolLinkage symbol_linkage, bool defined) {
+    LLVMTypeRef llvm_type = codegen_get_llvm_type(gen, ast_variable->type);
 
-        exit(1);
-    }
+    LLVMValueRef llvm_variable = {0};
 
     if (symbol_linkage == SL_GLOBAL) {
-        LLVMValueRef llvm_global_variable = LLVMAddGlobal(
-            gen->module, codegen_get_llvm_type(gen, ast_variable.type),
-            ast_variable.name.buffer);
+        llvm_variable = gen->symbol_values.items[ast_variable->symbol];
 
-        if (ast_variable.default_initialized) {
-            LLVMSetInitializer(
-                llvm_global_variable,
-                codegen_get_default_value(gen, ast_variable.type));
-        } else {
-            LLVMSetInitializer(llvm_global_variable,
-                               codegen_compile_and_cast_expr(
-                                   gen, ast_variable.type,
-                                   codegen_infer_type(gen, ast_variable.value),
-                                   ast_variable.value, true));
+        if (llvm_variable == NULL) {
+            llvm_variable =
+                LLVMAddGlobal(gen->module, llvm_type,
+                              interner_text(ast_variable->name.atom));
         }
 
-        Symbol symbol = {.type = ast_variable.type,
-                         .name = ast_variable.name,
-                         .linkage = symbol_linkage,
-                         .llvm_value = llvm_global_variable};
-
-        symbol_table_set(&gen->symbol_table, symbol);
-    } else {
-        LLVMValueRef llvm_alloca = LLVMBuildAlloca(
-            gen->builder, codegen_get_llvm_type(gen, ast_variable.type),
-            ast_variable.name.buffer);
-
-        if (ast_variable.default_initialized) {
-            LLVMBuildStore(gen->builder,
-                           codegen_get_default_value(gen, ast_variable.type),
-                           llvm_alloca);
-        } else {
-            LLVMBuildStore(gen->builder,
-                           codegen_compile_and_cast_expr(
-                               gen, ast_variable.type,
-                               codegen_infer_type(gen, ast_variable.value),
-                               ast_variable.value, false),
-                           llvm_alloca);
+        if (defined) {
+            LLVMSetInitializer(
+                llvm_variable,
+                ast_variable->value == AST_NONE
+                    ? codegen_get_default_value(gen, ast_variable->type)
+                    : codegen_compile_expr(gen, ast_variable->value));
         }
+    } else {
+        LLVMValueRef llvm_value =
+            ast_variable->value == AST_NONE
+                ? codegen_get_default_value(gen, ast_variable->type)
+                : codegen_compile_expr(gen, ast_variable->value);
 
-        Symbol symbol = {.type = ast_variable.type,
-                         .name = ast_variable.name,
-                         .linkage = symbol_linkage,
-                         .llvm_value = llvm_alloca};
+        llvm_variable = LLVMBuildAlloca(gen->builder, llvm_type,
+                                        interner_text(ast_variable->name.atom));
 
-        symbol_table_set(&gen->symbol_table, symbol);
+        LLVMBuildStore(gen->builder, llvm_value, llvm_variable);
     }
+
+    gen->symbol_values.items[ast_variable->symbol] = llvm_variable;
 }
 
-void codegen_compile_stmt(CodeGen *gen, ASTStmt stmt) {
-    switch (stmt.kind) {
+void codegen_compile_stmt(CodeGen *gen, ASTIndex stmt) {
+    const ASTStmtValue *value = &gen->root->stmts.values[stmt];
+
+    switch (gen->root->stmts.kinds[stmt]) {
     case SK_RETURN:
         codegen_compile_return_stmt(gen, stmt);
         break;
 
     case SK_VARIABLE_DECLARATION:
-        codegen_compile_variable(gen, stmt.value.variable_declaration,
-                                 SL_LOCAL);
+        codegen_compile_variable(
+            gen, &gen->root->variables.items[value->variable_declaration],
+            SL_LOCAL, true);
         break;
 
     case SK_EXPR:
-        if (stmt.value.expr.kind == EK_CALL) {
-            codegen_compile_expr(
-                gen,
-                codegen_get_llvm_type(gen,
-                                      codegen_infer_type(gen, stmt.value.expr)),
-                stmt.value.expr, false);
-        } else {
-            warnf(stmt.value.expr.loc,
-                  "expression is not used, thus it will not be compiled");
+        // Sema already warned about the other expressions, nothing of them
+        // would be observable
+        if (gen->root->exprs.kinds[value->expr] == EK_CALL) {
+            codegen_compile_expr(gen, value->expr);
         }
 
         break;
@@ -503,98 +429,140 @@ void codegen_compile_stmt(CodeGen *gen, ASTStmt stmt) {
     }
 }
 
-void codegen_compile_function(CodeGen *gen, ASTFunction ast_function) {
-    if (strcmp(ast_function.prototype.name.buffer, "main") == 0 &&
-        ast_function.prototype.return_type.kind != TY_INT) {
-        warnf(ast_function.prototype.name.loc,
-              "return type of 'main' is not 'int'");
+// Redeclarations of a function share its symbol, so the LLVM function is only
+// added by the first one
+LLVMValueRef codegen_get_function(CodeGen *gen,
+                                  const ASTFunctionPrototype *prototype) {
+    LLVMValueRef *llvm_function = &gen->symbol_values.items[prototype->symbol];
+
+    if (*llvm_function == NULL) {
+        *llvm_function = LLVMAddFunction(
+            gen->module, interner_text(prototype->name.atom),
+            codegen_get_llvm_type(gen, prototype->type));
     }
 
-    Type *function_return_type_on_heap =
-        memdup(&ast_function.prototype.return_type, sizeof(Type));
+    return *llvm_function;
+}
 
-    FunctionPrototype function_prototype = {
-        .return_type = function_return_type_on_heap,
-        .variadic = ast_function.prototype.parameters.variadic,
-    };
+void codegen_add_function_attribute(LLVMValueRef llvm_function,
+                                    const char *name) {
+    LLVMContextRef context = LLVMGetTypeContext(LLVMTypeOf(llvm_function));
+
+    LLVMAttributeRef attribute = LLVMCreateEnumAttribute(
+        context, LLVMGetEnumAttributeKindForName(name, strlen(name)), 0);
 
-    for (size_t i = 0; i < ast_function.prototype.parameters.count; i++) {
-        da_append(&function_prototype.parameters,
-                  ast_function.prototype.parameters.items[i].expected_type);
+    LLVMAddAttributeAtIndex(llvm_function, LLVMAttributeFunctionIndex,
+                            attribute);
+}
+
+void codegen_add_function_string_attribute(LLVMValueRef llvm_function,
+                                           const char *name,
+                                           const char *value) {
+    LLVMContextRef context = LLVMGetTypeContext(LLVMTypeOf(llvm_function));
+
+    LLVMAttributeRef attribute = LLVMCreateStringAttribute(
+        context, name, strlen(name), value, strlen(value));
+
+    LLVMAddAttributeAtIndex(llvm_function, LLVMAttributeFunctionIndex,
+                            attribute);
+}
+
+// IR passes (inlining, vectorization cost models) read the target CPU and
+// the size preferences from function attributes, not from the target machine
+void codegen_add_function_attributes(CodeGen *gen,
+                                     LLVMValueRef llvm_function) {
+    codegen_add_function_string_attribute(llvm_function, "target-cpu",
+                                          gen->target->cpu);
+
+    if (gen->target->features[0] != '\0') {
+        codegen_add_function_string_attribute(
+            llvm_function, "target-features", gen->target->features);
     }
 
-    Type function_type = {.kind = TY_FUNCTION,
-                          .data = {
-                              .prototype = function_prototype,
-                          }};
+    switch (gen->options->optimization_level) {
+    case OL_OZ:
+        codegen_add_function_attribute(llvm_function, "minsize");
+        codegen_add_function_attribute(llvm_function, "optsize");
+        break;
+
+    case OL_OS:
+        codegen_add_function_attribute(llvm_function, "optsize");
+        break;
 
-    LLVMValueRef llvm_function_value =
-        LLVMAddFunction(gen->module, ast_function.prototype.name.buffer,
-                        codegen_get_llvm_type(gen, function_type));
+    default:
+        break;
+    }
+}
 
-    Symbol function_symbol = {.type = function_type,
-                              .name = ast_function.prototype.name,
-                              .linkage = SL_GLOBAL,
-                              .llvm_value = llvm_function_value};
+void codegen_compile_function(CodeGen *gen, const ASTFunction *ast_function,
+                              bool defined) {
+    const ASTFunctionPrototype *prototype = &ast_function->prototype;
+    const ASTFunctionParameter *parameters =
+        &gen->root->parameters.items[prototype->parameters.start];
 
-    symbol_table_set(&gen->symbol_table, function_symbol);
+    LLVMValueRef llvm_function_value = codegen_get_function(gen, prototype);
 
-    if (!ast_function.prototype.definition) {
+    if (!prototype->definition || !defined) {
         return;
     }
 
-    LLVMBasicBlockRef entry_block =
-        LLVMAppendBasicBlock(llvm_function_value, "entry");
+    codegen_add_function_attributes(gen, llvm_function_value);
+
+    LLVMBasicBlockRef entry_block = LLVMAppendBasicBlockInContext(
+        gen->llvm_context, llvm_function_value, "entry");
 
     LLVMPositionBuilderAtEnd(gen->builder, entry_block);
 
     gen->context.function = ast_function;
     gen->context.function_returned = false;
 
-    for (size_t i = 0; i < ast_function.prototype.parameters.count; i++) {
+    for (size_t i = 0; i < prototype->parameters.count; i++) {
         LLVMValueRef llvm_alloca = LLVMBuildAlloca(
             gen->builder,
-            codegen_get_llvm_type(
-                gen, ast_function.prototype.parameters.items[i].expected_type),
-            ast_function.prototype.parameters.items[i].name.buffer);
+            codegen_get_llvm_type(gen, parameters[i].expected_type),
+            interner_text(parameters[i].name.atom));
 
         LLVMBuildStore(gen->builder, LLVMGetParam(llvm_function_value, i),
                        llvm_alloca);
 
-        Symbol argument_symbol = {
-            .type = ast_function.prototype.parameters.items[i].expected_type,
-            .name = ast_function.prototype.parameters.items[i].name,
-            .linkage = SL_LOCAL,
-            .llvm_value = llvm_alloca};
-
-        symbol_table_set(&gen->symbol_table, argument_symbol);
+        gen->symbol_values.items[parameters[i].symbol] = llvm_alloca;
     }
 
-    for (size_t i = 0; i < ast_function.body.count; i++) {
-        codegen_compile_stmt(gen, ast_function.body.items[i]);
+    // Statements after a return are unreachable and would land after the
+    // terminator of the block
+    for (size_t i = 0;
+         i < ast_function->body.count && !gen->context.function_returned;
+         i++) {
+        codegen_compile_stmt(
+            gen, gen->root->extra.items[ast_function->body.start + i]);
     }
 
     if (!gen->context.function_returned) {
-        if (gen->context.function.prototype.return_type.kind == TY_VOID) {
+        if (prototype->return_type == TY_VOID) {
             LLVMBuildRetVoid(gen->builder);
         } else {
-            LLVMBuildRet(gen->builder,
-                         codegen_get_default_value(
-                             gen, gen->context.function.prototype.return_type));
+            LLVMBuildRet(
+                gen->builder,
+                codegen_get_default_value(gen, prototype->return_type));
         }
     }
-
-    symbol_table_reset(&gen->symbol_table);
 }
 
-void codegen_compile_declaration(CodeGen *gen, ASTDeclaration declaration) {
-    switch (declaration.kind) {
+void codegen_compile_declaration(CodeGen *gen, ASTIndex declaration) {
+    ASTIndex index = gen->root->declarations.indices[declaration];
+
+    bool defined =
+        declaration >= gen->shard.start && declaration < gen->shard.end;
+
+    switch (gen->root->declarations.kinds[declaration]) {
     case DK_FUNCTION:
-        codegen_compile_function(gen, declaration.value.function);
+        codegen_compile_function(gen, &gen->root->functions.items[index],
+                                 defined);
         break;
 
     case DK_VARIABLE:
-        codegen_compile_variable(gen, declaration.value.variable, SL_GLOBAL);
+        codegen_compile_variable(gen, &gen->root->variables.items[index],
+                                 SL_GLOBAL, defined);
         break;
 
     default:
@@ -602,8 +570,50 @@ void codegen_compile_declaration(CodeGen *gen, ASTDeclaration declaration) {
     }
 }
 
-void codegen_compile_root(CodeGen *gen, ASTRoot root) {
-    for (size_t i = 0; i < root.declarations.count; i++) {
-        codegen_compile_declaration(gen, root.declarations.items[i]);
+// The root must have been analyzed by sema
+void codegen_compile_root(CodeGen *gen, const ASTRoot *root) {
+    codegen_compile_shard(
+        gen, root, (CodeGenShard){.start = 0, .end = root->declarations.count});
+}
+
+static ASTIndex codegen_declaration_symbol(const ASTRoot *root,
+                                           size_t declaration) {
+    ASTIndex index = root->declarations.indices[declaration];
+
+    if (root->declarations.kinds[declaration] == DK_FUNCTION) {
+        return root->functions.items[index].prototype.symbol;
+    }
+
+    return root->variables.items[index].symbol;
+}
+
+// Only the declarations of the shard are walked, whatever they refer to outside
+// of it is declared on first use, so a shard costs the size of its own code
+void codegen_compile_shard(CodeGen *gen, const ASTRoot *root,
+                           CodeGenShard shard) {
+    gen->root = root;
+    gen->shard = shard;
+
+    gen->symbol_values.count = root->symbol_count;
+    gen->symbol_values.items =
+        arena_alloc(gen->arena, root->symbol_count * sizeof(LLVMValueRef));
+
+    memset(gen->symbol_values.items, 0,
+           root->symbol_count * sizeof(LLVMValueRef));
+
+    gen->symbol_declarations.count = root->symbol_count;
+    gen->symbol_declarations.items =
+        arena_alloc(gen->arena, root->symbol_count * sizeof(ASTIndex));
+
+    memset(gen->symbol_declarations.items, 0xff,
+           root->symbol_count * sizeof(ASTIndex));
+
+    // Redeclarations of a function share its symbol, the first one declares it
+    for (size_t i = root->declarations.count; i-- > 0;) {
+        gen->symbol_declarations.items[codegen_declaration_symbol(root, i)] = i;
+    }
+
+    for (size_t i = shard.start; i < shard.end; i++) {
+        codegen_compile_declaration(gen, i);
     }
 }
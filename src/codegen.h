@@ -2,22 +2,66 @@
 
 #include <llvm-c/Types.h>
 
+#include "arena.h"
 #include "ast.h"
-#include "symbol_table.h"
+#include "compile_options.h"
+#include "target.h"
+#include "type.h"
 
 typedef struct {
-    ASTFunction function;
+    const ASTFunction *function;
     bool function_returned;
 } CodeGenContext;
 
+// LLVM values (functions, globals and allocas) by symbol id
 typedef struct {
+    LLVMValueRef *items;
+    size_t count;
+} CodeGenSymbolValues;
+
+// Declaration of each global and function by symbol id, AST_NONE for locals
+typedef struct {
+    ASTIndex *items;
+    size_t count;
+} CodeGenSymbolDeclarations;
+
+// LLVM types by type id, NULL until a type is first lowered
+typedef struct {
+    LLVMTypeRef *items;
+    size_t count;
+} CodeGenLLVMTypes;
+
+// The declarations of a translation unit a module defines, the others are
+// only declared, so the modules of several shards link into the whole unit
+typedef struct {
+    size_t start;
+    size_t end;
+} CodeGenShard;
+
+typedef struct {
+    Arena *arena;
+
+    const CompileOptions *options;
+    const Target *target;
+
+    LLVMContextRef llvm_context;
     LLVMModuleRef module;
     LLVMBuilderRef builder;
 
-    SymbolTable symbol_table;
+    const ASTRoot *root;
+
+    CodeGenSymbolValues symbol_values;
+    CodeGenSymbolDeclarations symbol_declarations;
+    CodeGenLLVMTypes llvm_types;
 
+    CodeGenShard shard;
     CodeGenContext context;
 } CodeGen;
 
-CodeGen codegen_new(const char *source_file_path);
-void codegen_compile_root(CodeGen *gen, ASTRoot root);
+// The module is created in the given context, which the caller owns
+CodeGen codegen_new(Arena *arena, LLVMContextRef llvm_context,
+                    const char *source_file_path, const CompileOptions *options,
+                    const Target *target);
+void codegen_compile_root(CodeGen *gen, const ASTRoot *root);
+void codegen_compile_shard(CodeGen *gen, const ASTRoot *root,
+                           CodeGenShard shard);
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef enum {
+    OL_O0,
+    OL_O1,
+    OL_O2,
+    OL_O3,
+    OL_OS,
+    OL_OZ,
+} OptimizationLevel;
+
+// What a translation unit is compiled to, chosen by -c, -S and -emit-llvm
+typedef enum {
+    OK_EXECUTABLE, // An object handed to the linker
+    OK_OBJECT,
+    OK_ASSEMBLY,
+    OK_LLVM_BITCODE,
+    OK_LLVM_IR,
+    OK_PREPROCESSED, // -E, the text after the preprocessor
+} OutputKind;
+
+// -flto compiles translation units to bitcode which is merged, optimized and
+// emitted as a whole when linking, -flto=thin keeps the modules apart and only
+// imports the functions worth inlining into each
+typedef enum {
+    LTO_NONE,
+    LTO_FULL,
+    LTO_THIN,
+} LinkTimeOptimization;
+
+typedef struct {
+    const char **items;
+    size_t count;
+    size_t capacity;
+} CompilePaths;
+
+// A -D or -U option, definition is NAME or NAME=VALUE for -D
+typedef struct {
+    const char *definition;
+    bool undefine;
+} CompileMacro;
+
+typedef struct {
+    CompileMacro *items;
+    size_t count;
+    size_t capacity;
+} CompileMacros;
+
+// Settings of a compilation shared by every stage, filled from the command
+// line
+typedef struct {
+    bool wrapv; // Signed overflow wraps instead of being undefined
+
+    OutputKind output_kind;
+
+    // -I directories searched for headers in order, and the -D and -U
+    // options in the order they were given
+    CompilePaths include_directories;
+    CompileMacros macros;
+
+    OptimizationLevel optimization_level;
+
+    LinkTimeOptimization lto;
+
+    bool cache; // Outputs are looked up in and stored to the compile cache
+
+    // Objects are built from chunks reused from the state of the previous
+    // compilation, which are reported with --incremental-stats
+    bool incremental;
+    bool incremental_stats;
+
+    // Threads compiling translation units, and the shards of one unit
+    unsigned jobs;
+
+    // Functions of a unit are split into this many modules which are
+    // optimized and emitted on their own threads, objects only
+    unsigned codegen_shards;
+
+    // New pass manager pipeline run instead of the one of the optimization
+    // level, NULL when not given
+    const char *passes;
+
+    // NULL when not given, cpu may be "native" for the host CPU and its
+    // features, features is added to the ones of the CPU
+    const char *target_triple;
+    const char *cpu;
+    const char *features;
+} CompileOptions;
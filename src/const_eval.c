@@ -0,0 +1,298 @@
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ast.h"
+#include "const_eval.h"
+#include "diagnostics.h"
+#include "type.h"
+
+// Wide enough for the exact result of any operation on two 64-bit integers, so
+// overflow is detected by comparing against the wrapped result
+typedef __int128 ConstEvalWide;
+
+// Reduces the value to the width of the type, sign or zero extended back
+static ConstEvalWide const_eval_wrap(TypeId type, ConstEvalWide value) {
+    unsigned shift = 64 - type_integer_bits(type);
+    unsigned long long bits = (unsigned long long)value << shift;
+
+    if (type_is_unsigned(type)) {
+        return bits >> shift;
+    }
+
+    return (long long)bits >> shift;
+}
+
+#define CONST_EVAL_TEXT_SIZE 24
+
+// Values of any 64-bit integer type, signed or not, fit in a ConstEvalWide
+static const char *const_eval_format(char text[CONST_EVAL_TEXT_SIZE],
+                                     ConstEvalWide value) {
+    if (value < 0) {
+        snprintf(text, CONST_EVAL_TEXT_SIZE, "%lld", (long long)value);
+    } else {
+        snprintf(text, CONST_EVAL_TEXT_SIZE, "%llu", (unsigned long long)value);
+    }
+
+    return text;
+}
+
+static double const_eval_round(TypeId type, double value) {
+    return type == TY_FLOAT ? (float)value : value;
+}
+
+static ConstEvalWide const_eval_int(const ASTRoot *root, ASTIndex expr) {
+    return const_eval_wrap(root->exprs.types[expr],
+                           root->exprs.values[expr].intval);
+}
+
+static double const_eval_float(const ASTRoot *root, ASTIndex expr) {
+    return root->exprs.values[expr].floatval;
+}
+
+static void const_eval_set_int(ASTRoot *root, ASTIndex expr, bool wrapv,
+                               ConstEvalWide value) {
+    TypeId type = root->exprs.types[expr];
+    ConstEvalWide wrapped = const_eval_wrap(type, value);
+
+    // Unsigned arithmetic is defined to wrap, and so is signed arithmetic with
+    // -fwrapv
+    if (wrapped != value && !type_is_unsigned(type) && !wrapv) {
+        warnf(root->exprs.locs[expr],
+              "integer overflow in constant expression");
+    }
+
+    root->exprs.kinds[expr] = EK_INT;
+    root->exprs.values[expr] = (ASTExprValue){.intval = wrapped};
+}
+
+static void const_eval_set_float(ASTRoot *root, ASTIndex expr, double value) {
+    root->exprs.kinds[expr] = EK_FLOAT;
+    root->exprs.values[expr] = (ASTExprValue){
+        .floatval = const_eval_round(root->exprs.types[expr], value)};
+}
+
+// The operation has no value, it is kept for run time unless a constant is
+// required
+static void const_eval_undefined(const ASTRoot *root, ASTIndex expr,
+                                 bool constant_only, const char *message) {
+    if (constant_only) {
+        errorf(root->exprs.locs[expr], "%s in constant expression", message);
+
+        diagnostics_fail();
+    }
+
+    warnf(root->exprs.locs[expr], "%s", message);
+}
+
+static void const_eval_fold_unary(ASTRoot *root, ASTIndex expr,
+                                  const ASTUnaryOperation *unary, bool wrapv) {
+    if (type_is_float(root->exprs.types[unary->rhs])) {
+        double rhs = const_eval_float(root, unary->rhs);
+
+        switch (unary->unary_operator) {
+        case UO_MINUS:
+            const_eval_set_float(root, expr, -rhs);
+            break;
+
+        case UO_BANG:
+            const_eval_set_int(root, expr, wrapv, rhs == 0);
+            break;
+        }
+
+        return;
+    }
+
+    ConstEvalWide rhs = const_eval_int(root, unary->rhs);
+
+    switch (unary->unary_operator) {
+    case UO_MINUS:
+        const_eval_set_int(root, expr, wrapv, -rhs);
+        break;
+
+    case UO_BANG:
+        const_eval_set_int(root, expr, wrapv, rhs == 0);
+        break;
+    }
+}
+
+static void const_eval_fold_binary(ASTRoot *root, ASTIndex expr,
+                                   const ASTBinaryOperation *binary,
+                                   bool constant_only, bool wrapv) {
+    if (type_is_float(root->exprs.types[expr])) {
+        double lhs = const_eval_float(root, binary->lhs);
+        double rhs = const_eval_float(root, binary->rhs);
+
+        switch (binary->binary_operator) {
+        case BO_PLUS:
+            const_eval_set_float(root, expr, lhs + rhs);
+            break;
+
+        case BO_MINUS:
+            const_eval_set_float(root, expr, lhs - rhs);
+            break;
+
+        case BO_STAR:
+            const_eval_set_float(root, expr, lhs * rhs);
+            break;
+
+        case BO_FORWARD_SLASH:
+            const_eval_set_float(root, expr, lhs / rhs);
+            break;
+
+        default:
+            assert(false && "unreachable");
+        }
+
+        return;
+    }
+
+    ConstEvalWide lhs = const_eval_int(root, binary->lhs);
+    ConstEvalWide rhs = const_eval_int(root, binary->rhs);
+
+    switch (binary->binary_operator) {
+    case BO_PLUS:
+        const_eval_set_int(root, expr, wrapv, lhs + rhs);
+        break;
+
+    case BO_MINUS:
+        const_eval_set_int(root, expr, wrapv, lhs - rhs);
+        break;
+
+    case BO_STAR:
+        // Products of two 64-bit unsigned values do not fit a ConstEvalWide,
+        // they wrap at the width of the type in any case
+        if (type_is_unsigned(root->exprs.types[expr])) {
+            const_eval_set_int(root, expr, wrapv,
+                               (unsigned long long)lhs *
+                                   (unsigned long long)rhs);
+        } else {
+            const_eval_set_int(root, expr, wrapv, lhs * rhs);
+        }
+
+        break;
+
+    case BO_FORWARD_SLASH:
+        if (rhs == 0) {
+            const_eval_undefined(root, expr, constant_only, "division by zero");
+        } else {
+            const_eval_set_int(root, expr, wrapv, lhs / rhs);
+        }
+
+        break;
+
+    case BO_PERCENT:
+        if (rhs == 0) {
+            const_eval_undefined(root, expr, constant_only, "division by zero");
+        } else {
+            const_eval_set_int(root, expr, wrapv, lhs % rhs);
+        }
+
+        break;
+    }
+}
+
+static void const_eval_fold_cast(ASTRoot *root, ASTIndex expr,
+                                 const ASTCast *cast, bool constant_only,
+                                 bool wrapv) {
+    TypeId original_type = root->exprs.types[cast->operand];
+    TypeId expected_type = root->exprs.types[expr];
+
+    if (!type_is_float(original_type)) {
+        ConstEvalWide value = const_eval_int(root, cast->operand);
+
+        // Rounded straight to the target type, going through double would
+        // round twice where the sitofp done at run time rounds once
+        if (type_is_float(expected_type)) {
+            const_eval_set_float(root, expr,
+                                 expected_type == TY_FLOAT ? (float)value
+                                                           : (double)value);
+        } else {
+            ConstEvalWide wrapped = const_eval_wrap(expected_type, value);
+            unsigned bits = type_integer_bits(expected_type);
+
+            // Casts are only ever implicit, so bits lost to truncation are
+            // most likely not what was meant, a change of signedness alone
+            // keeps all of them
+            if (value < -((ConstEvalWide)1 << (bits - 1)) ||
+                value >= (ConstEvalWide)1 << bits) {
+                char value_text[CONST_EVAL_TEXT_SIZE];
+                char wrapped_text[CONST_EVAL_TEXT_SIZE];
+
+                warnf(root->exprs.locs[expr],
+                      "implicit conversion changes value from %s to %s",
+                      const_eval_format(value_text, value),
+                      const_eval_format(wrapped_text, wrapped));
+            }
+
+            const_eval_set_int(root, expr, wrapv, wrapped);
+        }
+
+        return;
+    }
+
+    double value = const_eval_float(root, cast->operand);
+
+    if (type_is_float(expected_type)) {
+        const_eval_set_float(root, expr, value);
+        return;
+    }
+
+    unsigned bits = type_integer_bits(expected_type);
+
+    double min = type_is_unsigned(expected_type) ? 0 : -ldexp(1.0, bits - 1);
+    double max = ldexp(1.0, type_is_unsigned(expected_type) ? bits : bits - 1);
+
+    if (!(trunc(value) >= min && trunc(value) < max)) {
+        const_eval_undefined(root, expr, constant_only,
+                             "floating point value out of range of the "
+                             "integer type");
+        return;
+    }
+
+    const_eval_set_int(root, expr, wrapv, (ConstEvalWide)value);
+}
+
+void const_eval_fold(ASTRoot *root, ASTIndex expr, bool constant_only,
+                     bool wrapv) {
+    ASTExprValue value = root->exprs.values[expr];
+
+    // Folding computes in double, which is only what the target computes when
+    // its long double is double too, otherwise the operation is left for run
+    // time unless a constant is required
+    if (root->exprs.types[expr] == TY_LONG_DOUBLE &&
+        type_target_layout.long_double != TLD_DOUBLE && !constant_only) {
+        return;
+    }
+
+    switch (root->exprs.kinds[expr]) {
+    case EK_UNARY_OPERATION:
+        if (const_eval_is_literal(root, value.unary.rhs)) {
+            const_eval_fold_unary(root, expr, &value.unary, wrapv);
+        }
+
+        break;
+
+    case EK_BINARY_OPERATION:
+        if (const_eval_is_literal(root, value.binary.lhs) &&
+            const_eval_is_literal(root, value.binary.rhs)) {
+            const_eval_fold_binary(root, expr, &value.binary, constant_only,
+                                   wrapv);
+        }
+
+        break;
+
+    case EK_CAST:
+        if (const_eval_is_literal(root, value.cast.operand)) {
+            const_eval_fold_cast(root, expr, &value.cast, constant_only,
+                                 wrapv);
+        }
+
+        break;
+
+    default:
+        break;
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "ast.h"
+
+// Folds an expression whose operands are all literals into an EK_INT or
+// EK_FLOAT literal of the same type, in place. Integers are evaluated at the
+// width of their type and floats in IEEE single or double precision, so the
+// result is what the target would compute at run time
+//
+// Overflow is reported as a warning and wraps, signed overflow is not reported
+// with wrapv (-fwrapv). Operations without a result
+// (division by zero, out of range float to integer conversions) are left for
+// run time with a warning, or are an error when constant_only is set
+void const_eval_fold(ASTRoot *root, ASTIndex expr, bool constant_only,
+                     bool wrapv);
+
+static inline bool const_eval_is_literal(const ASTRoot *root, ASTIndex expr) {
+    return root->exprs.kinds[expr] == EK_INT ||
+           root->exprs.kinds[expr] == EK_FLOAT;
+}
@@ -1,12 +1,144 @@
 #include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "ast.h"
 #include "diagnostics.h"
+#include "dynamic_array.h"
+#include "line_table.h"
+
+// A line marker '# <line> "<path>"' of the preprocessor, the line after it in
+// the buffer is the given line of the path
+typedef struct {
+    size_t buffer_line;
+    size_t line;
+    const char *path;
+    int path_length;
+} DiagnosticsMarker;
+
+typedef struct {
+    DiagnosticsMarker *items;
+    size_t count;
+    size_t capacity;
+} DiagnosticsMarkers;
+
+typedef struct {
+    const char *file_path;
+    const char *buffer;
+    size_t length;
+
+    LineTable lines;
+    DiagnosticsMarkers markers;
+    bool lines_built;
+} DiagnosticsSource;
+
+static _Thread_local DiagnosticsSource diagnostics_source;
+
+_Thread_local jmp_buf *diagnostics_recovery;
+
+void diagnostics_set_source(const char *file_path, const char *buffer,
+                            size_t length) {
+    line_table_free(&diagnostics_source.lines);
+    da_free(diagnostics_source.markers);
+
+    diagnostics_source = (DiagnosticsSource){
+        .file_path = file_path,
+        .buffer = buffer,
+        .length = length,
+    };
+}
+
+static void diagnostics_find_markers(DiagnosticsSource *source) {
+    for (size_t i = 0; i < source->lines.count; i++) {
+        const char *line = source->buffer + source->lines.items[i];
+        char *end;
+
+        if (line[0] != '#' || line[1] != ' ' || line[2] < '0' ||
+            line[2] > '9') {
+            continue;
+        }
+
+        size_t number = strtoul(line + 2, &end, 10);
+
+        if (end[0] != ' ' || end[1] != '"') {
+            continue;
+        }
+
+        const char *path = end + 2;
+        const char *path_end = strchr(path, '"');
+
+        if (path_end == NULL) {
+            continue;
+        }
+
+        DiagnosticsMarker marker = {
+            .buffer_line = i + 2,
+            .line = number,
+            .path = path,
+            .path_length = path_end - path,
+        };
+
+        da_append(&source->markers, marker);
+    }
+}
+
+// Lines after a line marker belong to the file it names
+static const DiagnosticsMarker *
+diagnostics_find_marker(const DiagnosticsMarkers *markers, size_t line) {
+    size_t low = 0;
+    size_t high = markers->count;
+
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+
+        if (markers->items[middle].buffer_line <= line) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low == 0 ? NULL : &markers->items[low - 1];
+}
+
+LineColumn diagnostics_resolve(SourceLoc loc, const char **file_path,
+                               int *file_path_length) {
+    DiagnosticsSource *source = &diagnostics_source;
+
+    if (!source->lines_built) {
+        source->lines = line_table_build(source->buffer, source->length);
+        diagnostics_find_markers(source);
+        source->lines_built = true;
+    }
+
+    LineColumn line_column = line_table_resolve(&source->lines, loc);
+    const DiagnosticsMarker *marker =
+        diagnostics_find_marker(&source->markers, line_column.line);
+
+    if (marker == NULL) {
+        *file_path = source->file_path;
+        *file_path_length = strlen(source->file_path);
+    } else {
+        line_column.line += marker->line - marker->buffer_line;
+        *file_path = marker->path;
+        *file_path_length = marker->path_length;
+    }
+
+    return line_column;
+}
 
 void eprintln(const char *label, SourceLoc loc, const char *format,
               va_list args) {
-    fprintf(stderr, "%zu:%zu: %s: ", loc.line, loc.column, label);
+    const char *file_path;
+    int file_path_length;
+    LineColumn line_column =
+        diagnostics_resolve(loc, &file_path, &file_path_length);
+
+    fprintf(stderr, "%.*s:%zu:%zu: %s: ", file_path_length, file_path,
+            line_column.line, line_column.column, label);
     vfprintf(stderr, format, args);
     fprintf(stderr, "\n");
 }
@@ -24,3 +156,11 @@ void warnf(SourceLoc loc, const char *format, ...) {
     eprintln("warning", loc, format, args);
     va_end(args);
 }
+
+void diagnostics_fail(void) {
+    if (diagnostics_recovery != NULL) {
+        longjmp(*diagnostics_recovery, 1);
+    }
+
+    exit(1);
+}
@@ -1,6 +1,21 @@
 #pragma once
 
+#include <setjmp.h>
+#include <stddef.h>
+
 #include "ast.h"
 
+// Diagnostics resolve locations against the source set for the calling thread,
+// the line table of that source is only built once something is reported
+void diagnostics_set_source(const char *file_path, const char *buffer,
+                            size_t length);
+
 void errorf(SourceLoc loc, const char *format, ...);
 void warnf(SourceLoc loc, const char *format, ...);
+
+// Where diagnostics_fail goes on the calling thread, set while a job runs
+extern _Thread_local jmp_buf *diagnostics_recovery;
+
+// Gives up after an error was reported: the job running on the calling thread
+// fails and the others carry on, a thread running no job exits with status 1
+_Noreturn void diagnostics_fail(void);
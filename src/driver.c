@@ -1,53 +1,1035 @@
+#include <errno.h>
+#include <fcntl.h>
 #include <malloc.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
+#include <llvm-c/BitWriter.h>
 #include <llvm-c/Core.h>
+#include <llvm-c/IRReader.h>
+#include <llvm-c/Linker.h>
+#include <llvm-c/Orc.h>
 #include <llvm-c/Target.h>
 #include <llvm-c/TargetMachine.h>
 
+#include "arena.h"
 #include "ast.h"
+#include "cache.h"
 #include "codegen.h"
+#include "compile_options.h"
+#include "diagnostics.h"
 #include "driver.h"
+#include "dynamic_array.h"
+#include "incremental.h"
+#include "input_file.h"
+#include "jit.h"
+#include "jobs.h"
+#include "optimizer.h"
 #include "parser.h"
+#include "preprocessor.h"
+#include "sema.h"
+#include "target.h"
+#include "thinlto.h"
 
-void driver_compile(const char *source_file_path, const char *input) {
-    Parser parser = parser_new(input);
+#define DRIVER_HUGE_PAGES_THRESHOLD (8 * 1024 * 1024)
 
-    ASTRoot root = parser_parse_root(&parser);
+#define DRIVER_LINKER "clang"
 
-    CodeGen gen = codegen_new(source_file_path);
+extern char **environ;
 
-    codegen_compile_root(&gen, root);
+// Object code and assembly are kept in memory, so every output is written with
+// a single open and nothing is left behind when compilation fails
+static LLVMMemoryBufferRef driver_emit(LLVMTargetMachineRef target_machine,
+                                       LLVMModuleRef module,
+                                       OutputKind output_kind) {
+    if (output_kind == OK_LLVM_BITCODE) {
+        return LLVMWriteBitcodeToMemoryBuffer(module);
+    }
 
-    LLVMInitializeAllTargetInfos();
-    LLVMInitializeAllTargets();
-    LLVMInitializeAllTargetMCs();
-    LLVMInitializeAllAsmParsers();
-    LLVMInitializeAllAsmPrinters();
+    if (output_kind == OK_LLVM_IR) {
+        char *ir = LLVMPrintModuleToString(module);
 
-    const char *target_triple = LLVMGetDefaultTargetTriple();
+        LLVMMemoryBufferRef output =
+            LLVMCreateMemoryBufferWithMemoryRangeCopy(ir, strlen(ir), "ir");
 
-    LLVMTargetRef target;
-    LLVMGetTargetFromTriple(target_triple, &target, NULL);
+        LLVMDisposeMessage(ir);
 
-    LLVMTargetMachineRef target_machine = LLVMCreateTargetMachine(
-        target, target_triple, "generic", "", LLVMCodeGenLevelDefault,
-        LLVMRelocDefault, LLVMCodeModelDefault);
+        return output;
+    }
 
-    LLVMTargetMachineEmitToFile(target_machine, gen.module, "a.obj",
-                                LLVMObjectFile, NULL);
+    LLVMCodeGenFileType file_type =
+        output_kind == OK_ASSEMBLY ? LLVMAssemblyFile : LLVMObjectFile;
+
+    LLVMMemoryBufferRef output;
+    char *error = NULL;
+
+    if (LLVMTargetMachineEmitToMemoryBuffer(target_machine, module, file_type,
+                                            &error, &output)) {
+        fprintf(stderr, "error: %s\n", error);
+
+        LLVMDisposeMessage(error);
+        diagnostics_fail();
+    }
+
+    return output;
+}
+
+static const char *driver_output_extension(OutputKind output_kind) {
+    switch (output_kind) {
+    case OK_EXECUTABLE:
+    case OK_OBJECT:
+        return ".o";
+
+    case OK_ASSEMBLY:
+        return ".s";
+
+    case OK_LLVM_BITCODE:
+        return ".bc";
+
+    case OK_LLVM_IR:
+        return ".ll";
+
+    case OK_PREPROCESSED:
+        return ".i";
+    }
+
+    return "";
+}
+
+// Like other compilers, outputs go to the current directory and take the name
+// of the input with its extension replaced
+char *driver_output_path(const char *input_path, OutputKind output_kind) {
+    const char *base_name = strrchr(input_path, '/');
+    base_name = base_name != NULL ? base_name + 1 : input_path;
+
+    const char *dot = strrchr(base_name, '.');
+    size_t stem_length =
+        dot != NULL && dot != base_name ? (size_t)(dot - base_name)
+                                        : strlen(base_name);
+
+    const char *extension = driver_output_extension(output_kind);
+    size_t length = stem_length + strlen(extension) + 1;
+
+    char *output_path = malloc(length);
+
+    if (output_path == NULL) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    snprintf(output_path, length, "%.*s%s", (int)stem_length, base_name,
+             extension);
+
+    return output_path;
+}
+
+static void driver_write_all(int fd, const char *path,
+                             LLVMMemoryBufferRef output) {
+    const char *data = LLVMGetBufferStart(output);
+    size_t remaining = LLVMGetBufferSize(output);
+
+    while (remaining > 0) {
+        ssize_t written = write(fd, data, remaining);
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            fprintf(stderr, "error: cannot write '%s': %s\n", path,
+                    strerror(errno));
+            diagnostics_fail();
+        }
+
+        data += written;
+        remaining -= written;
+    }
+}
+
+void driver_write_output(const char *output_path, LLVMMemoryBufferRef output) {
+    if (strcmp(output_path, "-") == 0) {
+        driver_write_all(STDOUT_FILENO, output_path, output);
+        return;
+    }
+
+    int fd = open(output_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+    if (fd < 0) {
+        fprintf(stderr, "error: cannot open '%s': %s\n", output_path,
+                strerror(errno));
+        diagnostics_fail();
+    }
+
+    driver_write_all(fd, output_path, output);
+
+    close(fd);
+}
+
+// Temporary objects are removed when the process exits, whether it links or
+// stops on an error
+static struct {
+    char **items;
+    size_t count;
+    size_t capacity;
+} driver_temporaries;
+
+static pthread_mutex_t driver_temporaries_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void driver_remove_temporaries(void) {
+    pthread_mutex_lock(&driver_temporaries_mutex);
+
+    for (size_t i = 0; i < driver_temporaries.count; i++) {
+        unlink(driver_temporaries.items[i]);
+        free(driver_temporaries.items[i]);
+    }
+
+    da_free(driver_temporaries);
+
+    pthread_mutex_unlock(&driver_temporaries_mutex);
+}
+
+// Creates an empty temporary object file, which is removed at exit
+static const char *driver_create_temporary(int *fd) {
+    const char *directory = getenv("TMPDIR");
+
+    if (directory == NULL || directory[0] == '\0') {
+        directory = "/tmp";
+    }
+
+    size_t length = strlen(directory) + sizeof("/ycc-XXXXXX.o");
+    char *path = malloc(length);
+
+    if (path == NULL) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    snprintf(path, length, "%s/ycc-XXXXXX.o", directory);
+
+    *fd = mkstemps(path, 2);
+
+    if (*fd < 0) {
+        fprintf(stderr, "error: cannot create a temporary file in '%s': %s\n",
+                directory, strerror(errno));
+        diagnostics_fail();
+    }
+
+    pthread_mutex_lock(&driver_temporaries_mutex);
+
+    if (driver_temporaries.count == 0) {
+        atexit(driver_remove_temporaries);
+    }
+
+    da_append(&driver_temporaries, path);
+
+    pthread_mutex_unlock(&driver_temporaries_mutex);
+
+    return path;
+}
+
+const char *driver_write_temporary(LLVMMemoryBufferRef output) {
+    int fd;
+    const char *path = driver_create_temporary(&fd);
+
+    driver_write_all(fd, path, output);
+
+    close(fd);
+
+    return path;
+}
+
+void driver_preprocess(InputFile *input_file, const CompileOptions *options) {
+    InputFile preprocessed;
+
+    if (driver_is_llvm_input(input_file) ||
+        !preprocessor_run(input_file, options, &preprocessed)) {
+        return;
+    }
+
+    input_file_free(input_file);
+    *input_file = preprocessed;
+}
+
+// Bitcode is recognized by its magic number, textual IR by its extension
+bool driver_is_llvm_input(const InputFile *input_file) {
+    size_t path_length = strlen(input_file->file_path);
+
+    if (path_length > 3 &&
+        strcmp(input_file->file_path + path_length - 3, ".ll") == 0) {
+        return true;
+    }
+
+    return input_file->file_length >= 4 &&
+           memcmp(input_file->file_content, "BC\xc0\xde", 4) == 0;
+}
+
+// Takes the buffer, modules without a target get the one being compiled for
+static LLVMModuleRef driver_parse_llvm(LLVMContextRef llvm_context,
+                                       LLVMMemoryBufferRef buffer,
+                                       const char *name,
+                                       LLVMTargetMachineRef target_machine) {
+    LLVMModuleRef module;
+    char *error = NULL;
+
+    if (LLVMParseIRInContext(llvm_context, buffer, &module, &error)) {
+        fprintf(stderr, "error: cannot read '%s': %s\n", name, error);
+
+        LLVMDisposeMessage(error);
+        diagnostics_fail();
+    }
+
+    if (LLVMGetTarget(module)[0] == '\0') {
+        char *triple = LLVMGetTargetMachineTriple(target_machine);
+        LLVMTargetDataRef target_data =
+            LLVMCreateTargetDataLayout(target_machine);
+
+        LLVMSetTarget(module, triple);
+        LLVMSetModuleDataLayout(module, target_data);
+
+        LLVMDisposeTargetData(target_data);
+        LLVMDisposeMessage(triple);
+    }
+
+    return module;
+}
+
+// A relocatable link (-r) combines the objects into one object instead of an
+// executable
+static bool driver_run_linker(const char *const *object_paths,
+                              size_t object_count, const char *output_path,
+                              bool relocatable) {
+    const char **arguments = malloc((object_count + 5) * sizeof(char *));
+
+    if (arguments == NULL) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    size_t argument_count = 0;
+
+    arguments[argument_count++] = DRIVER_LINKER;
+
+    if (relocatable) {
+        arguments[argument_count++] = "-r";
+    }
+
+    arguments[argument_count++] = "-o";
+    arguments[argument_count++] = output_path;
+
+    for (size_t i = 0; i < object_count; i++) {
+        arguments[argument_count++] = object_paths[i];
+    }
+
+    arguments[argument_count] = NULL;
+
+    pid_t pid;
+    int error = posix_spawnp(&pid, DRIVER_LINKER, NULL, NULL,
+                             (char *const *)arguments, environ);
+
+    free(arguments);
+
+    if (error != 0) {
+        fprintf(stderr, "error: cannot run the linker '%s': %s\n",
+                DRIVER_LINKER, strerror(error));
+        return false;
+    }
+
+    int status;
+
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            fprintf(stderr, "error: cannot wait for the linker: %s\n",
+                    strerror(errno));
+            return false;
+        }
+    }
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "error: linker command failed\n");
+        return false;
+    }
+
+    return true;
+}
+
+bool driver_link(const char *const *object_paths, size_t object_count,
+                 const char *output_path) {
+    return driver_run_linker(object_paths, object_count, output_path, false);
+}
+
+// What the modules of a translation unit are generated from, shared read only
+// by the threads compiling its shards
+typedef struct {
+    const ASTRoot *root;
+    const char *source_file_path;
+    const CompileOptions *options;
+    const Target *target;
+
+    CodeGenShard *shards;
+    LLVMMemoryBufferRef *objects;
+} DriverUnit;
+
+// Bitcode compiled with -flto is optimized again when linking, -flto=thin
+// bitcode gets the summary the link decides imports from
+static void driver_optimize(LLVMModuleRef module,
+                            LLVMTargetMachineRef target_machine,
+                            const CompileOptions *options) {
+    bool llvm_output = options->output_kind == OK_LLVM_BITCODE ||
+                       options->output_kind == OK_LLVM_IR;
+
+    if (!llvm_output || options->lto == LTO_NONE) {
+        optimizer_run(module, target_machine, options, OP_COMPILE);
+    } else if (options->lto == LTO_FULL) {
+        optimizer_run(module, target_machine, options, OP_PRE_LINK);
+    } else {
+        optimizer_run(module, target_machine, options, OP_THIN_PRE_LINK);
+        thinlto_write_summary(module);
+    }
+}
+
+// Returns the optimized module of the shard, created in the given context
+static LLVMModuleRef driver_generate_module(const DriverUnit *unit,
+                                            Arena *arena, CodeGenShard shard,
+                                            LLVMTargetMachineRef target_machine,
+                                            LLVMContextRef llvm_context) {
+    CodeGen gen = codegen_new(arena, llvm_context, unit->source_file_path,
+                              unit->options, unit->target);
+
+    LLVMTargetDataRef target_data = LLVMCreateTargetDataLayout(target_machine);
+
+    LLVMSetModuleDataLayout(gen.module, target_data);
+
+    codegen_compile_shard(&gen, unit->root, shard);
+
+    driver_optimize(gen.module, target_machine, unit->options);
 
-    LLVMDisposeModule(gen.module);
     LLVMDisposeBuilder(gen.builder);
+    LLVMDisposeTargetData(target_data);
+
+    return gen.module;
+}
+
+static LLVMMemoryBufferRef driver_compile_module(const DriverUnit *unit,
+                                                 Arena *arena,
+                                                 CodeGenShard shard) {
+    LLVMTargetMachineRef target_machine =
+        target_create_machine(unit->target, unit->options);
+
+    // Each module has its own context, so translation units and shards can be
+    // compiled on separate threads
+    LLVMContextRef llvm_context = LLVMContextCreate();
+
+    LLVMModuleRef module = driver_generate_module(unit, arena, shard,
+                                                  target_machine, llvm_context);
+
+    LLVMMemoryBufferRef output =
+        driver_emit(target_machine, module, unit->options->output_kind);
+
+    LLVMDisposeModule(module);
+    LLVMContextDispose(llvm_context);
+    LLVMDisposeTargetMachine(target_machine);
+
+    return output;
+}
+
+static void driver_compile_shard(void *context, size_t index) {
+    DriverUnit *unit = context;
+
+    Arena arena = arena_new(false);
+
+    unit->objects[index] =
+        driver_compile_module(unit, &arena, unit->shards[index]);
+
+    arena_free(&arena);
+}
+
+// Rough cost of generating code for a declaration
+static size_t driver_declaration_weight(const ASTRoot *root,
+                                        size_t declaration) {
+    if (root->declarations.kinds[declaration] != DK_FUNCTION) {
+        return 1;
+    }
+
+    ASTIndex index = root->declarations.indices[declaration];
+
+    return 1 + root->functions.items[index].body.count;
+}
+
+// Shards are contiguous runs of declarations of about the same weight, they
+// only depend on the unit and the shard count, never on the thread count, so
+// the combined object is the same for any -j
+static void driver_partition(const ASTRoot *root, CodeGenShard *shards,
+                             size_t shard_count) {
+    size_t total_weight = 0;
+
+    for (size_t i = 0; i < root->declarations.count; i++) {
+        total_weight += driver_declaration_weight(root, i);
+    }
+
+    size_t declaration = 0;
+    size_t weight = 0;
+
+    for (size_t shard = 0; shard < shard_count; shard++) {
+        shards[shard].start = declaration;
+
+        // Leaves at least one declaration to each of the remaining shards
+        size_t last = root->declarations.count - (shard_count - shard - 1);
+        size_t target_weight = total_weight * (shard + 1) / shard_count;
+
+        while (declaration < last &&
+               (declaration == shards[shard].start || weight < target_weight)) {
+            weight += driver_declaration_weight(root, declaration++);
+        }
+
+        shards[shard].end = declaration;
+    }
+
+    shards[shard_count - 1].end = root->declarations.count;
+}
+
+// A relocatable link turns the objects of the shards into the object of the
+// unit
+static LLVMMemoryBufferRef
+driver_combine_objects(const LLVMMemoryBufferRef *objects,
+                       size_t object_count) {
+    const char **object_paths = malloc(object_count * sizeof(const char *));
+
+    if (object_paths == NULL) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    for (size_t i = 0; i < object_count; i++) {
+        object_paths[i] = driver_write_temporary(objects[i]);
+    }
+
+    int fd;
+    const char *object_path = driver_create_temporary(&fd);
+
+    close(fd);
+
+    if (!driver_run_linker(object_paths, object_count, object_path, true)) {
+        diagnostics_fail();
+    }
+
+    free(object_paths);
+
+    LLVMMemoryBufferRef output;
+    char *error = NULL;
+
+    if (LLVMCreateMemoryBufferWithContentsOfFile(object_path, &output,
+                                                 &error)) {
+        fprintf(stderr, "error: cannot read '%s': %s\n", object_path, error);
+
+        LLVMDisposeMessage(error);
+        diagnostics_fail();
+    }
+
+    return output;
+}
+
+static void driver_allocate_shards(DriverUnit *unit, size_t shard_count) {
+    unit->shards = malloc(shard_count * sizeof(CodeGenShard));
+    unit->objects = malloc(shard_count * sizeof(LLVMMemoryBufferRef));
+
+    if (unit->shards == NULL || unit->objects == NULL) {
+        printf("out of memory\n");
+        exit(1);
+    }
+}
+
+// Each shard is optimized and emitted on its own thread
+static LLVMMemoryBufferRef driver_compile_shards(DriverUnit *unit,
+                                                 size_t shard_count) {
+    driver_allocate_shards(unit, shard_count);
+    driver_partition(unit->root, unit->shards, shard_count);
+
+    // The shards report their own errors, the unit fails with them
+    if (!jobs_run(shard_count, unit->options->jobs, driver_compile_shard,
+                  unit)) {
+        diagnostics_fail();
+    }
+
+    LLVMMemoryBufferRef output =
+        driver_combine_objects(unit->objects, shard_count);
+
+    for (size_t i = 0; i < shard_count; i++) {
+        LLVMDisposeMemoryBuffer(unit->objects[i]);
+    }
+
+    free(unit->shards);
+    free(unit->objects);
+
+    return output;
+}
+
+// Only the chunks whose hash changed since the state was saved are generated
+// again, on the threads of the shards, the others come from the state
+static LLVMMemoryBufferRef
+driver_compile_incremental(DriverUnit *unit, const InputFile *input_file,
+                           const char *state_path) {
+    IncrementalChunks chunks = incremental_partition(unit->root, input_file);
+
+    // Linking only uses the object, so -c and a link share the state
+    CompileOptions object_options = *unit->options;
+    object_options.output_kind = OK_OBJECT;
+
+    CacheKey options_key = cache_options_key(input_file, &object_options);
+
+    incremental_reuse(state_path, options_key, &chunks);
+
+    driver_allocate_shards(unit, chunks.count);
+
+    size_t changed_count = 0;
+    size_t changed_declarations = 0;
+
+    for (size_t i = 0; i < chunks.count; i++) {
+        if (!chunks.items[i].reused) {
+            CodeGenShard shard = chunks.items[i].shard;
+
+            unit->shards[changed_count++] = shard;
+            changed_declarations += shard.end - shard.start;
+        }
+    }
+
+    if (!jobs_run(changed_count, unit->options->jobs, driver_compile_shard,
+                  unit)) {
+        diagnostics_fail();
+    }
+
+    for (size_t i = 0, changed = 0; i < chunks.count; i++) {
+        if (!chunks.items[i].reused) {
+            chunks.items[i].object = unit->objects[changed++];
+        }
+    }
+
+    for (size_t i = 0; i < chunks.count; i++) {
+        unit->objects[i] = chunks.items[i].object;
+    }
+
+    if (unit->options->incremental_stats) {
+        fprintf(stderr,
+                "%s: reused %zu of %zu chunks, regenerated %zu of %zu "
+                "declarations\n",
+                input_file->file_path, chunks.count - changed_count,
+                chunks.count, changed_declarations,
+                unit->root->declarations.count);
+    }
+
+    LLVMMemoryBufferRef output =
+        driver_combine_objects(unit->objects, chunks.count);
+
+    incremental_save(state_path, options_key, &chunks);
+    incremental_free(&chunks);
+
+    free(unit->shards);
+    free(unit->objects);
+
+    return output;
+}
+
+// The part of compilation every mode shares, the root is analyzed in place
+// because sema keeps a pointer to it
+typedef struct {
+    Arena arena;
+    ASTRoot root;
+    Sema sema;
+    Target target;
+} DriverFrontend;
+
+static void driver_frontend_init(DriverFrontend *frontend,
+                                 const InputFile *input_file,
+                                 const CompileOptions *options) {
+    if (input_file->file_length > UINT32_MAX) {
+        fprintf(stderr, "error: '%s' is too large, the limit is 4 GiB\n",
+                input_file->file_path);
+        diagnostics_fail();
+    }
+
+    diagnostics_set_source(input_file->file_path, input_file->file_content,
+                           input_file->file_length);
+
+    // Everything the parser and the code generator allocate for this
+    // translation unit lives in one arena, large units get huge pages
+    frontend->arena =
+        arena_new(input_file->file_length >= DRIVER_HUGE_PAGES_THRESHOLD);
+
+    Parser parser = parser_new(&frontend->arena, input_file->file_content,
+                               input_file->file_length);
+
+    frontend->root = parser_parse_root(&parser);
+
+    frontend->sema = sema_new(&frontend->root, options->wrapv);
+
+    sema_analyze_root(&frontend->sema);
+
+    target_initialize();
+
+    frontend->target = target_select(options);
+}
+
+static void driver_frontend_free(DriverFrontend *frontend) {
+    target_free(&frontend->target);
+    sema_free(&frontend->sema);
+
+    arena_free(&frontend->arena);
+}
+
+// Bitcode and IR inputs skip the front end and go straight to the optimizer
+static LLVMMemoryBufferRef driver_compile_llvm(const InputFile *input_file,
+                                               const CompileOptions *options) {
+    target_initialize();
+
+    Target target = target_select(options);
+
+    LLVMTargetMachineRef target_machine =
+        target_create_machine(&target, options);
+
+    LLVMContextRef llvm_context = LLVMContextCreate();
+
+    // The input is padded with zero bytes, which the IR parser relies on
+    LLVMMemoryBufferRef buffer = LLVMCreateMemoryBufferWithMemoryRange(
+        input_file->file_content, input_file->file_length,
+        input_file->file_path, true);
+
+    LLVMModuleRef module = driver_parse_llvm(
+        llvm_context, buffer, input_file->file_path, target_machine);
+
+    driver_optimize(module, target_machine, options);
+
+    LLVMMemoryBufferRef output =
+        driver_emit(target_machine, module, options->output_kind);
+
+    LLVMDisposeModule(module);
+    LLVMContextDispose(llvm_context);
+    LLVMDisposeTargetMachine(target_machine);
+    target_free(&target);
+
+    return output;
+}
+
+LLVMMemoryBufferRef driver_compile(const InputFile *input_file,
+                                   const CompileOptions *options,
+                                   const char *incremental_state_path) {
+    if (driver_is_llvm_input(input_file)) {
+        return driver_compile_llvm(input_file, options);
+    }
+
+    DriverFrontend frontend;
+    driver_frontend_init(&frontend, input_file, options);
+
+    const ASTRoot *root = &frontend.root;
+
+    DriverUnit unit = {
+        .root = root,
+        .source_file_path = input_file->file_path,
+        .options = options,
+        .target = &frontend.target,
+    };
+
+    // Assembly and LLVM outputs of several modules could not be combined
+    bool combinable = options->output_kind == OK_EXECUTABLE ||
+                      options->output_kind == OK_OBJECT;
+
+    size_t shard_count = combinable ? options->codegen_shards : 1;
+
+    if (shard_count > root->declarations.count) {
+        shard_count = root->declarations.count;
+    }
+
+    LLVMMemoryBufferRef output;
+
+    if (combinable && incremental_state_path != NULL &&
+        root->declarations.count != 0) {
+        output = driver_compile_incremental(&unit, input_file,
+                                            incremental_state_path);
+    } else if (shard_count > 1) {
+        output = driver_compile_shards(&unit, shard_count);
+    } else {
+        output = driver_compile_module(
+            &unit, &frontend.arena,
+            (CodeGenShard){.start = 0, .end = root->declarations.count});
+    }
+
+    driver_frontend_free(&frontend);
+
+    return output;
+}
+
+// The JIT runs the code in this process, so it has to be built for the host
+static void driver_check_host_triple(const char *triple) {
+    char *host_triple = LLVMGetDefaultTargetTriple();
+    char *normalized_host_triple = LLVMNormalizeTargetTriple(host_triple);
+    char *normalized_triple = LLVMNormalizeTargetTriple(triple);
+
+    if (strcmp(normalized_triple, normalized_host_triple) != 0) {
+        fprintf(stderr, "error: --run needs the host target '%s', not '%s'\n",
+                normalized_host_triple, normalized_triple);
+        diagnostics_fail();
+    }
+
+    LLVMDisposeMessage(normalized_triple);
+    LLVMDisposeMessage(normalized_host_triple);
+    LLVMDisposeMessage(host_triple);
 }
 
-void driver_link(const char *output_file_path) {
-    char *linker_command =
-        malloc(sizeof(char) * (9 + strlen(output_file_path) + 6));
+int driver_run(const InputFile *input_file, const CompileOptions *options,
+               int argc, const char **argv) {
+    // Bitcode and IR inputs have no front end, only a target
+    bool llvm_input = driver_is_llvm_input(input_file);
+    DriverFrontend frontend;
+    Target llvm_target;
+    Target *target;
+
+    if (llvm_input) {
+        target_initialize();
+
+        llvm_target = target_select(options);
+        target = &llvm_target;
+    } else {
+        driver_frontend_init(&frontend, input_file, options);
+
+        target = &frontend.target;
+    }
+
+    driver_check_host_triple(target->triple);
+
+    LLVMTargetMachineRef target_machine =
+        target_create_machine(target, options);
+
+    // The JIT takes the module and shares the context, which lives until the
+    // last of them lets go of it
+    LLVMOrcThreadSafeContextRef context = LLVMOrcCreateNewThreadSafeContext();
+    LLVMContextRef llvm_context = LLVMOrcThreadSafeContextGetContext(context);
+
+    LLVMModuleRef module;
+
+    if (llvm_input) {
+        // The input is padded with zero bytes, which the IR parser relies on
+        LLVMMemoryBufferRef buffer = LLVMCreateMemoryBufferWithMemoryRange(
+            input_file->file_content, input_file->file_length,
+            input_file->file_path, true);
+
+        module = driver_parse_llvm(llvm_context, buffer, input_file->file_path,
+                                   target_machine);
+
+        // A module may name its own target, which has to be the host as well
+        driver_check_host_triple(LLVMGetTarget(module));
+
+        driver_optimize(module, target_machine, options);
+    } else {
+        DriverUnit unit = {
+            .root = &frontend.root,
+            .source_file_path = input_file->file_path,
+            .options = options,
+            .target = target,
+        };
+
+        module = driver_generate_module(
+            &unit, &frontend.arena,
+            (CodeGenShard){.start = 0, .end = frontend.root.declarations.count},
+            target_machine, llvm_context);
+    }
+
+    int status = jit_run(context, module, target_machine, argc, argv);
+
+    LLVMOrcDisposeThreadSafeContext(context);
+
+    if (llvm_input) {
+        target_free(&llvm_target);
+    } else {
+        driver_frontend_free(&frontend);
+    }
+
+    return status;
+}
+
+static void driver_internalize_value(LLVMValueRef value) {
+    size_t name_length;
+    const char *name = LLVMGetValueName2(value, &name_length);
+
+    if (LLVMIsDeclaration(value) || strcmp(name, "main") == 0 ||
+        strncmp(name, "llvm.", 5) == 0) {
+        return;
+    }
+
+    LLVMSetLinkage(value, LLVMInternalLinkage);
+    LLVMSetVisibility(value, LLVMDefaultVisibility);
+}
+
+// Nothing outside the merged module can refer to its definitions except
+// through main, so every other definition may be inlined or dropped
+static void driver_internalize(LLVMModuleRef module) {
+    for (LLVMValueRef function = LLVMGetFirstFunction(module);
+         function != NULL; function = LLVMGetNextFunction(function)) {
+        driver_internalize_value(function);
+    }
+
+    for (LLVMValueRef global = LLVMGetFirstGlobal(module); global != NULL;
+         global = LLVMGetNextGlobal(global)) {
+        driver_internalize_value(global);
+    }
+}
+
+static bool driver_link_full(LLVMMemoryBufferRef *modules, size_t module_count,
+                             const CompileOptions *options,
+                             const char *output_path) {
+    target_initialize();
+
+    Target target = target_select(options);
+
+    LLVMTargetMachineRef target_machine =
+        target_create_machine(&target, options);
+
+    LLVMContextRef llvm_context = LLVMContextCreate();
+    LLVMModuleRef merged = NULL;
+
+    for (size_t i = 0; i < module_count; i++) {
+        LLVMModuleRef module = driver_parse_llvm(llvm_context, modules[i],
+                                                 "bitcode", target_machine);
+
+        // Link errors such as duplicate definitions are reported through the
+        // diagnostic handler of the context
+        if (merged == NULL) {
+            merged = module;
+        } else if (LLVMLinkModules2(merged, module)) {
+            diagnostics_fail();
+        }
+    }
+
+    driver_internalize(merged);
+
+    optimizer_run(merged, target_machine, options, OP_LINK);
+
+    LLVMMemoryBufferRef object =
+        driver_emit(target_machine, merged, OK_OBJECT);
+
+    LLVMDisposeModule(merged);
+    LLVMContextDispose(llvm_context);
+    LLVMDisposeTargetMachine(target_machine);
+    target_free(&target);
+
+    const char *object_path = driver_write_temporary(object);
+
+    LLVMDisposeMemoryBuffer(object);
+
+    return driver_link(&object_path, 1, output_path);
+}
+
+// What the backends of a ThinLTO link share, read only
+typedef struct {
+    const ThinLTOIndex *index;
+    const CompileOptions *options;
+    const Target *target;
+
+    Cache *cache; // NULL when the cache is disabled
+    CacheKey options_key;
+
+    LLVMMemoryBufferRef *objects;
+} DriverThinLink;
+
+static void driver_compile_thin_backend(void *context, size_t index) {
+    DriverThinLink *link = context;
+
+    CacheKey key;
+
+    if (link->cache != NULL) {
+        key = thinlto_backend_key(link->index, index, link->options_key);
+
+        link->objects[index] = cache_lookup(link->cache, key);
+
+        if (link->objects[index] != NULL) {
+            return;
+        }
+    }
+
+    LLVMTargetMachineRef target_machine =
+        target_create_machine(link->target, link->options);
+
+    LLVMContextRef llvm_context = LLVMContextCreate();
+
+    LLVMModuleRef module = thinlto_load(link->index, index, llvm_context);
+
+    optimizer_run(module, target_machine, link->options, OP_THIN_LINK);
+
+    link->objects[index] = driver_emit(target_machine, module, OK_OBJECT);
+
+    LLVMDisposeModule(module);
+    LLVMContextDispose(llvm_context);
+    LLVMDisposeTargetMachine(target_machine);
+
+    if (link->cache != NULL) {
+        cache_store(link->cache, key, link->objects[index]);
+    }
+}
+
+// Each module is optimized and emitted on its own thread, with only the
+// functions it imports from the others
+static bool driver_link_thin(LLVMMemoryBufferRef *modules, size_t module_count,
+                             const CompileOptions *options, Cache *cache,
+                             const char *output_path) {
+    ThinLTOIndex index = thinlto_index(modules, module_count, options->jobs);
+
+    target_initialize();
+
+    Target target = target_select(options);
+
+    // The backends do not depend on the path of any one input
+    InputFile backend_input = {.file_path = "-flto=thin"};
+
+    DriverThinLink link = {
+        .index = &index,
+        .options = options,
+        .target = &target,
+        .cache = cache,
+        .options_key = cache_options_key(&backend_input, options),
+        .objects = malloc(module_count * sizeof(LLVMMemoryBufferRef)),
+    };
+
+    const char **object_paths = malloc(module_count * sizeof(const char *));
+
+    if (link.objects == NULL || object_paths == NULL) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    if (!jobs_run(module_count, options->jobs, driver_compile_thin_backend,
+                  &link)) {
+        diagnostics_fail();
+    }
+
+    for (size_t i = 0; i < module_count; i++) {
+        object_paths[i] = driver_write_temporary(link.objects[i]);
+
+        LLVMDisposeMemoryBuffer(link.objects[i]);
+        LLVMDisposeMemoryBuffer(modules[i]);
+    }
+
+    bool linked = driver_link(object_paths, module_count, output_path);
+
+    free(object_paths);
+    free(link.objects);
+
+    target_free(&target);
+    thinlto_free(&index);
+
+    return linked;
+}
 
-    sprintf(linker_command, "clang -o %s a.obj", output_file_path);
+bool driver_link_lto(LLVMMemoryBufferRef *modules, size_t module_count,
+                     const CompileOptions *options, Cache *cache,
+                     const char *output_path) {
+    if (options->lto == LTO_THIN) {
+        return driver_link_thin(modules, module_count, options, cache,
+                                output_path);
+    }
 
-    system(linker_command);
+    return driver_link_full(modules, module_count, options, output_path);
 }
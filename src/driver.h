@@ -1,4 +1,47 @@
 #pragma once
 
-void driver_compile(const char *source_file_path, const char *input);
-void driver_link(const char *output_file_path);
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <llvm-c/Types.h>
+
+#include "cache.h"
+#include "compile_options.h"
+#include "input_file.h"
+
+// Returns the output selected by options->output_kind, objects are built
+// incrementally when a state path is given
+LLVMMemoryBufferRef driver_compile(const InputFile *input_file,
+                                   const CompileOptions *options,
+                                   const char *incremental_state_path);
+
+// Compiles the input in memory and returns what its main returns, argv[0] is
+// the name the program sees itself run as
+int driver_run(const InputFile *input_file, const CompileOptions *options,
+               int argc, const char **argv);
+
+// Replaces the input with its preprocessed text, LLVM inputs and sources
+// without directives are left as they are
+void driver_preprocess(InputFile *input_file, const CompileOptions *options);
+
+char *driver_output_path(const char *input_path, OutputKind output_kind);
+
+// True for LLVM bitcode and textual IR, which are compiled without the front
+// end
+bool driver_is_llvm_input(const InputFile *input_file);
+
+// An output path of "-" is the standard output
+void driver_write_output(const char *output_path, LLVMMemoryBufferRef output);
+
+// Returns the path of a new temporary file holding the output
+const char *driver_write_temporary(LLVMMemoryBufferRef output);
+
+bool driver_link(const char *const *object_paths, size_t object_count,
+                 const char *output_path);
+
+// Links the bitcode modules, which are consumed, as selected by options->lto:
+// merged and optimized as one, or with ThinLTO one object per module whose
+// objects are kept in the cache when one is given
+bool driver_link_lto(LLVMMemoryBufferRef *modules, size_t module_count,
+                     const CompileOptions *options, Cache *cache,
+                     const char *output_path);
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Multiply-fold mixing in the style of wyhash, good enough for hash tables and
+// fast on both short identifiers and large buffers
+
+static inline uint64_t hash_mix(uint64_t a, uint64_t b) {
+    __uint128_t product = (__uint128_t)a * b;
+
+    return (uint64_t)product ^ (uint64_t)(product >> 64);
+}
+
+static inline uint64_t hash_read64(const unsigned char *p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint64_t hash_bytes(const void *data, size_t length,
+                                  uint64_t seed) {
+    const unsigned char *p = data;
+
+    uint64_t state = seed ^ hash_mix(seed ^ 0xa0761d6478bd642full,
+                                     length ^ 0xe7037ed1a0b428dbull);
+
+    while (length >= 16) {
+        state = hash_mix(hash_read64(p) ^ 0x8ebc6af09c88c6e3ull,
+                         hash_read64(p + 8) ^ state);
+        p += 16;
+        length -= 16;
+    }
+
+    uint64_t a = 0;
+    uint64_t b = 0;
+
+    if (length >= 8) {
+        a = hash_read64(p);
+        b = hash_read64(p + length - 8);
+    } else if (length > 0) {
+        for (size_t i = 0; i < length; i++) {
+            a |= (uint64_t)p[i] << (8 * i);
+        }
+    }
+
+    return hash_mix(a ^ 0x589965cc75374cc3ull ^ state,
+                    b ^ 0x1d8e4e27c47d124full);
+}
+
+static inline uint64_t hash_u64(uint64_t value) {
+    return hash_mix(value ^ 0xa0761d6478bd642full, 0xe7037ed1a0b428dbull);
+}
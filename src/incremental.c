@@ -0,0 +1,390 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <llvm-c/Core.h>
+
+#include "ast.h"
+#include "cache.h"
+#include "codegen.h"
+#include "dynamic_array.h"
+#include "hash.h"
+#include "incremental.h"
+#include "input_file.h"
+#include "interner.h"
+#include "type.h"
+
+// Chunk boundaries come from the hashes of the declarations themselves, so an
+// edit only moves the boundaries next to the declarations it touches, chunks
+// hold INCREMENTAL_CHUNK_AVERAGE declarations on average
+#define INCREMENTAL_CHUNK_AVERAGE 8
+#define INCREMENTAL_CHUNK_MAX 32
+
+#define INCREMENTAL_MAGIC "YCCINC1\n"
+
+// The state file is the header, the entries, then the objects they point to
+typedef struct {
+    char magic[8];
+    CacheKey options_key;
+    uint64_t entry_count;
+} IncrementalHeader;
+
+typedef struct {
+    IncrementalHash hash;
+    uint64_t offset;
+    uint64_t size;
+} IncrementalEntry;
+
+static void incremental_hash_update(IncrementalHash *hash, const void *data,
+                                    size_t length) {
+    hash->high = hash_bytes(data, length, hash->high);
+    hash->low = hash_bytes(data, length, hash->low);
+}
+
+// Type ids differ between processes, so types are hashed by structure
+static void incremental_hash_type(IncrementalHash *hash, TypeId type) {
+    uint32_t kind = type_kind(type);
+
+    incremental_hash_update(hash, &kind, sizeof(kind));
+
+    if (kind != TY_FUNCTION) {
+        return;
+    }
+
+    const FunctionPrototype *prototype = &type_get(type)->prototype;
+    uint32_t shape[2] = {prototype->parameter_count, prototype->variadic};
+
+    incremental_hash_update(hash, shape, sizeof(shape));
+    incremental_hash_type(hash, prototype->return_type);
+
+    for (uint32_t i = 0; i < prototype->parameter_count; i++) {
+        incremental_hash_type(hash, prototype->parameters[i]);
+    }
+}
+
+static TypeId incremental_declaration_type(const ASTRoot *root,
+                                           size_t declaration) {
+    ASTIndex index = root->declarations.indices[declaration];
+
+    if (root->declarations.kinds[declaration] == DK_FUNCTION) {
+        return root->functions.items[index].prototype.type;
+    }
+
+    return root->variables.items[index].type;
+}
+
+// The declaration whose text holds the location, declarations are in source
+// order
+static size_t incremental_find_declaration(const ASTRoot *root,
+                                           SourceLoc loc) {
+    size_t low = 0;
+    size_t high = root->declarations.count;
+
+    while (high - low > 1) {
+        size_t middle = low + (high - low) / 2;
+
+        if (root->declarations.locs[middle] <= loc) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+// A declaration hashes its source text, its own type, and the name and type
+// of every identifier it uses, so a changed prototype of a callee or type of
+// a global also changes the hash of its users
+IncrementalChunks incremental_partition(const ASTRoot *root,
+                                        const InputFile *input_file) {
+    size_t declaration_count = root->declarations.count;
+
+    IncrementalHash *hashes =
+        malloc(declaration_count * sizeof(IncrementalHash));
+
+    if (hashes == NULL) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    for (size_t i = 0; i < declaration_count; i++) {
+        size_t start = i == 0 ? 0 : root->declarations.locs[i];
+        size_t end = i + 1 < declaration_count
+                         ? root->declarations.locs[i + 1]
+                         : input_file->file_length;
+
+        hashes[i] = (IncrementalHash){.high = 0x9e3779b97f4a7c15ull,
+                                      .low = 0xc2b2ae3d27d4eb4full};
+
+        incremental_hash_update(&hashes[i], input_file->file_content + start,
+                                end - start);
+        incremental_hash_type(&hashes[i],
+                              incremental_declaration_type(root, i));
+    }
+
+    const ASTExprs *exprs = &root->exprs;
+
+    for (size_t expr = 0; expr < exprs->count; expr++) {
+        if (exprs->kinds[expr] != EK_IDENTIFIER) {
+            continue;
+        }
+
+        IncrementalHash *hash =
+            &hashes[incremental_find_declaration(root, exprs->locs[expr])];
+        Atom atom = exprs->values[expr].identifier.name.atom;
+
+        incremental_hash_update(hash, interner_text(atom),
+                                interner_length(atom));
+        incremental_hash_type(hash, exprs->types[expr]);
+    }
+
+    IncrementalChunks chunks = {0};
+    IncrementalChunk chunk = {0};
+
+    for (size_t i = 0; i < declaration_count; i++) {
+        if (i == chunk.shard.start) {
+            chunk.hash = (IncrementalHash){.high = 0x165667b19e3779f9ull,
+                                           .low = 0x27d4eb2f165667c5ull};
+        }
+
+        incremental_hash_update(&chunk.hash, &hashes[i], sizeof(hashes[i]));
+
+        size_t length = i + 1 - chunk.shard.start;
+
+        if (hashes[i].low % INCREMENTAL_CHUNK_AVERAGE == 0 ||
+            length == INCREMENTAL_CHUNK_MAX || i + 1 == declaration_count) {
+            chunk.shard.end = i + 1;
+
+            da_append(&chunks, chunk);
+
+            chunk = (IncrementalChunk){.shard.start = i + 1};
+        }
+    }
+
+    free(hashes);
+
+    return chunks;
+}
+
+static int incremental_compare_entries(const void *a, const void *b) {
+    const IncrementalHash *x = &((const IncrementalEntry *)a)->hash;
+    const IncrementalHash *y = &((const IncrementalEntry *)b)->hash;
+
+    if (x->high != y->high) {
+        return x->high < y->high ? -1 : 1;
+    }
+
+    if (x->low != y->low) {
+        return x->low < y->low ? -1 : 1;
+    }
+
+    return 0;
+}
+
+static char *incremental_read_file(const char *path, size_t *length) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat file_stat;
+
+    if (fstat(fd, &file_stat) < 0) {
+        close(fd);
+        return NULL;
+    }
+
+    char *data = malloc(file_stat.st_size);
+
+    if (data == NULL) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    *length = 0;
+
+    while (*length < (size_t)file_stat.st_size) {
+        ssize_t count = read(fd, data + *length, file_stat.st_size - *length);
+
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (count <= 0) {
+            break;
+        }
+
+        *length += count;
+    }
+
+    close(fd);
+
+    return data;
+}
+
+void incremental_reuse(const char *state_path, CacheKey options_key,
+                       IncrementalChunks *chunks) {
+    size_t length = 0;
+    char *data = incremental_read_file(state_path, &length);
+
+    if (data == NULL) {
+        return;
+    }
+
+    IncrementalHeader header;
+
+    if (length < sizeof(header)) {
+        free(data);
+        return;
+    }
+
+    memcpy(&header, data, sizeof(header));
+
+    // A state written with other options or by another compiler describes
+    // other objects
+    if (memcmp(header.magic, INCREMENTAL_MAGIC, sizeof(header.magic)) != 0 ||
+        header.options_key.high != options_key.high ||
+        header.options_key.low != options_key.low ||
+        header.entry_count >
+            (length - sizeof(header)) / sizeof(IncrementalEntry)) {
+        free(data);
+        return;
+    }
+
+    IncrementalEntry *entries =
+        malloc(header.entry_count * sizeof(IncrementalEntry));
+
+    if (entries == NULL && header.entry_count != 0) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    memcpy(entries, data + sizeof(header),
+           header.entry_count * sizeof(IncrementalEntry));
+
+    qsort(entries, header.entry_count, sizeof(IncrementalEntry),
+          incremental_compare_entries);
+
+    for (size_t i = 0; i < chunks->count; i++) {
+        IncrementalChunk *chunk = &chunks->items[i];
+        IncrementalEntry key = {.hash = chunk->hash};
+
+        IncrementalEntry *entry =
+            bsearch(&key, entries, header.entry_count,
+                    sizeof(IncrementalEntry), incremental_compare_entries);
+
+        if (entry == NULL || entry->offset > length ||
+            entry->size > length - entry->offset) {
+            continue;
+        }
+
+        chunk->object = LLVMCreateMemoryBufferWithMemoryRangeCopy(
+            data + entry->offset, entry->size, "chunk");
+        chunk->reused = true;
+    }
+
+    free(entries);
+    free(data);
+}
+
+static bool incremental_write(int fd, const void *data, size_t length) {
+    const char *bytes = data;
+
+    while (length > 0) {
+        ssize_t count = write(fd, bytes, length);
+
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (count < 0) {
+            return false;
+        }
+
+        bytes += count;
+        length -= count;
+    }
+
+    return true;
+}
+
+// Written next to the state and renamed over it, an interrupted compilation
+// leaves the previous state intact
+void incremental_save(const char *state_path, CacheKey options_key,
+                      const IncrementalChunks *chunks) {
+    size_t path_length = strlen(state_path) + sizeof(".tmp-XXXXXX");
+    char *temporary_path = malloc(path_length);
+
+    if (temporary_path == NULL) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    snprintf(temporary_path, path_length, "%s.tmp-XXXXXX", state_path);
+
+    int fd = mkstemp(temporary_path);
+
+    if (fd < 0) {
+        fprintf(stderr, "warning: cannot write '%s': %s\n", state_path,
+                strerror(errno));
+        free(temporary_path);
+        return;
+    }
+
+    IncrementalHeader header = {
+        .magic = INCREMENTAL_MAGIC,
+        .options_key = options_key,
+        .entry_count = chunks->count,
+    };
+
+    bool written = incremental_write(fd, &header, sizeof(header));
+
+    uint64_t offset =
+        sizeof(header) + chunks->count * sizeof(IncrementalEntry);
+
+    for (size_t i = 0; i < chunks->count && written; i++) {
+        IncrementalEntry entry = {
+            .hash = chunks->items[i].hash,
+            .offset = offset,
+            .size = LLVMGetBufferSize(chunks->items[i].object),
+        };
+
+        written = incremental_write(fd, &entry, sizeof(entry));
+        offset += entry.size;
+    }
+
+    for (size_t i = 0; i < chunks->count && written; i++) {
+        written = incremental_write(
+            fd, LLVMGetBufferStart(chunks->items[i].object),
+            LLVMGetBufferSize(chunks->items[i].object));
+    }
+
+    close(fd);
+
+    if (!written || rename(temporary_path, state_path) < 0) {
+        fprintf(stderr, "warning: cannot write '%s': %s\n", state_path,
+                strerror(errno));
+        unlink(temporary_path);
+    }
+
+    free(temporary_path);
+}
+
+void incremental_free(IncrementalChunks *chunks) {
+    for (size_t i = 0; i < chunks->count; i++) {
+        if (chunks->items[i].object != NULL) {
+            LLVMDisposeMemoryBuffer(chunks->items[i].object);
+        }
+    }
+
+    da_free(*chunks);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <llvm-c/Types.h>
+
+#include "ast.h"
+#include "cache.h"
+#include "codegen.h"
+#include "input_file.h"
+
+typedef struct {
+    uint64_t high;
+    uint64_t low;
+} IncrementalHash;
+
+// A run of declarations compiled to one object, reused from the previous
+// compilation when its hash is unchanged
+typedef struct {
+    CodeGenShard shard;
+    IncrementalHash hash;
+
+    LLVMMemoryBufferRef object; // NULL until reused or generated
+    bool reused;
+} IncrementalChunk;
+
+typedef struct {
+    IncrementalChunk *items;
+    size_t count;
+    size_t capacity;
+} IncrementalChunks;
+
+// The root must have been analyzed by sema
+IncrementalChunks incremental_partition(const ASTRoot *root,
+                                        const InputFile *input_file);
+
+// Takes the objects of unchanged chunks from the state file, the state only
+// applies to outputs with the same options key
+void incremental_reuse(const char *state_path, CacheKey options_key,
+                       IncrementalChunks *chunks);
+
+// Every chunk must have its object
+void incremental_save(const char *state_path, CacheKey options_key,
+                      const IncrementalChunks *chunks);
+
+void incremental_free(IncrementalChunks *chunks);
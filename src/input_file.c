@@ -0,0 +1,158 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "diagnostics.h"
+#include "input_file.h"
+
+#define INPUT_FILE_BLOCK_SIZE (64 * 1024)
+
+size_t input_file_round_to_pages(size_t length) {
+    size_t page_size = sysconf(_SC_PAGESIZE);
+
+    return (length + page_size - 1) / page_size * page_size;
+}
+
+InputFile input_file_map(const char *file_path, int fd, size_t file_length) {
+    size_t allocation_length =
+        input_file_round_to_pages(file_length + INPUT_FILE_PADDING);
+
+    // Reserve zeroed pages for the whole buffer including the padding, then
+    // place the file over the start of it, this way the bytes after the end of
+    // file are always zero even when the file length is a multiple of the page
+    // size
+    char *buffer = mmap(NULL, allocation_length, PROT_READ,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (buffer == MAP_FAILED) {
+        perror("error");
+        diagnostics_fail();
+    }
+
+    if (file_length != 0) {
+        if (mmap(buffer, file_length, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd,
+                 0) == MAP_FAILED) {
+            perror("error");
+            diagnostics_fail();
+        }
+
+        madvise(buffer, file_length, MADV_SEQUENTIAL | MADV_WILLNEED);
+    }
+
+    return (InputFile){
+        .file_path = file_path,
+        .file_content = buffer,
+        .file_length = file_length,
+        .ownership = IFO_MAPPED,
+        .allocation_length = allocation_length,
+    };
+}
+
+InputFile input_file_stream(const char *file_path, int fd) {
+    size_t capacity = INPUT_FILE_BLOCK_SIZE;
+    size_t length = 0;
+    char *buffer = malloc(capacity);
+
+    while (true) {
+        if (buffer == NULL) {
+            printf("out of memory\n");
+            exit(1);
+        }
+
+        if (capacity - length < INPUT_FILE_BLOCK_SIZE + INPUT_FILE_PADDING) {
+            capacity *= 2;
+            buffer = realloc(buffer, capacity);
+            continue;
+        }
+
+        ssize_t read_length = read(fd, buffer + length, capacity - length -
+                                                            INPUT_FILE_PADDING);
+
+        if (read_length < 0) {
+            perror("error");
+            diagnostics_fail();
+        }
+
+        if (read_length == 0) {
+            break;
+        }
+
+        length += read_length;
+    }
+
+    memset(buffer + length, 0, INPUT_FILE_PADDING);
+
+    return (InputFile){
+        .file_path = file_path,
+        .file_content = buffer,
+        .file_length = length,
+        .ownership = IFO_HEAP,
+        .allocation_length = capacity,
+    };
+}
+
+bool input_file_try_read(const char *file_path, InputFile *input_file) {
+    int fd = open(file_path, O_RDONLY);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat file_stat;
+
+    if (fstat(fd, &file_stat) < 0) {
+        close(fd);
+        return false;
+    }
+
+    if (S_ISDIR(file_stat.st_mode)) {
+        close(fd);
+        errno = EISDIR;
+        return false;
+    }
+
+    *input_file = S_ISREG(file_stat.st_mode)
+                      ? input_file_map(file_path, fd, file_stat.st_size)
+                      : input_file_stream(file_path, fd);
+
+    close(fd);
+
+    return true;
+}
+
+InputFile input_file_read(const char *file_path) {
+    if (strcmp(file_path, "-") == 0) {
+        return input_file_stream(file_path, STDIN_FILENO);
+    }
+
+    InputFile input_file;
+
+    if (!input_file_try_read(file_path, &input_file)) {
+        perror("error");
+        diagnostics_fail();
+    }
+
+    return input_file;
+}
+
+void input_file_free(InputFile *input_file) {
+    switch (input_file->ownership) {
+    case IFO_MAPPED:
+        munmap((void *)input_file->file_content, input_file->allocation_length);
+        break;
+
+    case IFO_HEAP:
+        free((void *)input_file->file_content);
+        break;
+    }
+
+    input_file->file_content = NULL;
+    input_file->file_length = 0;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Every input buffer is followed by at least this many zero bytes, so the lexer
+// can rely on a NUL sentinel and read a few machine words past the end
+#define INPUT_FILE_PADDING 64
+
+typedef enum {
+    IFO_MAPPED,
+    IFO_HEAP,
+} InputFileOwnership;
+
+typedef struct {
+    const char *file_path;
+    const char *file_content;
+    size_t file_length;
+
+    InputFileOwnership ownership;
+    size_t allocation_length;
+} InputFile;
+
+InputFile input_file_read(const char *file_path);
+
+// Like input_file_read but returns false instead of exiting when the file
+// cannot be opened or is a directory
+bool input_file_try_read(const char *file_path, InputFile *input_file);
+void input_file_free(InputFile *input_file);
@@ -0,0 +1,180 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "hash.h"
+#include "interner.h"
+
+#define INTERNER_CHUNK_BITS 12
+#define INTERNER_CHUNK_SIZE (1 << INTERNER_CHUNK_BITS)
+#define INTERNER_MAX_CHUNKS (1 << (32 - INTERNER_CHUNK_BITS))
+
+#define ATOM_NONE UINT32_MAX
+
+typedef struct {
+    const char *text;
+    uint32_t length;
+    uint32_t hash;
+} InternerEntry;
+
+// Entries are stored in fixed size chunks which are never moved, so the text
+// of an atom can be read without looking at the hash table, the slots of the
+// hash table hold atom + 1 so that zero marks an empty slot
+//
+// Translation units are compiled on several threads sharing the interner,
+// lookups of existing atoms (the common case) only take the lock for reading,
+// and entries of an atom handed out are never written again, so its text is
+// read without the lock
+typedef struct {
+    pthread_rwlock_t lock;
+
+    Arena strings;
+
+    InternerEntry *chunks[INTERNER_MAX_CHUNKS];
+    uint32_t count;
+
+    uint32_t *slots;
+    uint32_t slot_mask;
+} Interner;
+
+static Interner interner = {.lock = PTHREAD_RWLOCK_INITIALIZER};
+
+static const char interner_empty_text[1] = "";
+
+static InternerEntry *interner_entry(Atom atom) {
+    return &interner.chunks[atom >> INTERNER_CHUNK_BITS]
+                           [atom & (INTERNER_CHUNK_SIZE - 1)];
+}
+
+static void interner_insert_slot(Atom atom, uint32_t hash) {
+    uint32_t slot = hash & interner.slot_mask;
+
+    while (interner.slots[slot] != 0) {
+        slot = (slot + 1) & interner.slot_mask;
+    }
+
+    interner.slots[slot] = atom + 1;
+}
+
+static void interner_grow_slots(void) {
+    uint32_t slot_count =
+        interner.slots == NULL ? 1024 : (interner.slot_mask + 1) * 2;
+
+    free(interner.slots);
+
+    interner.slots = calloc(slot_count, sizeof(uint32_t));
+    interner.slot_mask = slot_count - 1;
+
+    if (interner.slots == NULL) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    for (Atom atom = 0; atom < interner.count; atom++) {
+        interner_insert_slot(atom, interner_entry(atom)->hash);
+    }
+}
+
+static Atom interner_add(const char *text, size_t length, uint32_t hash) {
+    if (interner.count % INTERNER_CHUNK_SIZE == 0) {
+        if (interner.count / INTERNER_CHUNK_SIZE == INTERNER_MAX_CHUNKS - 1) {
+            printf("too many identifiers\n");
+            exit(1);
+        }
+
+        interner.chunks[interner.count / INTERNER_CHUNK_SIZE] =
+            arena_alloc(&interner.strings,
+                        INTERNER_CHUNK_SIZE * sizeof(InternerEntry));
+    }
+
+    Atom atom = interner.count;
+
+    *interner_entry(atom) = (InternerEntry){
+        .text = length == 0 ? interner_empty_text
+                            : arena_strndup(&interner.strings, text, length),
+        .length = length,
+        .hash = hash,
+    };
+
+    interner.count++;
+
+    if (interner.slots == NULL || interner.count * 2 > interner.slot_mask) {
+        interner_grow_slots();
+    } else {
+        interner_insert_slot(atom, hash);
+    }
+
+    return atom;
+}
+
+// Returns the atom of the text, or ATOM_NONE when it is not interned yet
+static Atom interner_find(const char *text, size_t length, uint32_t hash) {
+    if (interner.slots == NULL) {
+        return ATOM_NONE;
+    }
+
+    for (uint32_t slot = hash & interner.slot_mask; interner.slots[slot] != 0;
+         slot = (slot + 1) & interner.slot_mask) {
+        Atom atom = interner.slots[slot] - 1;
+        InternerEntry *entry = interner_entry(atom);
+
+        if (entry->hash == hash && entry->length == length &&
+            memcmp(entry->text, text, length) == 0) {
+            return atom;
+        }
+    }
+
+    return ATOM_NONE;
+}
+
+Atom interner_intern(const char *text, size_t length) {
+    uint32_t hash = hash_bytes(text, length, 0);
+
+    pthread_rwlock_rdlock(&interner.lock);
+
+    Atom atom = interner_find(text, length, hash);
+
+    pthread_rwlock_unlock(&interner.lock);
+
+    if (atom != ATOM_NONE) {
+        return atom;
+    }
+
+    pthread_rwlock_wrlock(&interner.lock);
+
+    if (interner.count == 0) {
+        interner_add("", 0, hash_bytes("", 0, 0));
+    }
+
+    // Another thread may have added it between the two locks
+    atom = interner_find(text, length, hash);
+
+    if (atom == ATOM_NONE) {
+        atom = interner_add(text, length, hash);
+    }
+
+    pthread_rwlock_unlock(&interner.lock);
+
+    return atom;
+}
+
+const char *interner_text(Atom atom) {
+    if (atom == ATOM_EMPTY) {
+        return interner_empty_text;
+    }
+
+    return interner_entry(atom)->text;
+}
+
+size_t interner_length(Atom atom) {
+    if (atom == ATOM_EMPTY) {
+        return 0;
+    }
+
+    return interner_entry(atom)->length;
+}
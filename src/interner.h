@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Identifier of a unique string, equal strings always get the same atom, so
+// they can be compared and hashed as integers
+typedef uint32_t Atom;
+
+// The empty string, which is always interned
+#define ATOM_EMPTY 0
+
+Atom interner_intern(const char *text, size_t length);
+
+// The text of an atom is '\0' terminated and stays valid for the rest of the
+// process
+const char *interner_text(Atom atom);
+size_t interner_length(Atom atom);
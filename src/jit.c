@@ -0,0 +1,58 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <llvm-c/Error.h>
+#include <llvm-c/LLJIT.h>
+#include <llvm-c/Orc.h>
+#include <llvm-c/TargetMachine.h>
+
+#include "jit.h"
+
+static void jit_check(LLVMErrorRef error) {
+    if (error == NULL) {
+        return;
+    }
+
+    char *message = LLVMGetErrorMessage(error);
+
+    fprintf(stderr, "error: %s\n", message);
+
+    LLVMDisposeErrorMessage(message);
+    exit(1);
+}
+
+int jit_run(LLVMOrcThreadSafeContextRef context, LLVMModuleRef module,
+            LLVMTargetMachineRef target_machine, int argc, const char **argv) {
+    LLVMOrcLLJITBuilderRef builder = LLVMOrcCreateLLJITBuilder();
+
+    LLVMOrcLLJITBuilderSetJITTargetMachineBuilder(
+        builder,
+        LLVMOrcJITTargetMachineBuilderCreateFromTargetMachine(target_machine));
+
+    LLVMOrcLLJITRef jit;
+    jit_check(LLVMOrcCreateLLJIT(&jit, builder));
+
+    LLVMOrcJITDylibRef dylib = LLVMOrcLLJITGetMainJITDylib(jit);
+
+    LLVMOrcDefinitionGeneratorRef process_symbols;
+    jit_check(LLVMOrcCreateDynamicLibrarySearchGeneratorForProcess(
+        &process_symbols, LLVMOrcLLJITGetGlobalPrefix(jit), NULL, NULL));
+
+    LLVMOrcJITDylibAddGenerator(dylib, process_symbols);
+
+    jit_check(LLVMOrcLLJITAddLLVMIRModule(
+        jit, dylib, LLVMOrcCreateNewThreadSafeModule(module, context)));
+
+    LLVMOrcExecutorAddress main_address;
+    jit_check(LLVMOrcLLJITLookup(jit, &main_address, "main"));
+
+    int (*main_function)(int, const char **) =
+        (int (*)(int, const char **))(uintptr_t)main_address;
+
+    int status = main_function(argc, argv);
+
+    jit_check(LLVMOrcDisposeLLJIT(jit));
+
+    return status;
+}
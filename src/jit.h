@@ -0,0 +1,12 @@
+#pragma once
+
+#include <llvm-c/Orc.h>
+#include <llvm-c/TargetMachine.h>
+#include <llvm-c/Types.h>
+
+// Compiles the module in memory with the settings of the target machine and
+// returns what its main returns, symbols it does not define are looked up in
+// this process, so the C library is the one ycc runs with. The module must
+// belong to the context, the module and the target machine are consumed
+int jit_run(LLVMOrcThreadSafeContextRef context, LLVMModuleRef module,
+            LLVMTargetMachineRef target_machine, int argc, const char **argv);
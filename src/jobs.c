@@ -0,0 +1,137 @@
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "diagnostics.h"
+#include "jobs.h"
+
+typedef struct {
+    JobFunction job;
+    void *context;
+
+    size_t count;
+    atomic_size_t next;
+    atomic_bool failed;
+} Jobs;
+
+// Threads the pools may still start. The outermost pool sets it from its
+// thread count, and pools started by a job take what is left, so -j bounds
+// the threads of the whole process however pools nest
+static atomic_size_t jobs_spare_threads;
+
+// Set on the threads running jobs, a pool started there is nested
+static _Thread_local bool jobs_nested;
+
+unsigned jobs_default_thread_count(void) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return online > 0 ? online : 1;
+}
+
+// An error in the job returns here through diagnostics_fail, so the thread
+// goes on with the next job and the process only exits once the pool is done
+static void jobs_call(Jobs *jobs, size_t index) {
+    jmp_buf *outer_recovery = diagnostics_recovery;
+    jmp_buf recovery;
+
+    if (setjmp(recovery) != 0) {
+        diagnostics_recovery = outer_recovery;
+        atomic_store(&jobs->failed, true);
+        return;
+    }
+
+    diagnostics_recovery = &recovery;
+    jobs->job(jobs->context, index);
+    diagnostics_recovery = outer_recovery;
+}
+
+// Jobs are handed out one index at a time, so a large translation unit does
+// not hold back the ones queued behind it
+static void *jobs_worker(void *argument) {
+    Jobs *jobs = argument;
+
+    for (size_t index = atomic_fetch_add(&jobs->next, 1); index < jobs->count;
+         index = atomic_fetch_add(&jobs->next, 1)) {
+        jobs_call(jobs, index);
+    }
+
+    return NULL;
+}
+
+static void *jobs_thread(void *argument) {
+    jobs_nested = true;
+    jobs_worker(argument);
+
+    // Out of jobs, the thread is given to pools still running elsewhere
+    atomic_fetch_add(&jobs_spare_threads, 1);
+
+    return NULL;
+}
+
+static size_t jobs_reserve(size_t wanted) {
+    size_t spare = atomic_load(&jobs_spare_threads);
+    size_t taken;
+
+    do {
+        taken = spare < wanted ? spare : wanted;
+    } while (!atomic_compare_exchange_weak(&jobs_spare_threads, &spare,
+                                           spare - taken));
+
+    return taken;
+}
+
+bool jobs_run(size_t count, unsigned thread_count, JobFunction job,
+              void *context) {
+    Jobs jobs = {.job = job, .context = context, .count = count};
+
+    atomic_init(&jobs.next, 0);
+    atomic_init(&jobs.failed, false);
+
+    bool outermost = !jobs_nested;
+
+    if (outermost) {
+        atomic_store(&jobs_spare_threads, thread_count > 0 ? thread_count - 1
+                                                           : 0);
+        jobs_nested = true;
+    }
+
+    size_t wanted = thread_count < count ? thread_count : count;
+    size_t thread_total = wanted > 1 ? jobs_reserve(wanted - 1) : 0;
+
+    pthread_t *threads = malloc(thread_total * sizeof(pthread_t));
+
+    if (threads == NULL && thread_total > 0) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    for (size_t i = 0; i < thread_total; i++) {
+        int error = pthread_create(&threads[i], NULL, jobs_thread, &jobs);
+
+        if (error != 0) {
+            fprintf(stderr, "error: cannot create a thread: %s\n",
+                    strerror(error));
+            exit(1);
+        }
+    }
+
+    jobs_worker(&jobs);
+
+    for (size_t i = 0; i < thread_total; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    free(threads);
+
+    if (outermost) {
+        jobs_nested = false;
+    }
+
+    return !atomic_load(&jobs.failed);
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef void (*JobFunction)(void *context, size_t index);
+
+// Number of threads used when -j is not given
+unsigned jobs_default_thread_count(void);
+
+// Calls job(context, index) for every index below count on up to thread_count
+// threads, the calling thread included, and returns once all calls returned.
+// A job may run a pool of its own, which only gets the threads left over
+// from the thread_count of the outermost pool. Returns false when a job
+// failed through diagnostics_fail, the other jobs still ran to completion
+bool jobs_run(size_t count, unsigned thread_count, JobFunction job,
+              void *context);
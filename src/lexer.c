@@ -1,70 +1,163 @@
-#include <ctype.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <string.h>
 
+#include "arena.h"
 #include "lexer.h"
+#include "lexer_scan.h"
 #include "token.h"
 
-Lexer lexer_new(const char *buffer) { return (Lexer){.buffer = buffer}; }
+// The buffer given to the lexer must be terminated by a '\0' sentinel and be
+// padded like input files are, every scanning loop stops on the sentinel
+// because '\0' belongs to no character class, so none of them has to check the
+// buffer length
+Lexer lexer_new(const char *buffer, size_t length) {
+    return (Lexer){.buffer = buffer,
+                   .length = length,
+                   .scan = lexer_scan_kernels_select()};
+}
+
+static inline bool lexer_char_is(char ch, CharClass char_class) {
+    return lexer_char_classes[(unsigned char)ch] & char_class;
+}
+
+Token lexer_make_token(TokenKind kind, size_t start, size_t end) {
+    if (end - start > TOKEN_MAX_LENGTH) {
+        kind = TOK_INVALID;
+        end = start + TOKEN_MAX_LENGTH;
+    }
+
+    return (Token){.start = start, .length = end - start, .kind = kind};
+}
 
 bool lexer_is_eof(Lexer *lexer) {
-    return lexer->position >= strlen(lexer->buffer);
+    return lexer->buffer[lexer->position] == '\0' &&
+           lexer->position >= lexer->length;
 }
 
-void lexer_skip_whitespace(Lexer *lexer) {
-    while (!lexer_is_eof(lexer) && isspace(lexer->buffer[lexer->position])) {
-        lexer->position++;
+// Returns false when a block comment is not terminated before the end of file
+bool lexer_skip_whitespace(Lexer *lexer) {
+    const char *buffer = lexer->buffer;
+
+    while (true) {
+        lexer->position =
+            lexer->scan->skip_whitespace(buffer, lexer->position);
+
+        // Line markers left by the preprocessor are read by the diagnostics
+        bool line_marker =
+            buffer[lexer->position] == '#' &&
+            (lexer->position == 0 || buffer[lexer->position - 1] == '\n');
+
+        if (buffer[lexer->position] != '/' && !line_marker) {
+            return true;
+        }
+
+        if (line_marker || buffer[lexer->position + 1] == '/') {
+            size_t end = lexer->scan->find_line_end(buffer, lexer->position);
+
+            while (buffer[end] == '\0' && end < lexer->length) {
+                end = lexer->scan->find_line_end(buffer, end + 1);
+            }
+
+            lexer->position = end;
+        } else if (buffer[lexer->position + 1] == '*') {
+            size_t end =
+                lexer->scan->find_comment_end(buffer, lexer->position + 2);
+
+            while (buffer[end] == '\0' && end < lexer->length) {
+                end = lexer->scan->find_comment_end(buffer, end + 1);
+            }
+
+            if (buffer[end] == '\0') {
+                return false;
+            }
+
+            lexer->position = end + 2;
+        } else {
+            return true;
+        }
     }
 }
 
 void lexer_skip_identifer(Lexer *lexer) {
-    while (!lexer_is_eof(lexer) && (isalnum(lexer->buffer[lexer->position]) ||
-                                    lexer->buffer[lexer->position] == '_')) {
-        lexer->position++;
-    }
+    lexer->position =
+        lexer->scan->skip_identifier(lexer->buffer, lexer->position);
 }
 
+// Letters and digits right after the number belong to it, they are its
+// suffix or hexadecimal digits, which the parser checks
 bool lexer_skip_number(Lexer *lexer) {
     bool is_float = false;
 
-    while (!lexer_is_eof(lexer) && (isdigit(lexer->buffer[lexer->position]) ||
-                                    lexer->buffer[lexer->position] == '.')) {
-        lexer->position++;
-
+    while (lexer_char_is(lexer->buffer[lexer->position], CC_NUMBER)) {
         if (lexer->buffer[lexer->position] == '.') {
             is_float = true;
         }
+
+        lexer->position++;
     }
 
+    lexer_skip_identifer(lexer);
+
     return is_float;
 }
 
-#define SET_TOKEN_KIND(k)                                                      \
-    token.kind = k;                                                            \
-    token.loc.end = lexer->position;
-
-#define COMPARE_AND_SET_TOKEN_KIND(s, k)                                       \
-    if ((token.loc.end - token.loc.start == strlen(s)) &&                      \
-        strncmp(&lexer->buffer[token.loc.start], s, strlen(s)) == 0) {         \
-        SET_TOKEN_KIND(k);                                                     \
+typedef struct {
+    const char *text;
+    size_t length;
+    TokenKind kind;
+} Keyword;
+
+// Perfect hash over the keyword set, the slots below are precomputed from it,
+// so any keyword added must be given a free slot (or the hash retuned)
+#define KEYWORD_HASH(s, n)                                                     \
+    (((n) + (unsigned char)(s)[0] + (unsigned char)(s)[(n) - 1] * 12) & 15)
+
+#define KEYWORD(s, k) {.text = s, .length = sizeof(s) - 1, .kind = k}
+
+static const Keyword lexer_keywords[16] = {
+    [0] = KEYWORD("return", TOK_KEYWORD_RETURN),
+    [4] = KEYWORD("long", TOK_KEYWORD_LONG),
+    [6] = KEYWORD("double", TOK_KEYWORD_DOUBLE),
+    [8] = KEYWORD("short", TOK_KEYWORD_SHORT),
+    [9] = KEYWORD("signed", TOK_KEYWORD_SIGNED),
+    [10] = KEYWORD("void", TOK_KEYWORD_VOID),
+    [11] = KEYWORD("float", TOK_KEYWORD_FLOAT),
+    [12] = KEYWORD("int", TOK_KEYWORD_INT),
+    [13] = KEYWORD("unsigned", TOK_KEYWORD_UNSIGNED),
+    [15] = KEYWORD("char", TOK_KEYWORD_CHAR),
+};
+
+TokenKind lexer_lookup_keyword(const char *text, size_t length) {
+    const Keyword *keyword = &lexer_keywords[KEYWORD_HASH(text, length)];
+
+    if (keyword->length == length && memcmp(keyword->text, text, length) == 0) {
+        return keyword->kind;
     }
 
+    return TOK_IDENTIFIER;
+}
+
 #define TOKENIZE_SINGLE_CHARACTER(c, k)                                        \
     case c:                                                                    \
-        SET_TOKEN_KIND(k)                                                      \
+        kind = k;                                                              \
         break;
 
 Token lexer_next_token(Lexer *lexer) {
-    lexer_skip_whitespace(lexer);
+    if (!lexer_skip_whitespace(lexer)) {
+        size_t start = lexer->position;
+
+        lexer->position = lexer->length;
+
+        return lexer_make_token(TOK_INVALID, start, lexer->length);
+    }
 
-    Token token = {.kind = TOK_EOF,
-                   .loc = {
-                       .start = lexer->position,
-                       .end = lexer->position,
-                   }};
+    size_t start = lexer->position;
 
     if (lexer_is_eof(lexer))
-        return token;
+        return lexer_make_token(TOK_EOF, start, start);
+
+    TokenKind kind = TOK_INVALID;
 
     char ch = lexer->buffer[lexer->position++];
 
@@ -80,29 +173,42 @@ Token lexer_next_token(Lexer *lexer) {
         TOKENIZE_SINGLE_CHARACTER('-', TOK_MINUS)
         TOKENIZE_SINGLE_CHARACTER('*', TOK_STAR)
         TOKENIZE_SINGLE_CHARACTER('/', TOK_FORWARD_SLASH)
+        TOKENIZE_SINGLE_CHARACTER('%', TOK_PERCENT)
         TOKENIZE_SINGLE_CHARACTER('!', TOK_BANG)
         TOKENIZE_SINGLE_CHARACTER('=', TOK_ASSIGN)
 
     default:
-        if (isalpha(ch) || ch == '_') {
+        if (lexer_char_is(ch, CC_IDENTIFIER_START)) {
             lexer_skip_identifer(lexer);
-            SET_TOKEN_KIND(TOK_IDENTIFIER)
-            COMPARE_AND_SET_TOKEN_KIND("void", TOK_KEYWORD_VOID)
-            COMPARE_AND_SET_TOKEN_KIND("char", TOK_KEYWORD_CHAR)
-            COMPARE_AND_SET_TOKEN_KIND("short", TOK_KEYWORD_SHORT)
-            COMPARE_AND_SET_TOKEN_KIND("int", TOK_KEYWORD_INT)
-            COMPARE_AND_SET_TOKEN_KIND("long", TOK_KEYWORD_LONG)
-            COMPARE_AND_SET_TOKEN_KIND("float", TOK_KEYWORD_FLOAT)
-            COMPARE_AND_SET_TOKEN_KIND("double", TOK_KEYWORD_DOUBLE)
-            COMPARE_AND_SET_TOKEN_KIND("return", TOK_KEYWORD_RETURN)
-        } else if (isdigit(ch)) {
-            SET_TOKEN_KIND(lexer_skip_number(lexer) ? TOK_FLOAT : TOK_INT)
-        } else {
-            SET_TOKEN_KIND(TOK_INVALID)
+            kind = lexer_lookup_keyword(&lexer->buffer[start],
+                                        lexer->position - start);
+        } else if (lexer_char_is(ch, CC_DIGIT)) {
+            kind = lexer_skip_number(lexer) ? TOK_FLOAT : TOK_INT;
         }
 
         break;
     }
 
-    return token;
+    return lexer_make_token(kind, start, lexer->position);
+}
+
+Tokens lexer_tokenize(Arena *arena, const char *buffer, size_t length) {
+    Lexer lexer = lexer_new(buffer, length);
+
+    // Most tokens are followed by at least one separating character, so this
+    // is usually enough to never grow the array
+    Tokens tokens = {.capacity = length / 2 + 1};
+    tokens.items = arena_alloc(arena, tokens.capacity * sizeof(Token));
+
+    while (true) {
+        Token token = lexer_next_token(&lexer);
+
+        arena_da_append(arena, &tokens, token);
+
+        if (token.kind == TOK_EOF) {
+            break;
+        }
+    }
+
+    return tokens;
 }
@@ -2,12 +2,18 @@
 
 #include <stddef.h>
 
+#include "arena.h"
+#include "lexer_scan.h"
 #include "token.h"
 
 typedef struct {
     const char *buffer;
+    size_t length;
     size_t position;
+
+    const LexerScanKernels *scan;
 } Lexer;
 
-Lexer lexer_new(const char *buffer);
+Lexer lexer_new(const char *buffer, size_t length);
 Token lexer_next_token(Lexer *lexer);
+Tokens lexer_tokenize(Arena *arena, const char *buffer, size_t length);
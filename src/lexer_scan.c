@@ -0,0 +1,295 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __x86_64__
+#include <immintrin.h>
+
+#define LEXER_SCAN_X86
+#endif
+
+#include "lexer_scan.h"
+
+#define CHAR_CLASS_RANGE(first, last, class) [first ... last] = class
+
+const unsigned char lexer_char_classes[256] = {
+    [' '] = CC_SPACE,
+    ['\t'] = CC_SPACE,
+    ['\n'] = CC_SPACE,
+    ['\v'] = CC_SPACE,
+    ['\f'] = CC_SPACE,
+    ['\r'] = CC_SPACE,
+
+    CHAR_CLASS_RANGE('a', 'z', CC_IDENTIFIER_START),
+    CHAR_CLASS_RANGE('A', 'Z', CC_IDENTIFIER_START),
+    ['_'] = CC_IDENTIFIER_START,
+
+    CHAR_CLASS_RANGE('0', '9', CC_DIGIT | CC_NUMBER),
+    ['.'] = CC_NUMBER,
+};
+
+static inline bool char_is(char ch, CharClass char_class) {
+    return lexer_char_classes[(unsigned char)ch] & char_class;
+}
+
+size_t scalar_skip_whitespace(const char *buffer, size_t position) {
+    while (char_is(buffer[position], CC_SPACE)) {
+        position++;
+    }
+
+    return position;
+}
+
+size_t scalar_skip_identifier(const char *buffer, size_t position) {
+    while (char_is(buffer[position], CC_IDENTIFIER)) {
+        position++;
+    }
+
+    return position;
+}
+
+size_t scalar_find_line_end(const char *buffer, size_t position) {
+    while (buffer[position] != '\n' && buffer[position] != '\0') {
+        position++;
+    }
+
+    return position;
+}
+
+size_t scalar_find_comment_end(const char *buffer, size_t position) {
+    while (buffer[position] != '\0' &&
+           (buffer[position] != '*' || buffer[position + 1] != '/')) {
+        position++;
+    }
+
+    return position;
+}
+
+static const LexerScanKernels scalar_kernels = {
+    .name = "scalar",
+    .skip_whitespace = scalar_skip_whitespace,
+    .skip_identifier = scalar_skip_identifier,
+    .find_line_end = scalar_find_line_end,
+    .find_comment_end = scalar_find_comment_end,
+};
+
+#ifdef LEXER_SCAN_X86
+
+// Byte-wise unsigned range checks, SSE2 and AVX2 have no unsigned byte
+// comparison, so x is in [lo, hi] when max(x, lo) == x and min(x, hi) == x
+
+static inline __m128i sse2_in_range(__m128i x, char lo, char hi) {
+    return _mm_and_si128(
+        _mm_cmpeq_epi8(_mm_max_epu8(x, _mm_set1_epi8(lo)), x),
+        _mm_cmpeq_epi8(_mm_min_epu8(x, _mm_set1_epi8(hi)), x));
+}
+
+static inline __m128i sse2_whitespace_mask(__m128i x) {
+    return _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(' ')),
+                        sse2_in_range(x, '\t', '\r'));
+}
+
+static inline __m128i sse2_identifier_mask(__m128i x) {
+    __m128i lower = _mm_or_si128(x, _mm_set1_epi8(0x20));
+
+    return _mm_or_si128(
+        _mm_or_si128(sse2_in_range(lower, 'a', 'z'),
+                     sse2_in_range(x, '0', '9')),
+        _mm_cmpeq_epi8(x, _mm_set1_epi8('_')));
+}
+
+size_t sse2_skip_whitespace(const char *buffer, size_t position) {
+    while (true) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)&buffer[position]);
+        unsigned mask =
+            ~_mm_movemask_epi8(sse2_whitespace_mask(chunk)) & 0xFFFF;
+
+        if (mask != 0) {
+            return position + __builtin_ctz(mask);
+        }
+
+        position += 16;
+    }
+}
+
+size_t sse2_skip_identifier(const char *buffer, size_t position) {
+    while (true) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)&buffer[position]);
+        unsigned mask =
+            ~_mm_movemask_epi8(sse2_identifier_mask(chunk)) & 0xFFFF;
+
+        if (mask != 0) {
+            return position + __builtin_ctz(mask);
+        }
+
+        position += 16;
+    }
+}
+
+size_t sse2_find_line_end(const char *buffer, size_t position) {
+    while (true) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)&buffer[position]);
+        unsigned mask = _mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')),
+                         _mm_cmpeq_epi8(chunk, _mm_setzero_si128())));
+
+        if (mask != 0) {
+            return position + __builtin_ctz(mask);
+        }
+
+        position += 16;
+    }
+}
+
+size_t sse2_find_comment_end(const char *buffer, size_t position) {
+    while (true) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)&buffer[position]);
+        __m128i next =
+            _mm_loadu_si128((const __m128i *)&buffer[position + 1]);
+
+        unsigned mask = _mm_movemask_epi8(_mm_or_si128(
+            _mm_and_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('*')),
+                          _mm_cmpeq_epi8(next, _mm_set1_epi8('/'))),
+            _mm_cmpeq_epi8(chunk, _mm_setzero_si128())));
+
+        if (mask != 0) {
+            return position + __builtin_ctz(mask);
+        }
+
+        position += 16;
+    }
+}
+
+static const LexerScanKernels sse2_kernels = {
+    .name = "sse2",
+    .skip_whitespace = sse2_skip_whitespace,
+    .skip_identifier = sse2_skip_identifier,
+    .find_line_end = sse2_find_line_end,
+    .find_comment_end = sse2_find_comment_end,
+};
+
+#define AVX2 __attribute__((target("avx2")))
+
+static inline AVX2 __m256i avx2_in_range(__m256i x, char lo, char hi) {
+    return _mm256_and_si256(
+        _mm256_cmpeq_epi8(_mm256_max_epu8(x, _mm256_set1_epi8(lo)), x),
+        _mm256_cmpeq_epi8(_mm256_min_epu8(x, _mm256_set1_epi8(hi)), x));
+}
+
+AVX2 size_t avx2_skip_whitespace(const char *buffer, size_t position) {
+    while (true) {
+        __m256i chunk =
+            _mm256_loadu_si256((const __m256i *)&buffer[position]);
+        unsigned mask = ~(unsigned)_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')),
+                            avx2_in_range(chunk, '\t', '\r')));
+
+        if (mask != 0) {
+            return position + __builtin_ctz(mask);
+        }
+
+        position += 32;
+    }
+}
+
+AVX2 size_t avx2_skip_identifier(const char *buffer, size_t position) {
+    while (true) {
+        __m256i chunk =
+            _mm256_loadu_si256((const __m256i *)&buffer[position]);
+        __m256i lower = _mm256_or_si256(chunk, _mm256_set1_epi8(0x20));
+
+        unsigned mask = ~(unsigned)_mm256_movemask_epi8(_mm256_or_si256(
+            _mm256_or_si256(avx2_in_range(lower, 'a', 'z'),
+                            avx2_in_range(chunk, '0', '9')),
+            _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('_'))));
+
+        if (mask != 0) {
+            return position + __builtin_ctz(mask);
+        }
+
+        position += 32;
+    }
+}
+
+AVX2 size_t avx2_find_line_end(const char *buffer, size_t position) {
+    while (true) {
+        __m256i chunk =
+            _mm256_loadu_si256((const __m256i *)&buffer[position]);
+        unsigned mask = _mm256_movemask_epi8(_mm256_or_si256(
+            _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n')),
+            _mm256_cmpeq_epi8(chunk, _mm256_setzero_si256())));
+
+        if (mask != 0) {
+            return position + __builtin_ctz(mask);
+        }
+
+        position += 32;
+    }
+}
+
+AVX2 size_t avx2_find_comment_end(const char *buffer, size_t position) {
+    while (true) {
+        __m256i chunk =
+            _mm256_loadu_si256((const __m256i *)&buffer[position]);
+        __m256i next =
+            _mm256_loadu_si256((const __m256i *)&buffer[position + 1]);
+
+        unsigned mask = _mm256_movemask_epi8(_mm256_or_si256(
+            _mm256_and_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('*')),
+                             _mm256_cmpeq_epi8(next, _mm256_set1_epi8('/'))),
+            _mm256_cmpeq_epi8(chunk, _mm256_setzero_si256())));
+
+        if (mask != 0) {
+            return position + __builtin_ctz(mask);
+        }
+
+        position += 32;
+    }
+}
+
+static const LexerScanKernels avx2_kernels = {
+    .name = "avx2",
+    .skip_whitespace = avx2_skip_whitespace,
+    .skip_identifier = avx2_skip_identifier,
+    .find_line_end = avx2_find_line_end,
+    .find_comment_end = avx2_find_comment_end,
+};
+
+#endif
+
+// YCC_LEXER_SCAN=scalar|sse2|avx2 forces a set of kernels, which is how
+// make check compares the tokens of the vectorized kernels with the scalar ones
+const LexerScanKernels *lexer_scan_kernels_select(void) {
+    const LexerScanKernels *available[] = {
+#ifdef LEXER_SCAN_X86
+        __builtin_cpu_supports("avx2") ? &avx2_kernels : NULL,
+        &sse2_kernels,
+#endif
+        &scalar_kernels,
+    };
+
+    size_t available_count = sizeof(available) / sizeof(*available);
+
+    const char *forced = getenv("YCC_LEXER_SCAN");
+
+    if (forced == NULL) {
+        for (size_t i = 0; i < available_count; i++) {
+            if (available[i] != NULL) {
+                return available[i];
+            }
+        }
+    }
+
+    for (size_t i = 0; i < available_count; i++) {
+        if (available[i] != NULL && strcmp(available[i]->name, forced) == 0) {
+            return available[i];
+        }
+    }
+
+    fprintf(stderr, "error: scanning kernels '%s' are not available\n",
+            forced);
+
+    exit(1);
+}
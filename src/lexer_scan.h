@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+
+typedef enum {
+    CC_SPACE = 1 << 0,
+    CC_IDENTIFIER_START = 1 << 1,
+    CC_DIGIT = 1 << 2,
+    CC_NUMBER = 1 << 3,
+} CharClass;
+
+#define CC_IDENTIFIER (CC_IDENTIFIER_START | CC_DIGIT)
+
+extern const unsigned char lexer_char_classes[256];
+
+// Scanning kernels over a '\0' terminated buffer followed by at least 32 more
+// readable bytes (see INPUT_FILE_PADDING), each takes the position to start
+// from and returns the position of the first character it does not consume
+typedef struct {
+    const char *name;
+
+    size_t (*skip_whitespace)(const char *buffer, size_t position);
+    size_t (*skip_identifier)(const char *buffer, size_t position);
+
+    // Returns the position of the next '\n' or '\0'
+    size_t (*find_line_end)(const char *buffer, size_t position);
+
+    // Returns the position of the next "*/" or '\0'
+    size_t (*find_comment_end)(const char *buffer, size_t position);
+} LexerScanKernels;
+
+const LexerScanKernels *lexer_scan_kernels_select(void);
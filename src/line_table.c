@@ -0,0 +1,50 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "dynamic_array.h"
+#include "line_table.h"
+
+LineTable line_table_build(const char *buffer, size_t length) {
+    LineTable line_table = {0};
+
+    da_append(&line_table, 0);
+
+    const char *end = buffer + length;
+    const char *newline = buffer;
+
+    // memchr is vectorized by the C library, so this touches every byte once
+    // at memory bandwidth instead of looping over each character
+    while ((newline = memchr(newline, '\n', end - newline)) != NULL) {
+        newline++;
+
+        da_append(&line_table, newline - buffer);
+    }
+
+    return line_table;
+}
+
+LineColumn line_table_resolve(const LineTable *line_table, uint32_t offset) {
+    size_t low = 0;
+    size_t high = line_table->count;
+
+    // Find the last line that starts at or before the offset
+    while (high - low > 1) {
+        size_t middle = low + (high - low) / 2;
+
+        if (line_table->items[middle] <= offset) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+
+    return (LineColumn){.line = low + 1,
+                        .column = offset - line_table->items[low] + 1};
+}
+
+void line_table_free(LineTable *line_table) {
+    da_free(*line_table);
+
+    *line_table = (LineTable){0};
+}
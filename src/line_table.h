@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    size_t line;
+    size_t column;
+} LineColumn;
+
+// Byte offsets at which every line of a buffer starts, sorted
+typedef struct {
+    uint32_t *items;
+    size_t count;
+    size_t capacity;
+} LineTable;
+
+LineTable line_table_build(const char *buffer, size_t length);
+LineColumn line_table_resolve(const LineTable *line_table, uint32_t offset);
+void line_table_free(LineTable *line_table);
@@ -1,25 +1,275 @@
 #include <malloc.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include <llvm-c/Core.h>
+
+#include "arena.h"
+#include "cache.h"
 #include "cli.h"
 #include "driver.h"
+#include "input_file.h"
+#include "jobs.h"
+#include "lexer.h"
+#include "server.h"
+#include "target.h"
+#include "type.h"
 
-int main(int argc, const char **argv) {
+typedef struct {
+    CLI *cli;
+
+    // What each unit is compiled with, executables built with -flto link
+    // bitcode instead of objects
+    CompileOptions options;
+
+    Cache cache;
+    bool cached; // False when the cache is disabled or has no directory
+
+    // Indexed like the input files, so the link order does not depend on
+    // which thread finishes first
+    const char **object_paths;
+    LLVMMemoryBufferRef *lto_modules; // NULL without -flto
+} MainCompilation;
+
+// The state of incremental compilation sits next to the object of the unit
+static char *main_state_path(const CLI *cli, const InputFile *input_file) {
+    char *object_path =
+        cli->options.output_kind == OK_OBJECT && cli->output_path != NULL
+            ? strdup(cli->output_path)
+            : driver_output_path(input_file->file_path, OK_OBJECT);
+
+    if (object_path == NULL) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    size_t length = strlen(object_path) + sizeof(".ycc-state");
+    char *state_path = malloc(length);
+
+    if (state_path == NULL) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    snprintf(state_path, length, "%s.ycc-state", object_path);
+
+    free(object_path);
+
+    return state_path;
+}
+
+static void main_compile_input(void *context, size_t index) {
+    MainCompilation *compilation = context;
+    CLI *cli = compilation->cli;
+    InputFile *input_file = &cli->input_files.items[index];
+    const CompileOptions *options = &compilation->options;
+    OutputKind output_kind = cli->options.output_kind;
+
+    // Headers are part of the cache key as the preprocessor pasted them in
+    driver_preprocess(input_file, options);
+
+    LLVMMemoryBufferRef output = NULL;
+    CacheKey key;
+
+    if (output_kind == OK_PREPROCESSED) {
+        output = LLVMCreateMemoryBufferWithMemoryRangeCopy(
+            input_file->file_content, input_file->file_length,
+            input_file->file_path);
+    } else if (compilation->cached) {
+        key = cache_key(input_file, options);
+        output = cache_lookup(&compilation->cache, key);
+    }
+
+    if (output == NULL) {
+        char *state_path = options->incremental
+                               ? main_state_path(cli, input_file)
+                               : NULL;
+
+        output = driver_compile(input_file, options, state_path);
+
+        free(state_path);
+
+        if (compilation->cached) {
+            cache_store(&compilation->cache, key, output);
+        }
+    }
+
+    if (compilation->lto_modules != NULL) {
+        compilation->lto_modules[index] = output;
+        input_file_free(input_file);
+        return;
+    }
+
+    if (output_kind == OK_EXECUTABLE) {
+        compilation->object_paths[index] = driver_write_temporary(output);
+    } else if (cli->output_path != NULL) {
+        driver_write_output(cli->output_path, output);
+    } else if (output_kind == OK_PREPROCESSED) {
+        driver_write_output("-", output);
+    } else {
+        char *output_path =
+            driver_output_path(input_file->file_path, output_kind);
+
+        driver_write_output(output_path, output);
+
+        free(output_path);
+    }
+
+    LLVMDisposeMemoryBuffer(output);
+    input_file_free(input_file);
+}
+
+// One line of start, length and kind per token, the output only depends on
+// the lexer and not on the scanning kernels it runs on
+static void main_dump_tokens(const InputFile *input_file) {
+    Arena arena = arena_new(false);
+    Tokens tokens = lexer_tokenize(&arena, input_file->file_content,
+                                   input_file->file_length);
+
+    for (size_t i = 0; i < tokens.count; i++) {
+        printf("%u %u %u\n", (unsigned)tokens.items[i].start,
+               (unsigned)tokens.items[i].length,
+               (unsigned)tokens.items[i].kind);
+    }
+
+    arena_free(&arena);
+}
+
+static int main_compile(int argc, const char **argv) {
     CLI cli = cli_parse(argc, argv);
 
+    // Every unit of the command line is compiled for the same target
+    type_target_layout = target_type_layout(&cli.options);
+
+    if (cli.cache_stats) {
+        Cache cache;
+
+        if (!cache_open(&cache)) {
+            fprintf(stderr, "error: no usable cache directory\n");
+            return 1;
+        }
+
+        bool printed = cache_print_stats(&cache);
+        cache_close(&cache);
+
+        return printed ? 0 : 1;
+    }
+
     if (cli.input_files.count == 0) {
         fprintf(stderr, "error: no input files provided\n");
         return 1;
     }
 
-    if (cli.input_files.count > 1) {
-        fprintf(stderr, "todo: multiple input files not handled yet\n");
+    if (cli.dump_tokens) {
+        for (size_t i = 0; i < cli.input_files.count; i++) {
+            main_dump_tokens(&cli.input_files.items[i]);
+        }
+
+        return 0;
+    }
+
+    if (cli.run) {
+        driver_preprocess(&cli.input_files.items[0], &cli.options);
+
+        return driver_run(&cli.input_files.items[0], &cli.options,
+                          cli.run_argc, cli.run_argv);
+    }
+
+    OutputKind output_kind = cli.options.output_kind;
+
+    if (output_kind != OK_EXECUTABLE && cli.output_path != NULL &&
+        cli.input_files.count > 1) {
+        fprintf(stderr, "error: cannot specify '-o' with '-c', '-S', '-E' "
+                        "or '-emit-llvm' with multiple files\n");
         return 1;
     }
 
-    driver_compile(cli.input_files.items[0].file_path,
-                   cli.input_files.items[0].file_content);
+    MainCompilation compilation = {
+        .cli = &cli,
+        .options = cli.options,
+        .object_paths = malloc(cli.input_files.count * sizeof(const char *)),
+    };
+
+    bool lto = output_kind == OK_EXECUTABLE && cli.options.lto != LTO_NONE;
+
+    if (lto) {
+        compilation.options.output_kind = OK_LLVM_BITCODE;
+        compilation.lto_modules =
+            malloc(cli.input_files.count * sizeof(LLVMMemoryBufferRef));
+
+        if (compilation.lto_modules == NULL) {
+            printf("out of memory\n");
+            exit(1);
+        }
+    }
+
+    // The preprocessed text goes to the standard output in input order
+    bool preprocess_only = output_kind == OK_PREPROCESSED;
+
+    compilation.cached =
+        !preprocess_only && cli.options.cache && cache_open(&compilation.cache);
+
+    // A unit with an error fails alone, every unit reports its own errors
+    // and nothing is linked unless all of them compiled
+    bool compiled =
+        jobs_run(cli.input_files.count, preprocess_only ? 1 : cli.options.jobs,
+                 main_compile_input, &compilation);
+
+    const char *output_path =
+        cli.output_path != NULL ? cli.output_path : "a.out";
+
+    bool linked;
+
+    if (!compiled) {
+        linked = false;
+    } else if (lto) {
+        linked = driver_link_lto(
+            compilation.lto_modules, cli.input_files.count, &cli.options,
+            compilation.cached ? &compilation.cache : NULL, output_path);
+    } else {
+        linked = output_kind != OK_EXECUTABLE ||
+                 driver_link(compilation.object_paths, cli.input_files.count,
+                             output_path);
+    }
+
+    free(compilation.lto_modules);
+    free(compilation.object_paths);
+
+    if (compilation.cached) {
+        cache_close(&compilation.cache);
+    }
+
+    return linked ? 0 : 1;
+}
+
+// --server[=path] runs the compile server, otherwise the command line is
+// handed to the server named by $YCC_SERVER when one is listening there
+int main(int argc, const char **argv) {
+    if (argc == 2 && strncmp(argv[1], "--server", 8) == 0) {
+        if (argv[1][8] == '=') {
+            return server_run(argv[1] + 9, main_compile);
+        }
+
+        if (argv[1][8] == '\0') {
+            const char *socket_path = getenv("YCC_SERVER");
+
+            return server_run(socket_path != NULL
+                                  ? socket_path
+                                  : server_default_socket_path(),
+                              main_compile);
+        }
+    }
+
+    const char *socket_path = getenv("YCC_SERVER");
+    int status;
+
+    if (socket_path != NULL && socket_path[0] != '\0' &&
+        server_forward(socket_path, argc, argv, &status)) {
+        return status;
+    }
 
-    driver_link("a.out");
+    return main_compile(argc, argv);
 }
@@ -1,3 +0,0 @@
-#include <stddef.h>
-
-void *memdup(void *p, size_t n);
@@ -0,0 +1,123 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <llvm-c/Error.h>
+#include <llvm-c/TargetMachine.h>
+#include <llvm-c/Transforms/PassBuilder.h>
+#include <llvm-c/Types.h>
+
+#include "compile_options.h"
+#include "diagnostics.h"
+#include "optimizer.h"
+
+static const char *optimizer_pipelines[][OL_OZ + 1] = {
+    [OP_COMPILE] =
+        {
+            [OL_O0] = NULL,
+            [OL_O1] = "default<O1>",
+            [OL_O2] = "default<O2>",
+            [OL_O3] = "default<O3>",
+            [OL_OS] = "default<Os>",
+            [OL_OZ] = "default<Oz>",
+        },
+    [OP_PRE_LINK] =
+        {
+            [OL_O0] = NULL,
+            [OL_O1] = "lto-pre-link<O1>",
+            [OL_O2] = "lto-pre-link<O2>",
+            [OL_O3] = "lto-pre-link<O3>",
+            [OL_OS] = "lto-pre-link<Os>",
+            [OL_OZ] = "lto-pre-link<Oz>",
+        },
+    [OP_LINK] =
+        {
+            [OL_O0] = NULL,
+            [OL_O1] = "lto<O1>",
+            [OL_O2] = "lto<O2>",
+            [OL_O3] = "lto<O3>",
+            [OL_OS] = "lto<Os>",
+            [OL_OZ] = "lto<Oz>",
+        },
+    [OP_THIN_PRE_LINK] =
+        {
+            [OL_O0] = NULL,
+            [OL_O1] = "thinlto-pre-link<O1>",
+            [OL_O2] = "thinlto-pre-link<O2>",
+            [OL_O3] = "thinlto-pre-link<O3>",
+            [OL_OS] = "thinlto-pre-link<Os>",
+            [OL_OZ] = "thinlto-pre-link<Oz>",
+        },
+    [OP_THIN_LINK] =
+        {
+            [OL_O0] = NULL,
+            [OL_O1] = "thinlto<O1>",
+            [OL_O2] = "thinlto<O2>",
+            [OL_O3] = "thinlto<O3>",
+            [OL_OS] = "thinlto<Os>",
+            [OL_OZ] = "thinlto<Oz>",
+        },
+};
+
+LLVMCodeGenOptLevel optimizer_codegen_level(OptimizationLevel level) {
+    switch (level) {
+    case OL_O0:
+        return LLVMCodeGenLevelNone;
+
+    case OL_O1:
+        return LLVMCodeGenLevelLess;
+
+    case OL_O3:
+        return LLVMCodeGenLevelAggressive;
+
+    default:
+        return LLVMCodeGenLevelDefault;
+    }
+}
+
+void optimizer_run(LLVMModuleRef module, LLVMTargetMachineRef target_machine,
+                   const CompileOptions *options, OptimizerPhase phase) {
+    OptimizationLevel level = options->optimization_level;
+
+    // -fpasses= replaces the pipeline of the phase producing the final code,
+    // so with link-time optimization it runs once on the linked modules
+    bool final = phase == OP_COMPILE || phase == OP_LINK ||
+                 phase == OP_THIN_LINK;
+
+    const char *pipeline = options->passes != NULL && final
+                               ? options->passes
+                               : optimizer_pipelines[phase][level];
+
+    if (pipeline == NULL) {
+        return;
+    }
+
+    // The pipeline tuning defaults leave vectorization off, these are the
+    // settings clang uses for each level
+    bool speed = level == OL_O2 || level == OL_O3;
+
+    LLVMPassBuilderOptionsRef pass_builder_options =
+        LLVMCreatePassBuilderOptions();
+
+    LLVMPassBuilderOptionsSetLoopUnrolling(pass_builder_options, speed);
+    LLVMPassBuilderOptionsSetLoopInterleaving(pass_builder_options, speed);
+    LLVMPassBuilderOptionsSetLoopVectorization(pass_builder_options,
+                                               speed || level == OL_OS);
+    LLVMPassBuilderOptionsSetSLPVectorization(pass_builder_options,
+                                              speed || level == OL_OS);
+
+    LLVMErrorRef error =
+        LLVMRunPasses(module, pipeline, target_machine, pass_builder_options);
+
+    LLVMDisposePassBuilderOptions(pass_builder_options);
+
+    if (error != NULL) {
+        char *message = LLVMGetErrorMessage(error);
+
+        fprintf(stderr, "error: invalid pass pipeline '%s': %s\n", pipeline,
+                message);
+
+        LLVMDisposeErrorMessage(message);
+        diagnostics_fail();
+    }
+}
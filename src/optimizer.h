@@ -0,0 +1,24 @@
+#pragma once
+
+#include <llvm-c/TargetMachine.h>
+#include <llvm-c/Types.h>
+
+#include "compile_options.h"
+
+// Backend optimization level matching the IR optimization level
+LLVMCodeGenOptLevel optimizer_codegen_level(OptimizationLevel level);
+
+// Modules compiled for link-time optimization leave the passes that need the
+// whole program to the pipeline run on the merged module
+typedef enum {
+    OP_COMPILE,
+    OP_PRE_LINK,
+    OP_LINK,
+    OP_THIN_PRE_LINK,
+    OP_THIN_LINK, // Run on each module with its imports
+} OptimizerPhase;
+
+// Runs the pipeline of the optimization level for the phase on the module, or
+// the one given by -fpasses= in the phases that produce the final code
+void optimizer_run(LLVMModuleRef module, LLVMTargetMachineRef target_machine,
+                   const CompileOptions *options, OptimizerPhase phase);
@@ -1,18 +1,16 @@
 #include <errno.h>
 #include <float.h>
-#include <limits.h>
-#include <malloc.h>
+#include <math.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "arena.h"
 #include "ast.h"
 #include "diagnostics.h"
-#include "dynamic_array.h"
-#include "dynamic_string.h"
+#include "interner.h"
 #include "lexer.h"
-#include "memdup.h"
 #include "parser.h"
 #include "token.h"
 #include "type.h"
@@ -25,6 +23,7 @@ Precedence precedence_from_token(TokenKind kind) {
 
     case TOK_STAR:
     case TOK_FORWARD_SLASH:
+    case TOK_PERCENT:
         return PR_PRODUCT;
 
     case TOK_OPEN_PAREN:
@@ -35,20 +34,38 @@ Precedence precedence_from_token(TokenKind kind) {
     }
 }
 
-Parser parser_new(const char *buffer) {
+Parser parser_new(Arena *arena, const char *buffer, size_t length) {
     return (Parser){
+        .arena = arena,
         .buffer = buffer,
-        .lexer = lexer_new(buffer),
+        .tokens = lexer_tokenize(arena, buffer, length),
+        .root = ast_new(arena),
     };
 }
 
-Token parser_next_token(Parser *parser) {
-    return lexer_next_token(&parser->lexer);
+// The token array always ends with TOK_EOF, which the cursor never moves past
+Token parser_lookahead_token(Parser *parser, size_t k) {
+    size_t index = parser->position + k;
+
+    if (index >= parser->tokens.count) {
+        index = parser->tokens.count - 1;
+    }
+
+    return parser->tokens.items[index];
 }
 
 Token parser_peek_token(Parser *parser) {
-    Lexer lexer_copy = parser->lexer;
-    return lexer_next_token(&lexer_copy);
+    return parser->tokens.items[parser->position];
+}
+
+Token parser_next_token(Parser *parser) {
+    Token token = parser->tokens.items[parser->position];
+
+    if (token.kind != TOK_EOF) {
+        parser->position++;
+    }
+
+    return token;
 }
 
 bool parser_eat_token(Parser *parser, TokenKind kind) {
@@ -61,42 +78,27 @@ bool parser_eat_token(Parser *parser, TokenKind kind) {
     }
 }
 
-SourceLoc buffer_loc_to_source_loc(const char *buffer, BufferLoc buffer_loc) {
-    SourceLoc source_loc = {1, 1};
-
-    for (size_t i = 0; i < buffer_loc.start; i++) {
-        if (buffer[i] == '\n') {
-            source_loc.line++;
-            source_loc.column = 0;
-        }
-
-        source_loc.column++;
-    }
-
-    return source_loc;
-}
-
-Type parser_parse_type(Parser *parser) {
+TypeId parser_parse_type(Parser *parser) {
     Token token = parser_next_token(parser);
-    Type type = {0};
+    TypeId type = TY_VOID;
 
     switch (token.kind) {
     case TOK_KEYWORD_VOID:
-        type.kind = TY_VOID;
+        type = TY_VOID;
         break;
 
     case TOK_KEYWORD_CHAR:
-        type.kind = TY_CHAR;
+        type = TY_CHAR;
         break;
 
     case TOK_KEYWORD_SHORT:
         parser_eat_token(parser, TOK_KEYWORD_INT);
 
-        type.kind = TY_SHORT;
+        type = TY_SHORT;
         break;
 
     case TOK_KEYWORD_INT:
-        type.kind = TY_INT;
+        type = TY_INT;
         break;
 
     case TOK_KEYWORD_LONG:
@@ -104,31 +106,60 @@ Type parser_parse_type(Parser *parser) {
             parser_next_token(parser);
             parser_eat_token(parser, TOK_KEYWORD_INT);
 
-            type.kind = TY_LONG_LONG;
+            type = TY_LONG_LONG;
         } else if (parser_peek_token(parser).kind == TOK_KEYWORD_DOUBLE) {
             parser_next_token(parser);
-            type.kind = TY_LONG_DOUBLE;
+            type = TY_LONG_DOUBLE;
         } else {
             parser_eat_token(parser, TOK_KEYWORD_INT);
 
-            type.kind = TY_LONG;
+            type = TY_LONG;
         }
 
         break;
 
     case TOK_KEYWORD_FLOAT:
-        type.kind = TY_FLOAT;
+        type = TY_FLOAT;
         break;
 
     case TOK_KEYWORD_DOUBLE:
-        type.kind = TY_DOUBLE;
+        type = TY_DOUBLE;
+        break;
+
+    // 'signed char' is the same type as 'char', which is signed on every
+    // supported target
+    case TOK_KEYWORD_SIGNED:
+    case TOK_KEYWORD_UNSIGNED:
+        type = TY_INT;
+
+        switch (parser_peek_token(parser).kind) {
+        case TOK_KEYWORD_CHAR:
+        case TOK_KEYWORD_SHORT:
+        case TOK_KEYWORD_INT:
+        case TOK_KEYWORD_LONG:
+            type = parser_parse_type(parser);
+            break;
+
+        default:
+            break;
+        }
+
+        if (!type_is_integer(type)) {
+            errorf(token.start, "expected an integer type");
+
+            diagnostics_fail();
+        }
+
+        if (token.kind == TOK_KEYWORD_UNSIGNED) {
+            type = type_to_unsigned(type);
+        }
+
         break;
 
     default:
-        errorf(buffer_loc_to_source_loc(parser->buffer, token.loc),
-               "unkown type");
+        errorf(token.start, "unkown type");
 
-        exit(1);
+        diagnostics_fail();
     }
 
     return type;
@@ -136,249 +167,327 @@ Type parser_parse_type(Parser *parser) {
 
 Name parser_parse_name(Parser *parser) {
     if (parser_peek_token(parser).kind != TOK_IDENTIFIER) {
-        errorf(buffer_loc_to_source_loc(parser->buffer,
-                                        parser_peek_token(parser).loc),
-               "expected an identifier");
+        errorf(parser_peek_token(parser).start, "expected an identifier");
 
-        exit(1);
+        diagnostics_fail();
     }
 
     Token identifier_token = parser_next_token(parser);
 
-    DynamicString name_string = {0};
-
-    for (size_t i = identifier_token.loc.start; i < identifier_token.loc.end;
-         i++) {
-        da_append(&name_string, parser->buffer[i]);
-    }
-
-    da_append(&name_string, '\0');
+    Atom atom = interner_intern(&parser->buffer[identifier_token.start],
+                                identifier_token.length);
 
-    return (Name){
-        .buffer = name_string.items,
-        .loc = buffer_loc_to_source_loc(parser->buffer, identifier_token.loc)};
+    return (Name){.atom = atom, .loc = identifier_token.start};
 }
 
-ASTExpr parser_parse_expr(Parser *parser, Precedence precedence);
+ASTIndex parser_parse_expr(Parser *parser, Precedence precedence);
 
 ASTUnaryOperation
 parser_parse_unary_operation(Parser *parser, ASTUnaryOperator unary_operator) {
     parser_next_token(parser);
 
-    ASTExpr rhs = parser_parse_expr(parser, PR_PREFIX);
+    ASTIndex rhs = parser_parse_expr(parser, PR_PREFIX);
+
+    return (ASTUnaryOperation){.unary_operator = unary_operator, .rhs = rhs};
+}
+
+static bool parser_int_fits(TypeId type, unsigned long long value) {
+    unsigned bits = type_integer_bits(type) - !type_is_unsigned(type);
+
+    return bits >= 64 || value < 1ull << bits;
+}
+
+// The first of int, unsigned int, long, unsigned long, long long and unsigned
+// long long which holds the value, leaving out what the suffix rules out, and
+// the unsigned types for decimal constants without 'u' (C11 6.4.4.1)
+static TypeId parser_int_type(unsigned long long value, bool decimal,
+                              bool is_unsigned, int longs) {
+    static const TypeId candidates[] = {
+        TY_INT,       TY_UNSIGNED_INT,
+        TY_LONG,      TY_UNSIGNED_LONG,
+        TY_LONG_LONG, TY_UNSIGNED_LONG_LONG,
+    };
+
+    for (size_t i = (size_t)longs * 2;
+         i < sizeof(candidates) / sizeof(candidates[0]); i++) {
+        TypeId type = candidates[i];
+
+        if (type_is_unsigned(type) ? !is_unsigned && decimal : is_unsigned) {
+            continue;
+        }
 
-    ASTExpr *rhs_on_heap = memdup(&rhs, sizeof(ASTExpr));
+        if (parser_int_fits(type, value)) {
+            return type;
+        }
+    }
 
-    return (ASTUnaryOperation){.unary_operator = unary_operator,
-                               .rhs = rhs_on_heap};
+    return TY_VOID;
 }
 
-ASTExpr parser_parse_int_expression(Parser *parser) {
+ASTIndex parser_parse_int_expression(Parser *parser) {
     Token int_token = parser_next_token(parser);
-    SourceLoc loc = buffer_loc_to_source_loc(parser->buffer, int_token.loc);
+    SourceLoc loc = int_token.start;
+
+    ArenaCheckpoint checkpoint = arena_checkpoint(parser->arena);
+
+    char *int_string = arena_strndup(
+        parser->arena, &parser->buffer[int_token.start], int_token.length);
+
+    errno = 0;
+
+    char *suffix;
+    unsigned long long intval = strtoull(int_string, &suffix, 0);
+    bool overflow = errno == ERANGE;
+    bool decimal = int_string[0] != '0' || suffix == int_string + 1;
+
+    bool is_unsigned = false;
+    int longs = 0;
+
+    while (true) {
+        if ((*suffix == 'u' || *suffix == 'U') && !is_unsigned) {
+            is_unsigned = true;
+            suffix++;
+        } else if ((*suffix == 'l' || *suffix == 'L') && longs == 0) {
+            longs = suffix[1] == suffix[0] ? 2 : 1;
+            suffix += longs;
+        } else {
+            break;
+        }
+    }
 
-    DynamicString int_string = {0};
+    if (*suffix != '\0') {
+        errorf(loc, "invalid suffix '%s' on integer constant", suffix);
 
-    for (size_t i = int_token.loc.start; i < int_token.loc.end; i++) {
-        da_append(&int_string, parser->buffer[i]);
+        diagnostics_fail();
     }
 
-    da_append(&int_string, '\0');
+    arena_rollback(parser->arena, checkpoint);
 
-    unsigned long long intval = atoll(int_string.items);
+    TypeId type = overflow ? TY_VOID
+                           : parser_int_type(intval, decimal, is_unsigned,
+                                             longs);
 
-    if (errno == ERANGE) {
-        errorf(loc, intval == LLONG_MAX
-                        ? "integer constant is too big to represent in any "
-                          "integer type"
-                        : "integer constant is too small to represent in "
-                          "any integer type");
+    if (type == TY_VOID) {
+        errorf(loc, "integer constant is too big to represent in any "
+                    "integer type");
 
-        exit(1);
+        diagnostics_fail();
     }
 
-    return (ASTExpr){.value = {.intval = intval}, .kind = EK_INT, .loc = loc};
+    ASTIndex expr = ast_add_expr(&parser->root, EK_INT, loc,
+                                 (ASTExprValue){.intval = intval});
+
+    parser->root.exprs.types[expr] = type;
+
+    return expr;
 }
 
-ASTExpr parser_parse_float_expression(Parser *parser) {
+ASTIndex parser_parse_float_expression(Parser *parser) {
     Token float_token = parser_next_token(parser);
-    SourceLoc loc = buffer_loc_to_source_loc(parser->buffer, float_token.loc);
+    SourceLoc loc = float_token.start;
+
+    ArenaCheckpoint checkpoint = arena_checkpoint(parser->arena);
 
-    DynamicString float_string = {0};
+    char *float_string = arena_strndup(
+        parser->arena, &parser->buffer[float_token.start], float_token.length);
 
-    for (size_t i = float_token.loc.start; i < float_token.loc.end; i++) {
-        da_append(&float_string, parser->buffer[i]);
+    errno = 0;
+
+    char *suffix;
+    double floatval = strtod(float_string, &suffix);
+    bool overflow = errno == ERANGE;
+    TypeId type = TY_DOUBLE;
+
+    if (*suffix == 'f' || *suffix == 'F') {
+        type = TY_FLOAT;
+        suffix++;
+    } else if (*suffix == 'l' || *suffix == 'L') {
+        type = TY_LONG_DOUBLE;
+        suffix++;
     }
 
-    da_append(&float_string, '\0');
+    if (*suffix != '\0') {
+        errorf(loc, "invalid suffix '%s' on floating constant", suffix);
+
+        diagnostics_fail();
+    }
 
-    long double floatval = strtold(float_string.items, NULL);
+    arena_rollback(parser->arena, checkpoint);
 
-    if (errno == ERANGE) {
-        errorf(loc, floatval == LDBL_MAX
+    if (overflow) {
+        errorf(loc, floatval == HUGE_VAL
                         ? "float constant is too big to represent in any "
                           "float type"
                         : "float constant is too small to represent in "
                           "any float type");
 
-        exit(1);
+        diagnostics_fail();
+    }
+
+    // Literals hold the value of their type, like folded expressions
+    if (type == TY_FLOAT) {
+        floatval = (float)floatval;
     }
 
-    return (ASTExpr){
-        .value = {.floatval = floatval}, .kind = EK_FLOAT, .loc = loc};
+    ASTIndex expr = ast_add_expr(&parser->root, EK_FLOAT, loc,
+                                 (ASTExprValue){.floatval = floatval});
+
+    parser->root.exprs.types[expr] = type;
+
+    return expr;
 }
 
-ASTExpr parser_parse_identifier_expression(Parser *parser) {
+ASTIndex parser_parse_identifier_expression(Parser *parser) {
     Name name = parser_parse_name(parser);
 
-    return (ASTExpr){.value = {.identifier = {.name = name}},
-                     .kind = EK_IDENTIFIER,
-                     name.loc};
-}
+    ASTIdentifier identifier = {.name = name, .symbol = SYMBOL_ID_NONE};
 
-ASTExpr parser_parse_unary_expression(Parser *parser) {
-    SourceLoc loc =
-        buffer_loc_to_source_loc(parser->buffer, parser_peek_token(parser).loc);
+    return ast_add_expr(&parser->root, EK_IDENTIFIER, name.loc,
+                        (ASTExprValue){.identifier = identifier});
+}
 
-    ASTExpr expr = {.kind = EK_UNARY_OPERATION, .loc = loc};
+ASTIndex parser_parse_unary_expression(Parser *parser) {
+    SourceLoc loc = parser_peek_token(parser).start;
 
     switch (parser_peek_token(parser).kind) {
     case TOK_MINUS:
-        expr.value.unary = parser_parse_unary_operation(parser, UO_MINUS);
-        break;
+        return ast_add_expr(
+            &parser->root, EK_UNARY_OPERATION, loc,
+            (ASTExprValue){
+                .unary = parser_parse_unary_operation(parser, UO_MINUS)});
 
     case TOK_BANG:
-        expr.value.unary = parser_parse_unary_operation(parser, UO_BANG);
-        break;
+        return ast_add_expr(
+            &parser->root, EK_UNARY_OPERATION, loc,
+            (ASTExprValue){
+                .unary = parser_parse_unary_operation(parser, UO_BANG)});
 
     case TOK_INT:
-        expr = parser_parse_int_expression(parser);
-        break;
+        return parser_parse_int_expression(parser);
 
     case TOK_FLOAT:
-        expr = parser_parse_float_expression(parser);
-        break;
+        return parser_parse_float_expression(parser);
 
     case TOK_IDENTIFIER:
-        expr = parser_parse_identifier_expression(parser);
-        break;
+        return parser_parse_identifier_expression(parser);
 
     default:
-        errorf(buffer_loc_to_source_loc(parser->buffer,
-                                        parser_peek_token(parser).loc),
-               "unexpected token");
+        errorf(parser_peek_token(parser).start, "unexpected token");
 
-        exit(1);
+        diagnostics_fail();
     }
-
-    return expr;
 }
 
 ASTBinaryOperation
-parser_parse_binary_operation(Parser *parser, ASTExpr lhs,
+parser_parse_binary_operation(Parser *parser, ASTIndex lhs,
                               ASTBinaryOperator binary_operator) {
     Token binary_operator_token = parser_next_token(parser);
 
-    ASTExpr rhs = parser_parse_expr(
+    ASTIndex rhs = parser_parse_expr(
         parser, precedence_from_token(binary_operator_token.kind));
 
-    ASTExpr *lhs_on_heap = memdup(&lhs, sizeof(ASTExpr));
-    ASTExpr *rhs_on_heap = memdup(&rhs, sizeof(ASTExpr));
+    return (ASTBinaryOperation){
+        .lhs = lhs, .rhs = rhs, .binary_operator = binary_operator};
+}
+
+// Nested lists are collected on the scratch stack and copied into the extra
+// pool once complete, so every list ends up contiguous
+ASTRange parser_pop_scratch(Parser *parser, size_t scratch_start) {
+    ASTRange range =
+        ast_add_extra(&parser->root, &parser->scratch.items[scratch_start],
+                      parser->scratch.count - scratch_start);
+
+    parser->scratch.count = scratch_start;
 
-    return (ASTBinaryOperation){.lhs = lhs_on_heap,
-                                .binary_operator = binary_operator,
-                                .rhs = rhs_on_heap};
+    return range;
 }
 
-ASTExprs parser_parse_call_arguments(Parser *parser) {
+ASTRange parser_parse_call_arguments(Parser *parser) {
     if (!parser_eat_token(parser, TOK_OPEN_PAREN)) {
-        errorf(buffer_loc_to_source_loc(parser->buffer,
-                                        parser_peek_token(parser).loc),
-               "expected a '('");
+        errorf(parser_peek_token(parser).start, "expected a '('");
 
-        exit(1);
+        diagnostics_fail();
     }
 
-    ASTExprs arguments = {0};
+    size_t scratch_start = parser->scratch.count;
 
     while (parser_peek_token(parser).kind != TOK_EOF &&
            parser_peek_token(parser).kind != TOK_CLOSE_PAREN) {
-        da_append(&arguments, parser_parse_expr(parser, PR_LOWEST));
+        ASTIndex argument = parser_parse_expr(parser, PR_LOWEST);
+
+        arena_da_append(parser->arena, &parser->scratch, argument);
 
         if (!parser_eat_token(parser, TOK_COMMA) &&
             parser_peek_token(parser).kind != TOK_CLOSE_PAREN) {
-            errorf(buffer_loc_to_source_loc(parser->buffer,
-                                            parser_peek_token(parser).loc),
-                   "expected a ','");
+            errorf(parser_peek_token(parser).start, "expected a ','");
 
-            exit(1);
+            diagnostics_fail();
         }
     }
 
     if (!parser_eat_token(parser, TOK_CLOSE_PAREN)) {
-        errorf(buffer_loc_to_source_loc(parser->buffer,
-                                        parser_peek_token(parser).loc),
-               "expected a ')'");
+        errorf(parser_peek_token(parser).start, "expected a ')'");
 
-        exit(1);
+        diagnostics_fail();
     }
 
-    return arguments;
+    return parser_pop_scratch(parser, scratch_start);
 }
 
-ASTExpr parser_parse_call_expression(Parser *parser, ASTExpr callable) {
-    ASTExprs arguments = parser_parse_call_arguments(parser);
-
-    ASTExpr *callable_on_heap = memdup(&callable, sizeof(ASTExpr));
+ASTIndex parser_parse_call_expression(Parser *parser, ASTIndex callable) {
+    ASTRange arguments = parser_parse_call_arguments(parser);
 
-    ASTCall call = {.callable = callable_on_heap, .arguments = arguments};
+    ASTCall call = {.callable = callable, .arguments = arguments};
 
-    return (ASTExpr){
-        .value = {.call = call}, .kind = EK_CALL, .loc = callable.loc};
+    return ast_add_expr(&parser->root, EK_CALL,
+                        parser->root.exprs.locs[callable],
+                        (ASTExprValue){.call = call});
 }
 
-ASTExpr parser_parse_binary_expression(Parser *parser, ASTExpr lhs) {
-    SourceLoc loc =
-        buffer_loc_to_source_loc(parser->buffer, parser_peek_token(parser).loc);
+ASTIndex parser_parse_binary_expression(Parser *parser, ASTIndex lhs) {
+    SourceLoc loc = parser_peek_token(parser).start;
 
-    ASTExpr expr = {.kind = EK_BINARY_OPERATION, .loc = loc};
+    ASTBinaryOperator binary_operator;
 
     switch (parser_peek_token(parser).kind) {
     case TOK_PLUS:
-        expr.value.binary = parser_parse_binary_operation(parser, lhs, BO_PLUS);
+        binary_operator = BO_PLUS;
         break;
 
     case TOK_MINUS:
-        expr.value.binary =
-            parser_parse_binary_operation(parser, lhs, BO_MINUS);
+        binary_operator = BO_MINUS;
         break;
 
     case TOK_STAR:
-        expr.value.binary = parser_parse_binary_operation(parser, lhs, BO_STAR);
+        binary_operator = BO_STAR;
         break;
 
     case TOK_FORWARD_SLASH:
-        expr.value.binary =
-            parser_parse_binary_operation(parser, lhs, BO_FORWARD_SLASH);
+        binary_operator = BO_FORWARD_SLASH;
         break;
 
-    case TOK_OPEN_PAREN:
-        expr = parser_parse_call_expression(parser, lhs);
+    case TOK_PERCENT:
+        binary_operator = BO_PERCENT;
         break;
 
+    case TOK_OPEN_PAREN:
+        return parser_parse_call_expression(parser, lhs);
+
     default:
-        errorf(buffer_loc_to_source_loc(parser->buffer,
-                                        parser_peek_token(parser).loc),
-               "expected an expression");
+        errorf(parser_peek_token(parser).start, "expected an expression");
 
-        exit(1);
+        diagnostics_fail();
     }
 
-    return expr;
+    ASTBinaryOperation binary =
+        parser_parse_binary_operation(parser, lhs, binary_operator);
+
+    return ast_add_expr(&parser->root, EK_BINARY_OPERATION, loc,
+                        (ASTExprValue){.binary = binary});
 }
 
-ASTExpr parser_parse_expr(Parser *parser, Precedence precedence) {
-    ASTExpr lhs = parser_parse_unary_expression(parser);
+ASTIndex parser_parse_expr(Parser *parser, Precedence precedence) {
+    ASTIndex lhs = parser_parse_unary_expression(parser);
 
     while (parser_peek_token(parser).kind != TOK_SEMICOLON &&
            precedence < precedence_from_token(parser_peek_token(parser).kind)) {
@@ -388,84 +497,72 @@ ASTExpr parser_parse_expr(Parser *parser, Precedence precedence) {
     return lhs;
 }
 
-ASTDeclaration parser_parse_variable_declaration(Parser *parser, Type type,
-                                                 Name name) {
-    ASTExpr value = {0};
-    bool default_initialized = true;
+ASTIndex parser_parse_variable_declaration(Parser *parser, TypeId type,
+                                           Name name) {
+    ASTIndex value = AST_NONE;
 
     if (!parser_eat_token(parser, TOK_SEMICOLON)) {
         if (!parser_eat_token(parser, TOK_ASSIGN)) {
-            errorf(buffer_loc_to_source_loc(parser->buffer,
-                                            parser_peek_token(parser).loc),
+            errorf(parser_peek_token(parser).start,
                    "expected a ';' at the end of declaration");
 
-            exit(1);
+            diagnostics_fail();
         }
 
         value = parser_parse_expr(parser, PR_LOWEST);
-        default_initialized = false;
 
         if (!parser_eat_token(parser, TOK_SEMICOLON)) {
-            errorf(buffer_loc_to_source_loc(parser->buffer,
-                                            parser_peek_token(parser).loc),
+            errorf(parser_peek_token(parser).start,
                    "expected a ';' at the end of declaration");
 
-            exit(1);
+            diagnostics_fail();
         }
     }
 
-    ASTVariable variable = {.type = type,
-                            .name = name,
-                            .value = value,
-                            .default_initialized = default_initialized};
+    ASTVariable variable = {.type = type, .name = name, .value = value};
+
+    arena_da_append(parser->arena, &parser->root.variables, variable);
 
-    return (ASTDeclaration){
-        .value = {.variable = variable}, .kind = DK_VARIABLE, .loc = name.loc};
+    return parser->root.variables.count - 1;
 }
 
-ASTStmt parser_parse_return_stmt(Parser *parser) {
-    SourceLoc loc =
-        buffer_loc_to_source_loc(parser->buffer, parser_next_token(parser).loc);
+ASTIndex parser_parse_return_stmt(Parser *parser) {
+    SourceLoc loc = parser_next_token(parser).start;
 
-    ASTExpr value = {0};
-    bool none = true;
+    ASTIndex value = AST_NONE;
 
     if (parser_peek_token(parser).kind != TOK_SEMICOLON) {
         value = parser_parse_expr(parser, PR_LOWEST);
-        none = false;
     }
 
     if (!parser_eat_token(parser, TOK_SEMICOLON)) {
-        errorf(buffer_loc_to_source_loc(parser->buffer,
-                                        parser_peek_token(parser).loc),
+        errorf(parser_peek_token(parser).start,
                "expected a ';' at the end of statement");
 
-        exit(1);
+        diagnostics_fail();
     }
 
-    ASTReturn ret = {.value = value, .none = none};
-
-    return (ASTStmt){.value = {.ret = ret}, .kind = SK_RETURN, .loc = loc};
+    return ast_add_stmt(&parser->root, SK_RETURN, loc,
+                        (ASTStmtValue){.ret = value});
 }
 
-ASTStmt parser_parse_expr_stmt(Parser *parser) {
-    ASTExpr expr = parser_parse_expr(parser, PR_LOWEST);
+ASTIndex parser_parse_expr_stmt(Parser *parser) {
+    SourceLoc loc = parser_peek_token(parser).start;
+
+    ASTIndex expr = parser_parse_expr(parser, PR_LOWEST);
 
     if (!parser_eat_token(parser, TOK_SEMICOLON)) {
-        errorf(buffer_loc_to_source_loc(parser->buffer,
-                                        parser_peek_token(parser).loc),
+        errorf(parser_peek_token(parser).start,
                "expected a ';' at the end of statement");
 
-        exit(1);
+        diagnostics_fail();
     }
 
-    return (ASTStmt){
-        .value = {.expr = expr},
-        .kind = SK_EXPR,
-    };
+    return ast_add_stmt(&parser->root, SK_EXPR, loc,
+                        (ASTStmtValue){.expr = expr});
 }
 
-ASTStmt parser_parse_stmt(Parser *parser) {
+ASTIndex parser_parse_stmt(Parser *parser) {
     switch (parser_peek_token(parser).kind) {
     case TOK_SEMICOLON:
         parser_next_token(parser);
@@ -477,18 +574,19 @@ ASTStmt parser_parse_stmt(Parser *parser) {
     case TOK_KEYWORD_INT:
     case TOK_KEYWORD_LONG:
     case TOK_KEYWORD_FLOAT:
-    case TOK_KEYWORD_DOUBLE: {
-        Type type = parser_parse_type(parser);
+    case TOK_KEYWORD_DOUBLE:
+    case TOK_KEYWORD_SIGNED:
+    case TOK_KEYWORD_UNSIGNED: {
+        TypeId type = parser_parse_type(parser);
 
         Name name = parser_parse_name(parser);
 
-        ASTDeclaration declaration =
+        ASTIndex variable =
             parser_parse_variable_declaration(parser, type, name);
 
-        return (ASTStmt){
-            .value = {.variable_declaration = declaration.value.variable},
-            .kind = SK_VARIABLE_DECLARATION,
-            .loc = declaration.loc};
+        return ast_add_stmt(
+            &parser->root, SK_VARIABLE_DECLARATION, name.loc,
+            (ASTStmtValue){.variable_declaration = variable});
     }
 
     case TOK_KEYWORD_RETURN:
@@ -500,115 +598,111 @@ ASTStmt parser_parse_stmt(Parser *parser) {
 }
 
 ASTFunctionParameter parser_parse_function_parameter(Parser *parser) {
-    Type expected_type = parser_parse_type(parser);
+    TypeId expected_type = parser_parse_type(parser);
 
     Name name = {0};
 
-    if (expected_type.kind == TY_VOID &&
+    if (expected_type == TY_VOID &&
         parser_peek_token(parser).kind == TOK_IDENTIFIER) {
-        errorf(buffer_loc_to_source_loc(parser->buffer,
-                                        parser_peek_token(parser).loc),
+        errorf(parser_peek_token(parser).start,
                "function parameter with incomplete type");
 
-        exit(1);
-    } else if (expected_type.kind != TY_VOID) {
+        diagnostics_fail();
+    } else if (expected_type != TY_VOID) {
         name = parser_parse_name(parser);
     }
 
     return (ASTFunctionParameter){.expected_type = expected_type, .name = name};
 }
 
-ASTFunctionParameters parser_parse_function_parameters(Parser *parser) {
+// Parameters of one function are parsed without anything in between, so they
+// are consecutive in the parameters pool
+ASTRange parser_parse_function_parameters(Parser *parser, bool *variadic) {
     if (!parser_eat_token(parser, TOK_OPEN_PAREN)) {
-        errorf(buffer_loc_to_source_loc(parser->buffer,
-                                        parser_peek_token(parser).loc),
-               "expected a '('");
+        errorf(parser_peek_token(parser).start, "expected a '('");
 
-        exit(1);
+        diagnostics_fail();
     }
 
-    ASTFunctionParameters parameters = {.variadic = true};
+    ASTRange parameters = {.start = parser->root.parameters.count};
+
+    *variadic = true;
 
     while (parser_peek_token(parser).kind != TOK_EOF &&
            parser_peek_token(parser).kind != TOK_CLOSE_PAREN) {
-        SourceLoc parameter_type_loc = buffer_loc_to_source_loc(
-            parser->buffer, parser_peek_token(parser).loc);
+        SourceLoc parameter_type_loc = parser_peek_token(parser).start;
 
         ASTFunctionParameter parameter =
             parser_parse_function_parameter(parser);
 
-        if (parameter.expected_type.kind == TY_VOID) {
-            if (!parameters.variadic) {
+        if (parameter.expected_type == TY_VOID) {
+            if (!*variadic) {
                 errorf(parameter_type_loc,
                        "'void' must be the first and only parameter");
 
-                exit(1);
+                diagnostics_fail();
             }
         } else {
-            da_append(&parameters, parameter);
+            arena_da_append(parser->arena, &parser->root.parameters,
+                            parameter);
+            parameters.count++;
         }
 
-        parameters.variadic = false;
+        *variadic = false;
 
         if (!parser_eat_token(parser, TOK_COMMA) &&
             parser_peek_token(parser).kind != TOK_CLOSE_PAREN) {
-            errorf(buffer_loc_to_source_loc(parser->buffer,
-                                            parser_peek_token(parser).loc),
-                   "expected a ','");
+            errorf(parser_peek_token(parser).start, "expected a ','");
 
-            exit(1);
+            diagnostics_fail();
         }
     }
 
     if (!parser_eat_token(parser, TOK_CLOSE_PAREN)) {
-        errorf(buffer_loc_to_source_loc(parser->buffer,
-                                        parser_peek_token(parser).loc),
-               "expected a ')'");
+        errorf(parser_peek_token(parser).start, "expected a ')'");
 
-        exit(1);
+        diagnostics_fail();
     }
 
     return parameters;
 }
 
-ASTStmts parser_parse_function_body(Parser *parser) {
+ASTRange parser_parse_function_body(Parser *parser) {
     if (!parser_eat_token(parser, TOK_OPEN_BRACE)) {
-        errorf(buffer_loc_to_source_loc(parser->buffer,
-                                        parser_peek_token(parser).loc),
-               "expected a '{'");
+        errorf(parser_peek_token(parser).start, "expected a '{'");
 
-        exit(1);
+        diagnostics_fail();
     }
 
-    ASTStmts body = {0};
+    size_t scratch_start = parser->scratch.count;
 
     while (parser_peek_token(parser).kind != TOK_EOF &&
            parser_peek_token(parser).kind != TOK_CLOSE_BRACE) {
-        da_append(&body, parser_parse_stmt(parser));
+        ASTIndex stmt = parser_parse_stmt(parser);
+
+        arena_da_append(parser->arena, &parser->scratch, stmt);
     }
 
     if (!parser_eat_token(parser, TOK_CLOSE_BRACE)) {
-        errorf(buffer_loc_to_source_loc(parser->buffer,
-                                        parser_peek_token(parser).loc),
-               "expected a '}'");
+        errorf(parser_peek_token(parser).start, "expected a '}'");
 
-        exit(1);
+        diagnostics_fail();
     }
 
-    return body;
+    return parser_pop_scratch(parser, scratch_start);
 }
 
-ASTDeclaration parser_parse_function_declaration(Parser *parser,
-                                                 Type return_type, Name name) {
-    ASTFunctionParameters parameters = parser_parse_function_parameters(parser);
-
+ASTIndex parser_parse_function_declaration(Parser *parser,
+                                           TypeId return_type, Name name) {
     ASTFunctionPrototype prototype = {
         .return_type = return_type,
         .name = name,
-        .parameters = parameters,
     };
 
-    ASTStmts body = {0};
+    prototype.parameters =
+        parser_parse_function_parameters(parser, &prototype.variadic);
+
+    ASTRange body = {0};
 
     if (!parser_eat_token(parser, TOK_SEMICOLON)) {
         prototype.definition = true;
@@ -617,11 +711,12 @@ ASTDeclaration parser_parse_function_declaration(Parser *parser,
 
     ASTFunction function = {.prototype = prototype, .body = body};
 
-    return (ASTDeclaration){
-        .value = {.function = function}, .kind = DK_FUNCTION, .loc = name.loc};
+    arena_da_append(parser->arena, &parser->root.functions, function);
+
+    return parser->root.functions.count - 1;
 }
 
-ASTDeclaration parser_parse_declaration(Parser *parser) {
+void parser_parse_declaration(Parser *parser) {
     switch (parser_peek_token(parser).kind) {
     case TOK_KEYWORD_VOID:
     case TOK_KEYWORD_CHAR:
@@ -629,40 +724,44 @@ ASTDeclaration parser_parse_declaration(Parser *parser) {
     case TOK_KEYWORD_INT:
     case TOK_KEYWORD_LONG:
     case TOK_KEYWORD_FLOAT:
-    case TOK_KEYWORD_DOUBLE: {
-        Type type = parser_parse_type(parser);
+    case TOK_KEYWORD_DOUBLE:
+    case TOK_KEYWORD_SIGNED:
+    case TOK_KEYWORD_UNSIGNED: {
+        TypeId type = parser_parse_type(parser);
 
         Name name = parser_parse_name(parser);
 
         if (parser_peek_token(parser).kind == TOK_SEMICOLON ||
             parser_peek_token(parser).kind == TOK_ASSIGN) {
-            return parser_parse_variable_declaration(parser, type, name);
+            ast_add_declaration(
+                &parser->root, DK_VARIABLE, name.loc,
+                parser_parse_variable_declaration(parser, type, name));
         } else if (parser_peek_token(parser).kind == TOK_OPEN_PAREN) {
-            return parser_parse_function_declaration(parser, type, name);
+            ast_add_declaration(
+                &parser->root, DK_FUNCTION, name.loc,
+                parser_parse_function_declaration(parser, type, name));
         } else {
-            errorf(buffer_loc_to_source_loc(parser->buffer,
-                                            parser_peek_token(parser).loc),
+            errorf(parser_peek_token(parser).start,
                    "expected a ';' after top level declarator");
 
-            exit(1);
+            diagnostics_fail();
         }
+
+        break;
     }
 
     default:
-        errorf(buffer_loc_to_source_loc(parser->buffer,
-                                        parser_peek_token(parser).loc),
+        errorf(parser_peek_token(parser).start,
                "expected a top level declaration");
 
-        exit(1);
+        diagnostics_fail();
     }
 }
 
 ASTRoot parser_parse_root(Parser *parser) {
-    ASTRoot root = {0};
-
     while (parser_peek_token(parser).kind != TOK_EOF) {
-        da_append(&root.declarations, parser_parse_declaration(parser));
+        parser_parse_declaration(parser);
     }
 
-    return root;
+    return parser->root;
 }
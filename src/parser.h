@@ -1,5 +1,8 @@
 #pragma once
 
+#include <stddef.h>
+
+#include "arena.h"
 #include "ast.h"
 #include "lexer.h"
 #include "token.h"
@@ -15,9 +18,16 @@ typedef enum {
 Precedence precedence_from_token(TokenKind kind);
 
 typedef struct {
+    Arena *arena;
+
     const char *buffer;
-    Lexer lexer;
+
+    Tokens tokens;
+    size_t position;
+
+    ASTRoot root;
+    ASTIndices scratch;
 } Parser;
 
-Parser parser_new( const char *buffer);
+Parser parser_new(Arena *arena, const char *buffer, size_t length);
 ASTRoot parser_parse_root(Parser *parser);
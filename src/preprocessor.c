@@ -0,0 +1,2539 @@
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/utsname.h>
+
+#include "arena.h"
+#include "compile_options.h"
+#include "diagnostics.h"
+#include "dynamic_array.h"
+#include "hash.h"
+#include "input_file.h"
+#include "lexer_scan.h"
+#include "preprocessor.h"
+
+#define PREPROCESSOR_MAX_INCLUDE_DEPTH 200
+
+// Up to this many lines are skipped with newlines, more take a line marker
+#define PREPROCESSOR_MAX_NEWLINES 8
+
+
+typedef enum {
+    PT_EOF,
+    PT_IDENTIFIER,
+    PT_NUMBER,
+    PT_STRING, // Character constants too
+    PT_PUNCTUATOR,
+} PreprocessorTokenKind;
+
+#define PF_LINE_START 1 // First token of a line, where directives start
+#define PF_SPACE 2      // Preceded by whitespace or a comment
+#define PF_EXPANDED 4   // Comes out of a macro, its column means nothing
+
+// Names of the macros a token came out of, which it must not expand again
+typedef struct PreprocessorHideSet {
+    const char *name;
+    uint32_t length;
+    const struct PreprocessorHideSet *next;
+} PreprocessorHideSet;
+
+typedef struct {
+    const char *text;
+    const PreprocessorHideSet *hide_set;
+    uint32_t length;
+    uint32_t line;
+    uint32_t column;
+    uint8_t kind;
+    uint8_t flags;
+} PreprocessorToken;
+
+typedef struct {
+    PreprocessorToken *items;
+    size_t count;
+    size_t capacity;
+} PreprocessorTokens;
+
+typedef enum {
+    PG_UNKNOWN,
+    PG_NONE,
+    PG_GUARDED,
+} PreprocessorGuardState;
+
+// A header as found on disk, shared by the translation units of the process.
+// Lookups by path never touch the file system again, misses included
+typedef struct {
+    const char *path;
+    size_t path_length;
+
+    pthread_mutex_t lock; // Guards everything below
+    bool loaded;
+    bool exists;
+
+    InputFile file;
+    PreprocessorTokens tokens;
+    bool unterminated; // The tokens end at a comment left open
+    PreprocessorToken unterminated_comment;
+
+    // Filled the first time the header is preprocessed: the macro whose
+    // definition makes the whole header empty, and #pragma once
+    PreprocessorGuardState guard_state;
+    const char *guard;
+    uint32_t guard_length;
+    bool pragma_once;
+} PreprocessorHeader;
+
+static struct {
+    pthread_mutex_t lock;
+    Arena arena;
+
+    PreprocessorHeader **slots;
+    size_t slot_count;
+    size_t count;
+} preprocessor_headers = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+typedef enum {
+    PB_NONE,
+    PB_FILE,
+    PB_LINE,
+} PreprocessorBuiltin;
+
+typedef struct {
+    const char *name;
+    uint32_t name_length;
+
+    bool defined; // False once undefined, the slot stays in the table
+    bool function_like;
+    bool variadic; // The last parameter is __VA_ARGS__
+    PreprocessorBuiltin builtin;
+
+    PreprocessorToken *parameters;
+    size_t parameter_count;
+
+    PreprocessorToken *body;
+    size_t body_length;
+} PreprocessorMacro;
+
+// Tokens are read from the expansions pushed back on the stack first, so the
+// result of a macro is rescanned together with what follows it
+typedef struct {
+    const PreprocessorToken *tokens; // Ends with PT_EOF
+    size_t position;
+
+    PreprocessorTokens pending; // The next token is the last one
+} PreprocessorInput;
+
+typedef enum {
+    FG_START,
+    FG_IN_GUARD,
+    FG_AFTER_GUARD,
+    FG_INVALID,
+} PreprocessorFileGuard;
+
+typedef struct {
+    const char *path;
+    PreprocessorHeader *header; // NULL for the main file
+
+    PreprocessorInput input;
+    size_t conditional_base;
+
+    // Tracks whether everything in the file sits in one #ifndef group
+    PreprocessorFileGuard guard_state;
+    size_t guard_conditional;
+    const PreprocessorToken *guard;
+
+    // What #line made of the name and the line numbers of the file, for
+    // __FILE__, __LINE__, diagnostics and the line markers of the output
+    const char *presumed_path;
+    int64_t line_offset;
+} PreprocessorFile;
+
+typedef struct {
+    bool taken; // One of the groups was already included
+    bool in_else;
+    PreprocessorToken token;
+} PreprocessorConditional;
+
+typedef struct {
+    PreprocessorConditional *items;
+    size_t count;
+    size_t capacity;
+} PreprocessorConditionals;
+
+typedef struct {
+    PreprocessorHeader **items;
+    size_t count;
+    size_t capacity;
+} PreprocessorIncluded;
+
+typedef struct {
+    char *items;
+    size_t count;
+    size_t capacity;
+} PreprocessorOutput;
+
+typedef struct {
+    Arena arena;
+    const CompileOptions *options;
+
+    PreprocessorMacro **macros;
+    size_t macro_slot_count;
+    size_t macro_count;
+
+    // /usr/local/include, the multiarch directory of the host and /usr/include
+    struct utsname host;
+    const char *system_directories[3];
+
+    PreprocessorFile *file;
+    size_t include_depth;
+
+    PreprocessorConditionals conditionals;
+    PreprocessorIncluded included;
+
+    PreprocessorOutput output;
+    bool output_enabled;
+    const char *output_path;
+    uint32_t output_line;
+    uint32_t output_column;
+    bool output_expanded;
+} Preprocessor;
+
+static uint32_t preprocessor_presumed_line(const PreprocessorFile *file,
+                                           const PreprocessorToken *token) {
+    return (uint32_t)(token->line + file->line_offset);
+}
+
+static void preprocessor_report(const char *label, const char *path,
+                                uint32_t line, const PreprocessorToken *token,
+                                const char *format, va_list args) {
+    fprintf(stderr, "%s:%" PRIu32 ":%" PRIu32 ": %s: ", path, line,
+            token->column, label);
+    vfprintf(stderr, format, args);
+    fprintf(stderr, "\n");
+}
+
+// Reports the error at the token of the file and gives up on the unit
+_Noreturn static void preprocessor_error(const PreprocessorFile *file,
+                                         const PreprocessorToken *token,
+                                         const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    preprocessor_report("error", file->presumed_path,
+                        preprocessor_presumed_line(file, token), token, format,
+                        args);
+    va_end(args);
+
+    diagnostics_fail();
+}
+
+static void preprocessor_warning(const PreprocessorFile *file,
+                                 const PreprocessorToken *token,
+                                 const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    preprocessor_report("warning", file->presumed_path,
+                        preprocessor_presumed_line(file, token), token, format,
+                        args);
+    va_end(args);
+}
+
+// Files are only tokenized before any #line in them
+_Noreturn static void
+preprocessor_unterminated_comment(const char *path,
+                                  const PreprocessorToken *comment) {
+    PreprocessorFile file = {.path = path, .presumed_path = path};
+
+    preprocessor_error(&file, comment, "unterminated comment");
+}
+
+static bool preprocessor_is_identifier(char ch) {
+    return lexer_char_classes[(unsigned char)ch] & CC_IDENTIFIER;
+}
+
+static bool preprocessor_is_digit(char ch) { return ch >= '0' && ch <= '9'; }
+
+// Longest first, anything else is a punctuator of one character
+static const char *preprocessor_punctuators[] = {
+    "...", "<<=", ">>=", "##", "<<", ">>", "<=", ">=", "==", "!=", "&&",
+    "||",  "->",  "++",  "--", "+=", "-=", "*=", "/=", "%=", "&=", "|=",
+    "^=",
+};
+
+static size_t preprocessor_punctuator_length(const char *p, const char *end) {
+    size_t count =
+        sizeof(preprocessor_punctuators) / sizeof(preprocessor_punctuators[0]);
+
+    for (size_t i = 0; i < count; i++) {
+        size_t length = strlen(preprocessor_punctuators[i]);
+
+        if ((size_t)(end - p) >= length &&
+            memcmp(p, preprocessor_punctuators[i], length) == 0) {
+            return length;
+        }
+    }
+
+    return 1;
+}
+
+// Comments become whitespace and backslash-newlines join lines, the tokens
+// end with PT_EOF. Returns false with the location of a comment left open,
+// which is reported by the caller since headers are tokenized under a lock
+static bool preprocessor_try_tokenize(const char *content, size_t length,
+                                      PreprocessorTokens *tokens,
+                                      PreprocessorToken *unterminated) {
+    const char *p = content;
+    const char *end = content + length;
+    const char *line_start = content;
+    uint32_t line = 1;
+    uint8_t flags = PF_LINE_START;
+
+    while (true) {
+        while (p < end) {
+            if (*p == '\n') {
+                p++;
+                line++;
+                line_start = p;
+                flags = PF_LINE_START;
+            } else if (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\v' ||
+                       *p == '\f') {
+                p++;
+                flags |= PF_SPACE;
+            } else if (*p == '\\' && p + 1 < end && p[1] == '\n') {
+                p += 2;
+                line++;
+                line_start = p;
+                flags |= PF_SPACE;
+            } else if (*p == '/' && p + 1 < end && p[1] == '/') {
+                while (p < end && *p != '\n') {
+                    p++;
+                }
+
+                flags |= PF_SPACE;
+            } else if (*p == '/' && p + 1 < end && p[1] == '*') {
+                PreprocessorToken comment = {
+                    .line = line, .column = p - line_start + 1};
+
+                p += 2;
+
+                while (p + 1 < end && !(p[0] == '*' && p[1] == '/')) {
+                    if (*p == '\n') {
+                        line++;
+                        line_start = p + 1;
+                    }
+
+                    p++;
+                }
+
+                if (p + 1 >= end) {
+                    *unterminated = comment;
+                    return false;
+                }
+
+                p += 2;
+                flags |= PF_SPACE;
+            } else {
+                break;
+            }
+        }
+
+        PreprocessorToken token = {
+            .text = p,
+            .line = line,
+            .column = p - line_start + 1,
+            .flags = flags,
+        };
+
+        if (p == end) {
+            token.kind = PT_EOF;
+            da_append(tokens, token);
+            return true;
+        }
+
+        if (preprocessor_is_identifier(*p) && !preprocessor_is_digit(*p)) {
+            while (p < end && preprocessor_is_identifier(*p)) {
+                p++;
+            }
+
+            token.kind = PT_IDENTIFIER;
+        } else if (preprocessor_is_digit(*p) ||
+                   (*p == '.' && p + 1 < end && preprocessor_is_digit(p[1]))) {
+            p++;
+
+            while (p < end) {
+                if ((*p == '+' || *p == '-') &&
+                    (p[-1] == 'e' || p[-1] == 'E' || p[-1] == 'p' ||
+                     p[-1] == 'P')) {
+                    p++;
+                } else if (preprocessor_is_identifier(*p) || *p == '.') {
+                    p++;
+                } else {
+                    break;
+                }
+            }
+
+            token.kind = PT_NUMBER;
+        } else if (*p == '"' || *p == '\'') {
+            char quote = *p++;
+
+            while (p < end && *p != quote && *p != '\n') {
+                if (*p == '\\' && p + 1 < end) {
+                    p++;
+                }
+
+                p++;
+            }
+
+            if (p < end && *p == quote) {
+                p++;
+            }
+
+            token.kind = PT_STRING;
+        } else {
+            p += preprocessor_punctuator_length(p, end);
+
+            token.kind = PT_PUNCTUATOR;
+        }
+
+        token.length = p - token.text;
+        da_append(tokens, token);
+
+        flags = 0;
+    }
+}
+
+static void preprocessor_tokenize(const char *path, const char *content,
+                                  size_t length, PreprocessorTokens *tokens) {
+    PreprocessorToken comment;
+
+    if (!preprocessor_try_tokenize(content, length, tokens, &comment)) {
+        preprocessor_unterminated_comment(path, &comment);
+    }
+}
+
+static bool preprocessor_is(const PreprocessorToken *token, const char *text) {
+    size_t length = strlen(text);
+
+    return token->kind != PT_EOF && token->length == length &&
+           memcmp(token->text, text, length) == 0;
+}
+
+static bool preprocessor_same_name(const PreprocessorToken *token,
+                                   const char *name, uint32_t length) {
+    return token->length == length && memcmp(token->text, name, length) == 0;
+}
+
+static bool preprocessor_hide_set_contains(const PreprocessorHideSet *set,
+                                           const char *name, uint32_t length) {
+    for (; set != NULL; set = set->next) {
+        if (set->length == length && memcmp(set->name, name, length) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static const PreprocessorHideSet *
+preprocessor_hide_set_add(Arena *arena, const PreprocessorHideSet *set,
+                          const char *name, uint32_t length) {
+    PreprocessorHideSet *added = arena_alloc(arena, sizeof(*added));
+
+    *added = (PreprocessorHideSet){.name = name, .length = length, .next = set};
+
+    return added;
+}
+
+static const PreprocessorHideSet *
+preprocessor_hide_set_union(Arena *arena, const PreprocessorHideSet *a,
+                            const PreprocessorHideSet *b) {
+    const PreprocessorHideSet *result = b;
+
+    for (; a != NULL; a = a->next) {
+        if (!preprocessor_hide_set_contains(b, a->name, a->length)) {
+            result = preprocessor_hide_set_add(arena, result, a->name,
+                                               a->length);
+        }
+    }
+
+    return result;
+}
+
+static const PreprocessorHideSet *
+preprocessor_hide_set_intersection(Arena *arena, const PreprocessorHideSet *a,
+                                   const PreprocessorHideSet *b) {
+    const PreprocessorHideSet *result = NULL;
+
+    for (; a != NULL; a = a->next) {
+        if (preprocessor_hide_set_contains(b, a->name, a->length)) {
+            result = preprocessor_hide_set_add(arena, result, a->name,
+                                               a->length);
+        }
+    }
+
+    return result;
+}
+
+// The header cache is an open addressing table keyed by path
+static PreprocessorHeader *preprocessor_find_header(const char *path,
+                                                    size_t length) {
+    uint64_t hash = hash_bytes(path, length, 0);
+
+    pthread_mutex_lock(&preprocessor_headers.lock);
+
+    if (preprocessor_headers.slots == NULL) {
+        preprocessor_headers.arena = arena_new(false);
+        preprocessor_headers.slot_count = 64;
+        preprocessor_headers.slots = calloc(preprocessor_headers.slot_count,
+                                            sizeof(PreprocessorHeader *));
+
+        if (preprocessor_headers.slots == NULL) {
+            printf("out of memory\n");
+            exit(1);
+        }
+    }
+
+    size_t mask = preprocessor_headers.slot_count - 1;
+    size_t slot = hash & mask;
+
+    for (; preprocessor_headers.slots[slot] != NULL; slot = (slot + 1) & mask) {
+        PreprocessorHeader *header = preprocessor_headers.slots[slot];
+
+        if (header->path_length == length &&
+            memcmp(header->path, path, length) == 0) {
+            pthread_mutex_unlock(&preprocessor_headers.lock);
+
+            return header;
+        }
+    }
+
+    PreprocessorHeader *header =
+        arena_alloc(&preprocessor_headers.arena, sizeof(PreprocessorHeader));
+
+    *header = (PreprocessorHeader){
+        .path = arena_strndup(&preprocessor_headers.arena, path, length),
+        .path_length = length,
+    };
+
+    pthread_mutex_init(&header->lock, NULL);
+
+    preprocessor_headers.slots[slot] = header;
+    preprocessor_headers.count++;
+
+    if (preprocessor_headers.count * 2 > preprocessor_headers.slot_count) {
+        size_t slot_count = preprocessor_headers.slot_count * 2;
+        PreprocessorHeader **slots =
+            calloc(slot_count, sizeof(PreprocessorHeader *));
+
+        if (slots == NULL) {
+            printf("out of memory\n");
+            exit(1);
+        }
+
+        for (size_t i = 0; i < preprocessor_headers.slot_count; i++) {
+            PreprocessorHeader *moved = preprocessor_headers.slots[i];
+
+            if (moved == NULL) {
+                continue;
+            }
+
+            size_t moved_slot =
+                hash_bytes(moved->path, moved->path_length, 0) &
+                (slot_count - 1);
+
+            while (slots[moved_slot] != NULL) {
+                moved_slot = (moved_slot + 1) & (slot_count - 1);
+            }
+
+            slots[moved_slot] = moved;
+        }
+
+        free(preprocessor_headers.slots);
+
+        preprocessor_headers.slots = slots;
+        preprocessor_headers.slot_count = slot_count;
+    }
+
+    pthread_mutex_unlock(&preprocessor_headers.lock);
+
+    return header;
+}
+
+// Returns false when there is no such file
+static bool preprocessor_load_header(PreprocessorHeader *header) {
+    pthread_mutex_lock(&header->lock);
+
+    if (!header->loaded) {
+        header->exists = input_file_try_read(header->path, &header->file);
+
+        if (header->exists) {
+            header->unterminated = !preprocessor_try_tokenize(
+                header->file.file_content, header->file.file_length,
+                &header->tokens, &header->unterminated_comment);
+        }
+
+        header->loaded = true;
+    }
+
+    bool exists = header->exists;
+
+    pthread_mutex_unlock(&header->lock);
+
+    if (exists && header->unterminated) {
+        preprocessor_unterminated_comment(header->path,
+                                          &header->unterminated_comment);
+    }
+
+    return exists;
+}
+
+static PreprocessorMacro *preprocessor_lookup_slot(Preprocessor *pp,
+                                                   const char *name,
+                                                   uint32_t length,
+                                                   size_t *slot) {
+    size_t mask = pp->macro_slot_count - 1;
+
+    *slot = hash_bytes(name, length, 0) & mask;
+
+    for (; pp->macros[*slot] != NULL; *slot = (*slot + 1) & mask) {
+        PreprocessorMacro *macro = pp->macros[*slot];
+
+        if (macro->name_length == length &&
+            memcmp(macro->name, name, length) == 0) {
+            return macro;
+        }
+    }
+
+    return NULL;
+}
+
+static PreprocessorMacro *preprocessor_find_macro(Preprocessor *pp,
+                                                  const char *name,
+                                                  uint32_t length) {
+    size_t slot;
+    PreprocessorMacro *macro =
+        preprocessor_lookup_slot(pp, name, length, &slot);
+
+    return macro != NULL && macro->defined ? macro : NULL;
+}
+
+// Returns the slot of the name, which is reused when it was defined before
+static PreprocessorMacro *preprocessor_add_macro(Preprocessor *pp,
+                                                 const char *name,
+                                                 uint32_t length) {
+    size_t slot;
+    PreprocessorMacro *macro =
+        preprocessor_lookup_slot(pp, name, length, &slot);
+
+    if (macro == NULL) {
+        macro = arena_alloc(&pp->arena, sizeof(PreprocessorMacro));
+        pp->macros[slot] = macro;
+        pp->macro_count++;
+    }
+
+    *macro = (PreprocessorMacro){
+        .name = arena_strndup(&pp->arena, name, length),
+        .name_length = length,
+        .defined = true,
+    };
+
+    if (pp->macro_count * 2 > pp->macro_slot_count) {
+        PreprocessorMacro **old_macros = pp->macros;
+        size_t old_slot_count = pp->macro_slot_count;
+
+        pp->macro_slot_count *= 2;
+        pp->macros = calloc(pp->macro_slot_count, sizeof(PreprocessorMacro *));
+
+        if (pp->macros == NULL) {
+            printf("out of memory\n");
+            exit(1);
+        }
+
+        for (size_t i = 0; i < old_slot_count; i++) {
+            if (old_macros[i] != NULL) {
+                size_t moved_slot;
+                preprocessor_lookup_slot(pp, old_macros[i]->name,
+                                         old_macros[i]->name_length,
+                                         &moved_slot);
+                pp->macros[moved_slot] = old_macros[i];
+            }
+        }
+
+        free(old_macros);
+    }
+
+    return macro;
+}
+
+static PreprocessorToken preprocessor_next(PreprocessorInput *input) {
+    if (input->pending.count != 0) {
+        return input->pending.items[--input->pending.count];
+    }
+
+    PreprocessorToken token = input->tokens[input->position];
+
+    if (token.kind != PT_EOF) {
+        input->position++;
+    }
+
+    return token;
+}
+
+static const PreprocessorToken *preprocessor_peek(PreprocessorInput *input) {
+    if (input->pending.count != 0) {
+        return &input->pending.items[input->pending.count - 1];
+    }
+
+    return &input->tokens[input->position];
+}
+
+static void preprocessor_push(PreprocessorInput *input,
+                              const PreprocessorTokens *tokens) {
+    for (size_t i = tokens->count; i > 0; i--) {
+        da_append(&input->pending, tokens->items[i - 1]);
+    }
+}
+
+static bool preprocessor_expand(Preprocessor *pp, PreprocessorInput *input,
+                                const PreprocessorToken *token);
+
+static PreprocessorTokens
+preprocessor_expand_all(Preprocessor *pp, const PreprocessorToken *tokens,
+                        size_t count) {
+    PreprocessorTokens source = {0};
+
+    for (size_t i = 0; i < count; i++) {
+        da_append(&source, tokens[i]);
+    }
+
+    da_append(&source, ((PreprocessorToken){.kind = PT_EOF}));
+
+    PreprocessorInput input = {.tokens = source.items};
+    PreprocessorTokens result = {0};
+
+    while (true) {
+        PreprocessorToken token = preprocessor_next(&input);
+
+        if (token.kind == PT_EOF) {
+            break;
+        }
+
+        if (!preprocessor_expand(pp, &input, &token)) {
+            arena_da_append(&pp->arena, &result, token);
+        }
+    }
+
+    da_free(input.pending);
+    da_free(source);
+
+    return result;
+}
+
+static int preprocessor_parameter(const PreprocessorMacro *macro,
+                                  const PreprocessorToken *token) {
+    if (token->kind != PT_IDENTIFIER) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < macro->parameter_count; i++) {
+        if (preprocessor_same_name(token, macro->parameters[i].text,
+                                   macro->parameters[i].length)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static PreprocessorToken preprocessor_stringize(Preprocessor *pp,
+                                                const PreprocessorTokens *arg,
+                                                const PreprocessorToken *hash) {
+    PreprocessorOutput text = {0};
+
+    da_append(&text, '"');
+
+    for (size_t i = 0; i < arg->count; i++) {
+        const PreprocessorToken *token = &arg->items[i];
+
+        if (i != 0 && (token->flags & PF_SPACE)) {
+            da_append(&text, ' ');
+        }
+
+        for (uint32_t j = 0; j < token->length; j++) {
+            char ch = token->text[j];
+
+            if (token->kind == PT_STRING && (ch == '"' || ch == '\\')) {
+                da_append(&text, '\\');
+            }
+
+            da_append(&text, ch);
+        }
+    }
+
+    da_append(&text, '"');
+
+    PreprocessorToken token = *hash;
+
+    token.text = arena_memdup(&pp->arena, text.items, text.count);
+    token.length = text.count;
+    token.kind = PT_STRING;
+
+    da_free(text);
+
+    return token;
+}
+
+static PreprocessorToken preprocessor_paste(Preprocessor *pp,
+                                            const PreprocessorToken *left,
+                                            const PreprocessorToken *right) {
+    size_t length = left->length + right->length;
+    char *text = arena_alloc(&pp->arena, length + 1);
+
+    memcpy(text, left->text, left->length);
+    memcpy(text + left->length, right->text, right->length);
+    text[length] = '\0';
+
+    PreprocessorTokens tokens = {0};
+    preprocessor_tokenize(pp->file->path, text, length, &tokens);
+
+    if (tokens.count != 2 || (tokens.items[0].flags & PF_SPACE)) {
+        preprocessor_error(pp->file, left,
+                           "pasting \"%.*s\" and \"%.*s\" does not give a "
+                           "valid preprocessing token",
+                           (int)left->length, left->text, (int)right->length,
+                           right->text);
+    }
+
+    PreprocessorToken token = *left;
+
+    token.text = text;
+    token.length = length;
+    token.kind = tokens.items[0].kind;
+
+    da_free(tokens);
+
+    return token;
+}
+
+// Replaces the parameters in the body, operands of # and ## are taken as
+// written and every other argument fully expanded first
+static PreprocessorTokens
+preprocessor_substitute(Preprocessor *pp, const PreprocessorMacro *macro,
+                        PreprocessorTokens *args) {
+    PreprocessorTokens result = {0};
+    const PreprocessorToken *body = macro->body;
+    bool left_empty = false;
+
+    for (size_t i = 0; i < macro->body_length; i++) {
+        const PreprocessorToken *token = &body[i];
+        int parameter;
+
+        if (macro->function_like && preprocessor_is(token, "#")) {
+            parameter = preprocessor_parameter(macro, &body[i + 1]);
+
+            arena_da_append(&pp->arena, &result,
+                            preprocessor_stringize(pp, &args[parameter],
+                                                   token));
+            i++;
+            left_empty = false;
+            continue;
+        }
+
+        if (preprocessor_is(token, "##")) {
+            const PreprocessorToken *right = &body[++i];
+            parameter = preprocessor_parameter(macro, right);
+
+            const PreprocessorToken *right_tokens = right;
+            size_t right_count = 1;
+
+            if (parameter >= 0) {
+                right_tokens = args[parameter].items;
+                right_count = args[parameter].count;
+            }
+
+            // GNU extension: the comma before an empty __VA_ARGS__ goes away
+            bool variadic_comma =
+                macro->variadic &&
+                parameter == (int)macro->parameter_count - 1 &&
+                !left_empty && result.count != 0 &&
+                preprocessor_is(&result.items[result.count - 1], ",");
+
+            if (variadic_comma && right_count == 0) {
+                result.count--;
+            } else if (right_count != 0) {
+                size_t first = 0;
+
+                if (!left_empty && result.count != 0 && !variadic_comma) {
+                    result.items[result.count - 1] = preprocessor_paste(
+                        pp, &result.items[result.count - 1], &right_tokens[0]);
+                    first = 1;
+                }
+
+                for (size_t j = first; j < right_count; j++) {
+                    arena_da_append(&pp->arena, &result, right_tokens[j]);
+                }
+            }
+
+            left_empty = left_empty && right_count == 0;
+            continue;
+        }
+
+        parameter = preprocessor_parameter(macro, token);
+
+        if (parameter < 0 || !macro->function_like) {
+            arena_da_append(&pp->arena, &result, *token);
+            left_empty = false;
+            continue;
+        }
+
+        bool pasted =
+            i + 1 < macro->body_length && preprocessor_is(&body[i + 1], "##");
+
+        PreprocessorTokens arg =
+            pasted ? args[parameter]
+                   : preprocessor_expand_all(pp, args[parameter].items,
+                                             args[parameter].count);
+
+        for (size_t j = 0; j < arg.count; j++) {
+            PreprocessorToken argument_token = arg.items[j];
+
+            if (j == 0) {
+                argument_token.flags = (argument_token.flags & ~PF_SPACE) |
+                                       (token->flags & PF_SPACE);
+            }
+
+            arena_da_append(&pp->arena, &result, argument_token);
+        }
+
+        left_empty = arg.count == 0;
+    }
+
+    return result;
+}
+
+// Arguments are split on the commas outside of parentheses, the closing
+// parenthesis is returned through rparen
+static PreprocessorTokens *preprocessor_collect_arguments(
+    Preprocessor *pp, PreprocessorInput *input, const PreprocessorMacro *macro,
+    const PreprocessorToken *name, PreprocessorToken *rparen) {
+    size_t slot_count = macro->parameter_count > 0 ? macro->parameter_count : 1;
+
+    PreprocessorTokens *args =
+        arena_alloc(&pp->arena, slot_count * sizeof(PreprocessorTokens));
+
+    memset(args, 0, slot_count * sizeof(PreprocessorTokens));
+
+    size_t index = 0;
+    size_t depth = 0;
+    preprocessor_next(input); // The '('
+
+    while (true) {
+        PreprocessorToken token = preprocessor_next(input);
+
+        if (token.kind == PT_EOF) {
+            preprocessor_error(pp->file, name,
+                               "unterminated argument list invoking macro "
+                               "'%.*s'",
+                               (int)name->length, name->text);
+        }
+
+        if (preprocessor_is(&token, "(")) {
+            depth++;
+        } else if (preprocessor_is(&token, ")")) {
+            if (depth == 0) {
+                *rparen = token;
+                break;
+            }
+
+            depth--;
+        } else if (preprocessor_is(&token, ",") && depth == 0 &&
+                   !(macro->variadic &&
+                     index + 1 == macro->parameter_count)) {
+            index++;
+
+            if (index >= slot_count) {
+                preprocessor_error(pp->file, name,
+                                   "too many arguments to macro '%.*s'",
+                                   (int)name->length, name->text);
+            }
+
+            continue;
+        }
+
+        arena_da_append(&pp->arena, &args[index], token);
+    }
+
+    size_t given = index + 1;
+
+    if (macro->parameter_count == 0 && (index != 0 || args[0].count != 0)) {
+        preprocessor_error(pp->file, name,
+                           "too many arguments to macro '%.*s'",
+                           (int)name->length, name->text);
+    }
+
+    if (macro->parameter_count != 0 && given < macro->parameter_count &&
+        !(macro->variadic && given + 1 == macro->parameter_count)) {
+        preprocessor_error(pp->file, name,
+                           "too few arguments to macro '%.*s'",
+                           (int)name->length, name->text);
+    }
+
+    return args;
+}
+
+static PreprocessorTokens preprocessor_builtin(Preprocessor *pp,
+                                               const PreprocessorMacro *macro,
+                                               const PreprocessorToken *name) {
+    char text[32];
+    PreprocessorToken token = *name;
+    PreprocessorTokens result = {0};
+
+    if (macro->builtin == PB_LINE) {
+        snprintf(text, sizeof(text), "%" PRIu32,
+                 preprocessor_presumed_line(pp->file, name));
+
+        token.kind = PT_NUMBER;
+        token.text = arena_strndup(&pp->arena, text, strlen(text));
+        token.length = strlen(text);
+    } else {
+        size_t length = strlen(pp->file->presumed_path);
+        char *quoted = arena_alloc(&pp->arena, length + 2);
+
+        quoted[0] = '"';
+        memcpy(quoted + 1, pp->file->presumed_path, length);
+        quoted[length + 1] = '"';
+
+        token.kind = PT_STRING;
+        token.text = quoted;
+        token.length = length + 2;
+    }
+
+    arena_da_append(&pp->arena, &result, token);
+
+    return result;
+}
+
+// Pushes the expansion of the token back on the input when it names a macro
+// that applies here, hide sets as in Prosser's algorithm keep a macro from
+// expanding within its own expansion
+static bool preprocessor_expand(Preprocessor *pp, PreprocessorInput *input,
+                                const PreprocessorToken *token) {
+    if (token->kind != PT_IDENTIFIER ||
+        preprocessor_hide_set_contains(token->hide_set, token->text,
+                                       token->length)) {
+        return false;
+    }
+
+    PreprocessorMacro *macro =
+        preprocessor_find_macro(pp, token->text, token->length);
+
+    if (macro == NULL) {
+        return false;
+    }
+
+    const PreprocessorHideSet *hide_set;
+    PreprocessorTokens expansion;
+
+    if (macro->builtin != PB_NONE) {
+        hide_set = token->hide_set;
+        expansion = preprocessor_builtin(pp, macro, token);
+    } else if (!macro->function_like) {
+        hide_set = preprocessor_hide_set_add(&pp->arena, token->hide_set,
+                                             macro->name, macro->name_length);
+        expansion = preprocessor_substitute(pp, macro, NULL);
+    } else {
+        // A function-like macro name without arguments is just a name
+        if (!preprocessor_is(preprocessor_peek(input), "(")) {
+            return false;
+        }
+
+        PreprocessorToken rparen;
+        PreprocessorTokens *args =
+            preprocessor_collect_arguments(pp, input, macro, token, &rparen);
+
+        hide_set = preprocessor_hide_set_add(
+            &pp->arena,
+            preprocessor_hide_set_intersection(&pp->arena, token->hide_set,
+                                               rparen.hide_set),
+            macro->name, macro->name_length);
+        expansion = preprocessor_substitute(pp, macro, args);
+    }
+
+    for (size_t i = 0; i < expansion.count; i++) {
+        PreprocessorToken *expanded = &expansion.items[i];
+
+        expanded->hide_set =
+            expanded->hide_set == NULL
+                ? hide_set
+                : preprocessor_hide_set_union(&pp->arena, hide_set,
+                                              expanded->hide_set);
+        expanded->line = token->line;
+        expanded->column = token->column;
+        expanded->flags = (expanded->flags & ~PF_LINE_START) | PF_EXPANDED;
+    }
+
+    if (expansion.count != 0) {
+        expansion.items[0].flags = (expansion.items[0].flags & ~PF_SPACE) |
+                                   (token->flags & PF_SPACE);
+    }
+
+    preprocessor_push(input, &expansion);
+
+    return true;
+}
+
+static void preprocessor_write(Preprocessor *pp, const char *text,
+                               size_t length) {
+    if (pp->output.count + length > pp->output.capacity) {
+        while (pp->output.count + length > pp->output.capacity) {
+            pp->output.capacity =
+                pp->output.capacity == 0 ? 4096 : pp->output.capacity * 2;
+        }
+
+        pp->output.items = realloc(pp->output.items, pp->output.capacity);
+
+        if (pp->output.items == NULL) {
+            printf("out of memory\n");
+            exit(1);
+        }
+    }
+
+    memcpy(pp->output.items + pp->output.count, text, length);
+    pp->output.count += length;
+}
+
+static void preprocessor_write_spaces(Preprocessor *pp, size_t count) {
+    static const char spaces[] = "                                ";
+
+    while (count > 0) {
+        size_t chunk = count < sizeof(spaces) - 1 ? count : sizeof(spaces) - 1;
+
+        preprocessor_write(pp, spaces, chunk);
+        count -= chunk;
+    }
+}
+
+// Tokens keep their line, and their column when they were not expanded, so
+// diagnostics of the lexer and the parser point into the original files
+static void preprocessor_emit(Preprocessor *pp,
+                              const PreprocessorToken *token) {
+    if (!pp->output_enabled) {
+        return;
+    }
+
+    const char *path = pp->file->presumed_path;
+    uint32_t line = preprocessor_presumed_line(pp->file, token);
+
+    if (path != pp->output_path || line < pp->output_line ||
+        line > pp->output_line + PREPROCESSOR_MAX_NEWLINES) {
+        if (pp->output_column != 0) {
+            preprocessor_write(pp, "\n", 1);
+        }
+
+        char marker[32];
+        int marker_length =
+            snprintf(marker, sizeof(marker), "# %" PRIu32 " \"", line);
+
+        preprocessor_write(pp, marker, marker_length);
+        preprocessor_write(pp, path, strlen(path));
+        preprocessor_write(pp, "\"\n", 2);
+
+        pp->output_path = path;
+        pp->output_line = line;
+        pp->output_column = 0;
+    }
+
+    while (pp->output_line < line) {
+        preprocessor_write(pp, "\n", 1);
+
+        pp->output_line++;
+        pp->output_column = 0;
+    }
+
+    uint32_t column = pp->output_column;
+    bool expanded = (token->flags & PF_EXPANDED) || pp->output_expanded;
+
+    if (!expanded && token->column > column + 1) {
+        preprocessor_write_spaces(pp, token->column - 1 - column);
+        column = token->column - 1;
+    } else if (column != 0 && (expanded || (token->flags & PF_SPACE))) {
+        preprocessor_write(pp, " ", 1);
+        column++;
+    }
+
+    preprocessor_write(pp, token->text, token->length);
+
+    pp->output_column = column + token->length;
+    pp->output_expanded = token->flags & PF_EXPANDED;
+}
+
+// The tokens of a directive run up to the first token of the next line
+static size_t preprocessor_line_length(const PreprocessorFile *file) {
+    const PreprocessorToken *tokens = file->input.tokens;
+    size_t end = file->input.position;
+
+    while (tokens[end].kind != PT_EOF &&
+           !(tokens[end].flags & PF_LINE_START)) {
+        end++;
+    }
+
+    return end - file->input.position;
+}
+
+static void preprocessor_define(Preprocessor *pp,
+                                const PreprocessorToken *line, size_t count,
+                                const PreprocessorToken *directive) {
+    if (count == 0 || line[0].kind != PT_IDENTIFIER) {
+        preprocessor_error(pp->file, count == 0 ? directive : &line[0],
+                           "macro names must be identifiers");
+    }
+
+    if (preprocessor_is(&line[0], "defined")) {
+        preprocessor_error(pp->file, &line[0],
+                           "'defined' cannot be used as a macro name");
+    }
+
+    PreprocessorMacro *macro =
+        preprocessor_add_macro(pp, line[0].text, line[0].length);
+
+    size_t body_start = 1;
+
+    if (count > 1 && preprocessor_is(&line[1], "(") &&
+        !(line[1].flags & PF_SPACE)) {
+        macro->function_like = true;
+
+        PreprocessorTokens parameters = {0};
+        size_t i = 2;
+
+        while (true) {
+            if (i == count) {
+                preprocessor_error(pp->file, &line[i - 1],
+                                   "missing ')' in macro parameter list");
+            }
+
+            if (preprocessor_is(&line[i], ")") && parameters.count == 0) {
+                i++;
+                break;
+            }
+
+            if (preprocessor_is(&line[i], "...")) {
+                PreprocessorToken va_args = line[i];
+
+                va_args.text = "__VA_ARGS__";
+                va_args.length = sizeof("__VA_ARGS__") - 1;
+
+                arena_da_append(&pp->arena, &parameters, va_args);
+                macro->variadic = true;
+                i++;
+            } else if (line[i].kind == PT_IDENTIFIER) {
+                arena_da_append(&pp->arena, &parameters, line[i]);
+                i++;
+            } else {
+                preprocessor_error(pp->file, &line[i],
+                                   "expected a macro parameter name");
+            }
+
+            if (i < count && preprocessor_is(&line[i], ")")) {
+                i++;
+                break;
+            }
+
+            if (i == count || !preprocessor_is(&line[i], ",") ||
+                macro->variadic) {
+                preprocessor_error(pp->file,
+                                   &line[i == count ? i - 1 : i],
+                                   "expected ',' or ')' in macro parameter "
+                                   "list");
+            }
+
+            i++;
+        }
+
+        macro->parameters = parameters.items;
+        macro->parameter_count = parameters.count;
+        body_start = i;
+    }
+
+    macro->body_length = count - body_start;
+    macro->body =
+        arena_memdup(&pp->arena, &line[body_start],
+                     macro->body_length * sizeof(PreprocessorToken));
+
+    if (macro->body_length != 0) {
+        macro->body[0].flags &= ~PF_SPACE;
+    }
+
+    for (size_t i = 0; i < macro->body_length; i++) {
+        const PreprocessorToken *token = &macro->body[i];
+
+        if (preprocessor_is(token, "##") &&
+            (i == 0 || i + 1 == macro->body_length)) {
+            preprocessor_error(pp->file, token,
+                               "'##' cannot appear at either end of a macro "
+                               "expansion");
+        }
+
+        if (macro->function_like && preprocessor_is(token, "#") &&
+            (i + 1 == macro->body_length ||
+             preprocessor_parameter(macro, &macro->body[i + 1]) < 0)) {
+            preprocessor_error(pp->file, token,
+                               "'#' is not followed by a macro parameter");
+        }
+    }
+}
+
+typedef struct {
+    Preprocessor *pp;
+    const PreprocessorToken *directive;
+    PreprocessorToken *tokens;
+    size_t count;
+    size_t position;
+    size_t unevaluated; // Inside the operand that && || ?: do not evaluate
+} PreprocessorExpression;
+
+// #if values are kept in uintmax_t with C's signedness, signed arithmetic
+// wraps there instead of overflowing and the sign is read back only where
+// it matters
+typedef struct {
+    uintmax_t value;
+    bool is_unsigned;
+} PreprocessorValue;
+
+static PreprocessorValue preprocessor_signed(intmax_t value) {
+    return (PreprocessorValue){.value = (uintmax_t)value};
+}
+
+static intmax_t preprocessor_as_signed(uintmax_t value) {
+    return value <= INTMAX_MAX ? (intmax_t)value
+                               : -(intmax_t)(UINTMAX_MAX - value) - 1;
+}
+
+static bool preprocessor_is_negative(PreprocessorValue value) {
+    return !value.is_unsigned && value.value > INTMAX_MAX;
+}
+
+static PreprocessorValue
+preprocessor_parse_conditional(PreprocessorExpression *e);
+
+static const PreprocessorToken *
+preprocessor_expression_peek(PreprocessorExpression *e) {
+    static const PreprocessorToken eof = {.kind = PT_EOF};
+
+    return e->position < e->count ? &e->tokens[e->position] : &eof;
+}
+
+static const PreprocessorToken *
+preprocessor_expression_location(PreprocessorExpression *e) {
+    return e->position < e->count ? &e->tokens[e->position] : e->directive;
+}
+
+// Constants too large for intmax_t are unsigned, as C makes hexadecimal and
+// octal ones
+static PreprocessorValue
+preprocessor_parse_number(PreprocessorExpression *e,
+                          const PreprocessorToken *token) {
+    char text[64];
+    uint32_t length = token->length;
+    int unsigned_suffixes = 0;
+    int long_suffixes = 0;
+
+    while (length > 0 &&
+           strchr("uUlL", token->text[length - 1]) != NULL) {
+        char suffix = token->text[length - 1];
+
+        unsigned_suffixes += suffix == 'u' || suffix == 'U';
+        long_suffixes += suffix == 'l' || suffix == 'L';
+        length--;
+    }
+
+    if (length == 0 || length >= sizeof(text) || unsigned_suffixes > 1 ||
+        long_suffixes > 2) {
+        preprocessor_error(e->pp->file, token,
+                           "invalid integer constant in #if");
+    }
+
+    memcpy(text, token->text, length);
+    text[length] = '\0';
+
+    char *end;
+    errno = 0;
+    uintmax_t value = strtoumax(text, &end, 0);
+
+    if (*end != '\0' || errno != 0) {
+        preprocessor_error(e->pp->file, token,
+                           "invalid integer constant in #if");
+    }
+
+    return (PreprocessorValue){
+        .value = value,
+        .is_unsigned = unsigned_suffixes > 0 || value > INTMAX_MAX,
+    };
+}
+
+static int preprocessor_hex_digit(char ch) {
+    if (ch >= '0' && ch <= '9') {
+        return ch - '0';
+    }
+
+    if (ch >= 'a' && ch <= 'f') {
+        return ch - 'a' + 10;
+    }
+
+    if (ch >= 'A' && ch <= 'F') {
+        return ch - 'A' + 10;
+    }
+
+    return -1;
+}
+
+// Decodes the escape sequence after the backslash at text[*position] and
+// moves past it, returns -1 for an unknown or out of range sequence
+static int preprocessor_escape(const char *text, uint32_t length,
+                               uint32_t *position) {
+    uint32_t i = *position + 1;
+
+    if (i >= length) {
+        return -1;
+    }
+
+    char ch = text[i++];
+    int value = -1;
+
+    switch (ch) {
+    case 'a':
+        value = '\a';
+        break;
+
+    case 'b':
+        value = '\b';
+        break;
+
+    case 'f':
+        value = '\f';
+        break;
+
+    case 'n':
+        value = '\n';
+        break;
+
+    case 'r':
+        value = '\r';
+        break;
+
+    case 't':
+        value = '\t';
+        break;
+
+    case 'v':
+        value = '\v';
+        break;
+
+    case '\\':
+    case '\'':
+    case '"':
+    case '?':
+        value = ch;
+        break;
+
+    case 'x':
+        value = 0;
+
+        if (i >= length || preprocessor_hex_digit(text[i]) < 0) {
+            return -1;
+        }
+
+        while (i < length && preprocessor_hex_digit(text[i]) >= 0) {
+            value = value * 16 + preprocessor_hex_digit(text[i++]);
+
+            if (value > 0xFF) {
+                return -1;
+            }
+        }
+
+        break;
+
+    default:
+        if (ch < '0' || ch > '7') {
+            return -1;
+        }
+
+        value = ch - '0';
+
+        for (int digits = 1;
+             digits < 3 && i < length && text[i] >= '0' && text[i] <= '7';
+             digits++) {
+            value = value * 8 + text[i++] - '0';
+        }
+
+        if (value > 0xFF) {
+            return -1;
+        }
+
+        break;
+    }
+
+    *position = i;
+
+    return value;
+}
+
+// A character constant is an int holding a char, which is signed here, and
+// multi-character constants pack their characters from the left like GCC
+static PreprocessorValue
+preprocessor_parse_character(PreprocessorExpression *e,
+                             const PreprocessorToken *token) {
+    const char *text = token->text;
+    uint32_t end = token->length - 1;
+    uint32_t packed = 0;
+    int count = 0;
+
+    for (uint32_t i = 1; i < end; count++) {
+        int ch = (unsigned char)text[i];
+
+        if (ch == '\\') {
+            ch = preprocessor_escape(text, end, &i);
+
+            if (ch < 0) {
+                preprocessor_error(e->pp->file, token,
+                                   "invalid escape sequence in #if");
+            }
+        } else {
+            i++;
+        }
+
+        packed = packed << 8 | (uint32_t)ch;
+    }
+
+    if (count == 0 || text[end] != '\'') {
+        preprocessor_error(e->pp->file, token,
+                           "invalid character constant in #if");
+    }
+
+    return preprocessor_signed(count == 1 ? (signed char)packed
+                                          : (int32_t)packed);
+}
+
+static PreprocessorValue
+preprocessor_parse_primary(PreprocessorExpression *e) {
+    const PreprocessorToken *token = preprocessor_expression_peek(e);
+
+    if (token->kind == PT_EOF) {
+        preprocessor_error(e->pp->file, e->directive,
+                           "expected a value in #if");
+    }
+
+    e->position++;
+
+    if (token->kind == PT_NUMBER) {
+        return preprocessor_parse_number(e, token);
+    }
+
+    // Identifiers left after expansion are 0
+    if (token->kind == PT_IDENTIFIER) {
+        return preprocessor_signed(0);
+    }
+
+    if (token->kind == PT_STRING && token->text[0] == '\'' &&
+        token->length >= 2) {
+        return preprocessor_parse_character(e, token);
+    }
+
+    if (preprocessor_is(token, "(")) {
+        PreprocessorValue value = preprocessor_parse_conditional(e);
+
+        if (!preprocessor_is(preprocessor_expression_peek(e), ")")) {
+            preprocessor_error(e->pp->file,
+                               preprocessor_expression_location(e),
+                               "expected ')' in #if");
+        }
+
+        e->position++;
+
+        return value;
+    }
+
+    if (preprocessor_is(token, "-")) {
+        PreprocessorValue value = preprocessor_parse_primary(e);
+
+        value.value = 0 - value.value;
+
+        return value;
+    }
+
+    if (preprocessor_is(token, "+")) {
+        return preprocessor_parse_primary(e);
+    }
+
+    if (preprocessor_is(token, "!")) {
+        return preprocessor_signed(preprocessor_parse_primary(e).value == 0);
+    }
+
+    if (preprocessor_is(token, "~")) {
+        PreprocessorValue value = preprocessor_parse_primary(e);
+
+        value.value = ~value.value;
+
+        return value;
+    }
+
+    preprocessor_error(e->pp->file, token,
+                       "unexpected '%.*s' in #if", (int)token->length,
+                       token->text);
+
+    return preprocessor_signed(0);
+}
+
+typedef struct {
+    const char *text;
+    int precedence;
+} PreprocessorBinaryOperator;
+
+static const PreprocessorBinaryOperator preprocessor_binary_operators[] = {
+    {"*", 10},  {"/", 10}, {"%", 10}, {"+", 9},  {"-", 9},  {"<<", 8},
+    {">>", 8},  {"<", 7},  {">", 7},  {"<=", 7}, {">=", 7}, {"==", 6},
+    {"!=", 6},  {"&", 5},  {"^", 4},  {"|", 3},  {"&&", 2}, {"||", 1},
+};
+
+static int preprocessor_precedence(const PreprocessorToken *token) {
+    size_t count = sizeof(preprocessor_binary_operators) /
+                   sizeof(preprocessor_binary_operators[0]);
+
+    for (size_t i = 0; i < count; i++) {
+        if (preprocessor_is(token, preprocessor_binary_operators[i].text)) {
+            return preprocessor_binary_operators[i].precedence;
+        }
+    }
+
+    return 0;
+}
+
+// Errors in an operand that is not evaluated are not diagnosed, the
+// operation gives 0 instead
+static PreprocessorValue
+preprocessor_expression_error(PreprocessorExpression *e,
+                              const PreprocessorToken *operator,
+                              const char *message) {
+    if (e->unevaluated == 0) {
+        preprocessor_error(e->pp->file, operator, "%s", message);
+    }
+
+    return preprocessor_signed(0);
+}
+
+static PreprocessorValue
+preprocessor_shift(PreprocessorExpression *e,
+                   const PreprocessorToken *operator, PreprocessorValue left,
+                   PreprocessorValue right) {
+    if (preprocessor_is_negative(right) || right.value >= 64) {
+        return preprocessor_expression_error(e, operator,
+                                             "shift count out of range in #if");
+    }
+
+    if (operator->text[0] == '<') {
+        left.value <<= right.value;
+    } else if (preprocessor_is_negative(left)) {
+        left.value = ~(~left.value >> right.value);
+    } else {
+        left.value >>= right.value;
+    }
+
+    return left;
+}
+
+static PreprocessorValue
+preprocessor_divide(PreprocessorExpression *e,
+                    const PreprocessorToken *operator, PreprocessorValue left,
+                    PreprocessorValue right) {
+    bool remainder = operator->text[0] == '%';
+
+    if (right.value == 0) {
+        return preprocessor_expression_error(e, operator,
+                                             "division by zero in #if");
+    }
+
+    if (left.is_unsigned) {
+        left.value = remainder ? left.value % right.value
+                               : left.value / right.value;
+
+        return left;
+    }
+
+    intmax_t dividend = preprocessor_as_signed(left.value);
+    intmax_t divisor = preprocessor_as_signed(right.value);
+
+    if (dividend == INTMAX_MIN && divisor == -1) {
+        return remainder ? preprocessor_signed(0)
+                         : preprocessor_expression_error(
+                               e, operator, "integer overflow in #if");
+    }
+
+    return preprocessor_signed(remainder ? dividend % divisor
+                                         : dividend / divisor);
+}
+
+static PreprocessorValue
+preprocessor_parse_binary(PreprocessorExpression *e, int minimum_precedence) {
+    PreprocessorValue left = preprocessor_parse_primary(e);
+
+    while (true) {
+        const PreprocessorToken *operator= preprocessor_expression_peek(e);
+        int precedence = preprocessor_precedence(operator);
+
+        if (precedence == 0 || precedence < minimum_precedence) {
+            return left;
+        }
+
+        e->position++;
+
+        // The right operand of && and || is not evaluated when the left one
+        // decides the result
+        bool skip = (preprocessor_is(operator, "&&") && left.value == 0) ||
+                    (preprocessor_is(operator, "||") && left.value != 0);
+
+        e->unevaluated += skip;
+
+        PreprocessorValue right = preprocessor_parse_binary(e, precedence + 1);
+
+        e->unevaluated -= skip;
+
+        if (preprocessor_is(operator, "&&") ||
+            preprocessor_is(operator, "||")) {
+            left = preprocessor_signed(operator->text[0] == '&'
+                                           ? left.value && right.value
+                                           : left.value || right.value);
+            continue;
+        }
+
+        // Shifts keep the type of their left operand, the other operators
+        // convert both to unsigned when either is
+        if (preprocessor_is(operator, "<<") ||
+            preprocessor_is(operator, ">>")) {
+            left = preprocessor_shift(e, operator, left, right);
+            continue;
+        }
+
+        bool is_unsigned = left.is_unsigned || right.is_unsigned;
+
+        left.is_unsigned = right.is_unsigned = is_unsigned;
+
+        uintmax_t l = left.value;
+        uintmax_t r = right.value;
+        intmax_t sl = preprocessor_as_signed(l);
+        intmax_t sr = preprocessor_as_signed(r);
+
+        switch (operator->text[0]) {
+        case '*':
+            left.value = l * r;
+            break;
+
+        case '/':
+        case '%':
+            left = preprocessor_divide(e, operator, left, right);
+            break;
+
+        case '+':
+            left.value = l + r;
+            break;
+
+        case '-':
+            left.value = l - r;
+            break;
+
+        case '<':
+            left = preprocessor_signed(
+                operator->length == 1
+                    ? (is_unsigned ? l < r : sl < sr)
+                    : (is_unsigned ? l <= r : sl <= sr));
+            break;
+
+        case '>':
+            left = preprocessor_signed(
+                operator->length == 1
+                    ? (is_unsigned ? l > r : sl > sr)
+                    : (is_unsigned ? l >= r : sl >= sr));
+            break;
+
+        case '=':
+            left = preprocessor_signed(l == r);
+            break;
+
+        case '!':
+            left = preprocessor_signed(l != r);
+            break;
+
+        case '&':
+            left.value = l & r;
+            break;
+
+        case '^':
+            left.value = l ^ r;
+            break;
+
+        case '|':
+            left.value = l | r;
+            break;
+        }
+    }
+}
+
+static PreprocessorValue
+preprocessor_parse_conditional(PreprocessorExpression *e) {
+    PreprocessorValue condition = preprocessor_parse_binary(e, 1);
+
+    if (!preprocessor_is(preprocessor_expression_peek(e), "?")) {
+        return condition;
+    }
+
+    e->position++;
+
+    bool taken = condition.value != 0;
+
+    e->unevaluated += !taken;
+    PreprocessorValue then_value = preprocessor_parse_conditional(e);
+    e->unevaluated -= !taken;
+
+    if (!preprocessor_is(preprocessor_expression_peek(e), ":")) {
+        preprocessor_error(e->pp->file,
+                           preprocessor_expression_location(e),
+                           "expected ':' in #if");
+    }
+
+    e->position++;
+
+    e->unevaluated += taken;
+    PreprocessorValue else_value = preprocessor_parse_conditional(e);
+    e->unevaluated -= taken;
+
+    PreprocessorValue value = taken ? then_value : else_value;
+
+    value.is_unsigned = then_value.is_unsigned || else_value.is_unsigned;
+
+    return value;
+}
+
+// 'defined X' and 'defined(X)' are replaced before the line is expanded
+static bool preprocessor_evaluate(Preprocessor *pp,
+                                  const PreprocessorToken *line, size_t count,
+                                  const PreprocessorToken *directive) {
+    PreprocessorTokens replaced = {0};
+
+    for (size_t i = 0; i < count; i++) {
+        if (!preprocessor_is(&line[i], "defined")) {
+            da_append(&replaced, line[i]);
+            continue;
+        }
+
+        bool parenthesized =
+            i + 1 < count && preprocessor_is(&line[i + 1], "(");
+        size_t name = i + 1 + parenthesized;
+
+        if (name >= count || line[name].kind != PT_IDENTIFIER ||
+            (parenthesized &&
+             (name + 1 >= count || !preprocessor_is(&line[name + 1], ")")))) {
+            preprocessor_error(pp->file, &line[i],
+                               "'defined' needs a macro name");
+        }
+
+        PreprocessorToken value = line[i];
+
+        value.kind = PT_NUMBER;
+        value.text = preprocessor_find_macro(pp, line[name].text,
+                                             line[name].length) != NULL
+                         ? "1"
+                         : "0";
+        value.length = 1;
+
+        da_append(&replaced, value);
+
+        i = name + parenthesized;
+    }
+
+    PreprocessorTokens expanded =
+        preprocessor_expand_all(pp, replaced.items, replaced.count);
+
+    da_free(replaced);
+
+    PreprocessorExpression e = {
+        .pp = pp,
+        .directive = directive,
+        .tokens = expanded.items,
+        .count = expanded.count,
+    };
+
+    PreprocessorValue value = preprocessor_parse_conditional(&e);
+
+    if (e.position != e.count) {
+        preprocessor_error(pp->file, &e.tokens[e.position],
+                           "missing binary operator before '%.*s' in #if",
+                           (int)e.tokens[e.position].length,
+                           e.tokens[e.position].text);
+    }
+
+    return value.value != 0;
+}
+
+static bool preprocessor_is_directive(const PreprocessorToken *tokens,
+                                      size_t position) {
+    return preprocessor_is(&tokens[position], "#") &&
+           (tokens[position].flags & PF_LINE_START);
+}
+
+// Moves to the #elif, #else or #endif that ends the skipped group, which is
+// left for the caller to read
+static void preprocessor_skip_group(PreprocessorFile *file) {
+    const PreprocessorToken *tokens = file->input.tokens;
+    size_t position = file->input.position;
+    size_t depth = 0;
+
+    while (tokens[position].kind != PT_EOF) {
+        if (!preprocessor_is_directive(tokens, position) ||
+            tokens[position + 1].flags & PF_LINE_START) {
+            position++;
+            continue;
+        }
+
+        const PreprocessorToken *name = &tokens[position + 1];
+
+        if (preprocessor_is(name, "if") || preprocessor_is(name, "ifdef") ||
+            preprocessor_is(name, "ifndef")) {
+            depth++;
+        } else if (preprocessor_is(name, "endif")) {
+            if (depth == 0) {
+                break;
+            }
+
+            depth--;
+        } else if ((preprocessor_is(name, "elif") ||
+                    preprocessor_is(name, "else")) &&
+                   depth == 0) {
+            break;
+        }
+
+        position += 2;
+    }
+
+    file->input.position = position;
+}
+
+static void preprocessor_process(Preprocessor *pp, PreprocessorFile *file);
+
+static bool preprocessor_was_included(const Preprocessor *pp,
+                                      const PreprocessorHeader *header) {
+    for (size_t i = 0; i < pp->included.count; i++) {
+        if (pp->included.items[i] == header) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// The multiple-include optimization: a header whose guard macro is defined, or
+// which has #pragma once and was included before, is skipped without reading
+// anything but the cache
+static bool preprocessor_skip_header(Preprocessor *pp,
+                                     PreprocessorHeader *header) {
+    pthread_mutex_lock(&header->lock);
+
+    bool pragma_once = header->pragma_once;
+    bool guarded = header->guard_state == PG_GUARDED;
+    const char *guard = header->guard;
+    uint32_t guard_length = header->guard_length;
+
+    pthread_mutex_unlock(&header->lock);
+
+    if (pragma_once && preprocessor_was_included(pp, header)) {
+        return true;
+    }
+
+    return guarded && preprocessor_find_macro(pp, guard, guard_length) != NULL;
+}
+
+static PreprocessorHeader *preprocessor_probe(Preprocessor *pp,
+                                              const char *directory,
+                                              size_t directory_length,
+                                              const char *name,
+                                              size_t name_length) {
+    size_t length = directory_length + 1 + name_length;
+    char *path = arena_alloc(&pp->arena, length + 1);
+
+    memcpy(path, directory, directory_length);
+    path[directory_length] = '/';
+    memcpy(path + directory_length + 1, name, name_length);
+    path[length] = '\0';
+
+    // Quoted includes next to a file in the current directory
+    if (directory_length == 0) {
+        path++;
+        length--;
+    }
+
+    PreprocessorHeader *header = preprocessor_find_header(path, length);
+
+    return preprocessor_load_header(header) ? header : NULL;
+}
+
+// Quoted names are looked up next to the including file first, then both
+// kinds in the -I directories and the system directories
+static PreprocessorHeader *preprocessor_resolve(Preprocessor *pp,
+                                                const char *name,
+                                                size_t length, bool quoted) {
+    if (name[0] == '/') {
+        PreprocessorHeader *header = preprocessor_find_header(name, length);
+
+        return preprocessor_load_header(header) ? header : NULL;
+    }
+
+    PreprocessorHeader *header = NULL;
+
+    if (quoted) {
+        const char *slash = strrchr(pp->file->path, '/');
+
+        header = preprocessor_probe(pp, pp->file->path,
+                                    slash != NULL ? slash - pp->file->path : 0,
+                                    name, length);
+    }
+
+    const CompilePaths *directories = &pp->options->include_directories;
+
+    for (size_t i = 0; header == NULL && i < directories->count; i++) {
+        header = preprocessor_probe(pp, directories->items[i],
+                                    strlen(directories->items[i]), name,
+                                    length);
+    }
+
+    size_t system_count =
+        sizeof(pp->system_directories) / sizeof(pp->system_directories[0]);
+
+    for (size_t i = 0; header == NULL && i < system_count; i++) {
+        header = preprocessor_probe(pp, pp->system_directories[i],
+                                    strlen(pp->system_directories[i]), name,
+                                    length);
+    }
+
+    return header;
+}
+
+static void preprocessor_include(Preprocessor *pp,
+                                 const PreprocessorToken *line, size_t count,
+                                 const PreprocessorToken *directive) {
+    PreprocessorTokens expanded = {0};
+
+    // Anything but "name" and <name> is expanded first
+    if (count != 0 && !(line[0].kind == PT_STRING && line[0].text[0] == '"') &&
+        !preprocessor_is(&line[0], "<")) {
+        expanded = preprocessor_expand_all(pp, line, count);
+        line = expanded.items;
+        count = expanded.count;
+    }
+
+    PreprocessorOutput name = {0};
+    bool quoted = false;
+
+    if (count != 0 && line[0].kind == PT_STRING && line[0].text[0] == '"' &&
+        line[0].length >= 2) {
+        quoted = true;
+
+        for (uint32_t i = 1; i + 1 < line[0].length; i++) {
+            da_append(&name, line[0].text[i]);
+        }
+    } else if (count != 0 && preprocessor_is(&line[0], "<")) {
+        size_t i = 1;
+
+        for (; i < count && !preprocessor_is(&line[i], ">"); i++) {
+            if (i != 1 && (line[i].flags & PF_SPACE)) {
+                da_append(&name, ' ');
+            }
+
+            for (uint32_t j = 0; j < line[i].length; j++) {
+                da_append(&name, line[i].text[j]);
+            }
+        }
+
+        if (i == count) {
+            preprocessor_error(pp->file, &line[0],
+                               "missing '>' in #include");
+        }
+    } else {
+        preprocessor_error(pp->file, count != 0 ? &line[0] : directive,
+                           "#include expects \"FILENAME\" or <FILENAME>");
+    }
+
+    da_append(&name, '\0');
+
+    PreprocessorHeader *header =
+        preprocessor_resolve(pp, name.items, name.count - 1, quoted);
+
+    if (header == NULL) {
+        preprocessor_error(pp->file, directive, "'%s' file not found",
+                           name.items);
+    }
+
+    da_free(name);
+
+    if (preprocessor_skip_header(pp, header)) {
+        return;
+    }
+
+    if (pp->include_depth == PREPROCESSOR_MAX_INCLUDE_DEPTH) {
+        preprocessor_error(pp->file, directive,
+                           "#include nested too deeply");
+    }
+
+    if (!preprocessor_was_included(pp, header)) {
+        da_append(&pp->included, header);
+    }
+
+    PreprocessorFile file = {
+        .path = header->path,
+        .presumed_path = header->path,
+        .header = header,
+        .input = {.tokens = header->tokens.items},
+    };
+
+    PreprocessorFile *includer = pp->file;
+
+    pp->include_depth++;
+    preprocessor_process(pp, &file);
+    pp->include_depth--;
+
+    pp->file = includer;
+}
+
+static void preprocessor_push_conditional(Preprocessor *pp, bool taken,
+                                          const PreprocessorToken *directive) {
+    PreprocessorConditional conditional = {.taken = taken,
+                                           .token = *directive};
+
+    da_append(&pp->conditionals, conditional);
+
+    if (!taken) {
+        preprocessor_skip_group(pp->file);
+    }
+}
+
+static PreprocessorConditional *
+preprocessor_current_conditional(Preprocessor *pp,
+                                 const PreprocessorToken *directive,
+                                 const char *name) {
+    if (pp->conditionals.count == pp->file->conditional_base) {
+        preprocessor_error(pp->file, directive, "#%s without #if",
+                           name);
+    }
+
+    return &pp->conditionals.items[pp->conditionals.count - 1];
+}
+
+// '#line N "path"', and the '# N "path" flags' markers of preprocessed input,
+// make the line after the directive line N of path
+static void preprocessor_line(Preprocessor *pp, PreprocessorFile *file,
+                              const PreprocessorToken *name,
+                              const PreprocessorToken *line, size_t count) {
+    uint32_t next_line = (count != 0 ? line[count - 1].line : name->line) + 1;
+    bool marker = name->kind == PT_NUMBER;
+    const PreprocessorToken *number = name;
+
+    if (!marker) {
+        PreprocessorTokens expanded = preprocessor_expand_all(pp, line, count);
+
+        if (expanded.count == 0) {
+            preprocessor_error(file, name, "#line needs a line number");
+        }
+
+        number = &expanded.items[0];
+        line = expanded.items + 1;
+        count = expanded.count - 1;
+    }
+
+    uint64_t value = 0;
+
+    for (uint32_t i = 0; i < number->length && value <= INT32_MAX; i++) {
+        if (!preprocessor_is_digit(number->text[i])) {
+            value = UINT64_MAX;
+            break;
+        }
+
+        value = value * 10 + (number->text[i] - '0');
+    }
+
+    if (number->kind != PT_NUMBER || value > INT32_MAX) {
+        preprocessor_error(file, number,
+                           "'%.*s' after #line is not a line number",
+                           (int)number->length, number->text);
+    }
+
+    if (count != 0) {
+        if (line[0].kind != PT_STRING || line[0].text[0] != '"') {
+            preprocessor_error(file, &line[0],
+                               "invalid file name '%.*s' in #line",
+                               (int)line[0].length, line[0].text);
+        }
+
+        // Markers may carry flags after the name
+        if (!marker && count > 1) {
+            preprocessor_error(file, &line[1],
+                               "extra tokens at end of #line directive");
+        }
+
+        char *path = arena_alloc(&pp->arena, line[0].length);
+        size_t length = 0;
+
+        for (uint32_t i = 1; i + 1 < line[0].length; i++) {
+            if (line[0].text[i] == '\\' && i + 2 < line[0].length) {
+                i++;
+            }
+
+            path[length++] = line[0].text[i];
+        }
+
+        path[length] = '\0';
+        file->presumed_path = path;
+    }
+
+    file->line_offset = (int64_t)value - next_line;
+}
+
+static void preprocessor_directive(Preprocessor *pp, PreprocessorFile *file,
+                                   const PreprocessorToken *hash) {
+    // A lone '#' is the null directive
+    if (preprocessor_peek(&file->input)->flags & PF_LINE_START ||
+        preprocessor_peek(&file->input)->kind == PT_EOF) {
+        return;
+    }
+
+    PreprocessorToken name = preprocessor_next(&file->input);
+    size_t count = preprocessor_line_length(file);
+    const PreprocessorToken *line = &file->input.tokens[file->input.position];
+
+    file->input.position += count;
+
+    bool first = file->guard_state == FG_START;
+
+    if (file->guard_state == FG_START || file->guard_state == FG_AFTER_GUARD) {
+        file->guard_state = FG_INVALID;
+    }
+
+    if (preprocessor_is(&name, "include")) {
+        preprocessor_include(pp, line, count, &name);
+    } else if (preprocessor_is(&name, "define")) {
+        preprocessor_define(pp, line, count, &name);
+    } else if (preprocessor_is(&name, "undef")) {
+        if (count == 0 || line[0].kind != PT_IDENTIFIER) {
+            preprocessor_error(file, &name,
+                               "macro names must be identifiers");
+        }
+
+        PreprocessorMacro *macro =
+            preprocessor_find_macro(pp, line[0].text, line[0].length);
+
+        if (macro != NULL) {
+            macro->defined = false;
+        }
+    } else if (preprocessor_is(&name, "ifdef") ||
+               preprocessor_is(&name, "ifndef")) {
+        if (count == 0 || line[0].kind != PT_IDENTIFIER) {
+            preprocessor_error(file, &name,
+                               "macro names must be identifiers");
+        }
+
+        bool defined = preprocessor_find_macro(pp, line[0].text,
+                                               line[0].length) != NULL;
+        bool negated = name.length == sizeof("ifndef") - 1;
+
+        if (first && negated) {
+            file->guard_state = FG_IN_GUARD;
+            file->guard_conditional = pp->conditionals.count;
+            file->guard = &line[0];
+        }
+
+        preprocessor_push_conditional(pp, defined != negated, &name);
+    } else if (preprocessor_is(&name, "if")) {
+        preprocessor_push_conditional(
+            pp, preprocessor_evaluate(pp, line, count, &name), &name);
+    } else if (preprocessor_is(&name, "elif")) {
+        PreprocessorConditional *conditional =
+            preprocessor_current_conditional(pp, &name, "elif");
+
+        if (conditional->in_else) {
+            preprocessor_error(file, &name, "#elif after #else");
+        }
+
+        if (conditional->taken || !preprocessor_evaluate(pp, line, count,
+                                                         &name)) {
+            preprocessor_skip_group(file);
+        } else {
+            conditional->taken = true;
+        }
+    } else if (preprocessor_is(&name, "else")) {
+        PreprocessorConditional *conditional =
+            preprocessor_current_conditional(pp, &name, "else");
+
+        if (conditional->in_else) {
+            preprocessor_error(file, &name, "#else after #else");
+        }
+
+        conditional->in_else = true;
+
+        if (conditional->taken) {
+            preprocessor_skip_group(file);
+        } else {
+            conditional->taken = true;
+        }
+    } else if (preprocessor_is(&name, "endif")) {
+        preprocessor_current_conditional(pp, &name, "endif");
+
+        pp->conditionals.count--;
+
+        if (file->guard_state == FG_IN_GUARD &&
+            pp->conditionals.count == file->guard_conditional) {
+            file->guard_state = FG_AFTER_GUARD;
+        }
+    } else if (preprocessor_is(&name, "pragma")) {
+        if (count != 0 && preprocessor_is(&line[0], "once") &&
+            file->header != NULL) {
+            pthread_mutex_lock(&file->header->lock);
+            file->header->pragma_once = true;
+            pthread_mutex_unlock(&file->header->lock);
+        }
+    } else if (preprocessor_is(&name, "error") ||
+               preprocessor_is(&name, "warning")) {
+        const char *message = count != 0 ? line[0].text : "";
+        int message_length =
+            count != 0 ? line[count - 1].text + line[count - 1].length - message
+                       : 0;
+
+        if (name.text[0] == 'e') {
+            preprocessor_error(file, hash, "#error %.*s",
+                               message_length, message);
+        }
+
+        preprocessor_warning(file, hash, "#warning %.*s",
+                             message_length, message);
+    } else if (preprocessor_is(&name, "line") || name.kind == PT_NUMBER) {
+        preprocessor_line(pp, file, &name, line, count);
+    } else {
+        preprocessor_error(file, &name,
+                           "invalid preprocessing directive #%.*s",
+                           (int)name.length, name.text);
+    }
+
+    // An #else or #elif of the guard group means the file is not all guard
+    if (file->guard_state == FG_IN_GUARD &&
+        (preprocessor_is(&name, "else") || preprocessor_is(&name, "elif")) &&
+        pp->conditionals.count == file->guard_conditional + 1) {
+        file->guard_state = FG_INVALID;
+    }
+}
+
+static void preprocessor_process(Preprocessor *pp, PreprocessorFile *file) {
+    pp->file = file;
+    file->conditional_base = pp->conditionals.count;
+
+    while (true) {
+        bool from_file = file->input.pending.count == 0;
+        PreprocessorToken token = preprocessor_next(&file->input);
+
+        if (token.kind == PT_EOF) {
+            break;
+        }
+
+        if (from_file && preprocessor_is(&token, "#") &&
+            (token.flags & PF_LINE_START)) {
+            preprocessor_directive(pp, file, &token);
+            pp->file = file;
+            continue;
+        }
+
+        if (file->guard_state != FG_IN_GUARD) {
+            file->guard_state = FG_INVALID;
+        }
+
+        if (!preprocessor_expand(pp, &file->input, &token)) {
+            preprocessor_emit(pp, &token);
+        }
+    }
+
+    if (pp->conditionals.count != file->conditional_base) {
+        preprocessor_error(
+            file, &pp->conditionals.items[pp->conditionals.count - 1].token,
+            "unterminated conditional directive");
+    }
+
+    if (file->header != NULL) {
+        pthread_mutex_lock(&file->header->lock);
+
+        if (file->header->guard_state == PG_UNKNOWN) {
+            if (file->guard_state == FG_AFTER_GUARD) {
+                file->header->guard_state = PG_GUARDED;
+                file->header->guard = file->guard->text;
+                file->header->guard_length = file->guard->length;
+            } else {
+                file->header->guard_state = PG_NONE;
+            }
+        }
+
+        pthread_mutex_unlock(&file->header->lock);
+    }
+
+    da_free(file->input.pending);
+}
+
+static void preprocessor_define_builtin(Preprocessor *pp, const char *name,
+                                        PreprocessorBuiltin builtin) {
+    preprocessor_add_macro(pp, name, strlen(name))->builtin = builtin;
+}
+
+// Predefined macros and the -D and -U options are read as a file of their own
+static void preprocessor_predefine(Preprocessor *pp) {
+    PreprocessorOutput text = {0};
+
+    // The system headers are the host's, so are the macros naming its system
+    // and architecture
+    char predefined[256];
+
+    snprintf(predefined, sizeof(predefined),
+             "#define __ycc__ 1\n"
+             "#define __STDC__ 1\n"
+             "#define __STDC_HOSTED__ 1\n"
+             "#define __CHAR_BIT__ 8\n"
+             "#define __linux__ 1\n"
+             "#define __unix__ 1\n"
+             "#define __%s__ 1\n",
+             pp->host.machine);
+
+    for (const char *p = predefined; *p != '\0'; p++) {
+        da_append(&text, *p);
+    }
+
+    const CompileMacros *macros = &pp->options->macros;
+
+    for (size_t i = 0; i < macros->count; i++) {
+        const char *directive =
+            macros->items[i].undefine ? "#undef " : "#define ";
+        const char *definition = macros->items[i].definition;
+        bool has_value = strchr(definition, '=') != NULL;
+
+        for (const char *p = directive; *p != '\0'; p++) {
+            da_append(&text, *p);
+        }
+
+        for (const char *p = definition; *p != '\0'; p++) {
+            da_append(&text, *p == '=' && has_value ? ' ' : *p);
+
+            if (*p == '=') {
+                has_value = false;
+            }
+        }
+
+        if (strchr(definition, '=') == NULL && !macros->items[i].undefine) {
+            da_append(&text, ' ');
+            da_append(&text, '1');
+        }
+
+        da_append(&text, '\n');
+    }
+
+    char *content = arena_memdup(&pp->arena, text.items, text.count);
+
+    PreprocessorFile file = {.path = "<command line>",
+                             .presumed_path = "<command line>"};
+    PreprocessorTokens tokens = {0};
+
+    preprocessor_tokenize(file.path, content, text.count, &tokens);
+
+    file.input.tokens = tokens.items;
+
+    pp->output_enabled = false;
+    preprocessor_process(pp, &file);
+    pp->output_enabled = true;
+
+    da_free(tokens);
+    da_free(text);
+}
+
+bool preprocessor_run(const InputFile *input_file,
+                      const CompileOptions *options, InputFile *output) {
+    const char *content = input_file->file_content;
+    size_t length = input_file->file_length;
+
+    // Without directives and predefined macro names there is nothing to do
+    if (options->macros.count == 0 && memchr(content, '#', length) == NULL &&
+        memmem(content, length, "__", 2) == NULL) {
+        return false;
+    }
+
+    Preprocessor pp = {
+        .arena = arena_new(false),
+        .options = options,
+        .macro_slot_count = 256,
+        .output_path = input_file->file_path,
+        .output_line = 1,
+    };
+
+    pp.macros = calloc(pp.macro_slot_count, sizeof(PreprocessorMacro *));
+
+    if (pp.macros == NULL) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    if (uname(&pp.host) != 0) {
+        strcpy(pp.host.machine, "unknown");
+    }
+
+    char multiarch_directory[sizeof("/usr/include/-linux-gnu") +
+                             sizeof(pp.host.machine)];
+
+    snprintf(multiarch_directory, sizeof(multiarch_directory),
+             "/usr/include/%s-linux-gnu", pp.host.machine);
+
+    pp.system_directories[0] = "/usr/local/include";
+    pp.system_directories[1] = multiarch_directory;
+    pp.system_directories[2] = "/usr/include";
+
+    preprocessor_define_builtin(&pp, "__FILE__", PB_FILE);
+    preprocessor_define_builtin(&pp, "__LINE__", PB_LINE);
+
+    preprocessor_predefine(&pp);
+
+    PreprocessorTokens tokens = {0};
+    preprocessor_tokenize(input_file->file_path, content, length, &tokens);
+
+    PreprocessorFile file = {
+        .path = input_file->file_path,
+        .presumed_path = input_file->file_path,
+        .input = {.tokens = tokens.items},
+    };
+
+    preprocessor_process(&pp, &file);
+
+    preprocessor_write(&pp, "\n", 1);
+
+    size_t output_length = pp.output.count;
+
+    // The lexer expects the padding of input files
+    for (size_t i = 0; i < INPUT_FILE_PADDING; i++) {
+        preprocessor_write(&pp, "", 1);
+    }
+
+    *output = (InputFile){
+        .file_path = input_file->file_path,
+        .file_content = pp.output.items,
+        .file_length = output_length,
+        .ownership = IFO_HEAP,
+        .allocation_length = pp.output.capacity,
+    };
+
+    da_free(tokens);
+    free(pp.macros);
+    da_free(pp.conditionals);
+    da_free(pp.included);
+    arena_free(&pp.arena);
+
+    return true;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "compile_options.h"
+#include "input_file.h"
+
+// Runs the directives of the input and expands its macros into a new input
+// file for the lexer. Wherever the text stops following the lines of one file
+// it carries a line marker, '# <line> "<path>"', which the lexer skips and the
+// diagnostics resolve locations with. Returns false and leaves the output
+// alone when the input has nothing to preprocess.
+//
+// Headers are mapped and tokenized once per process and shared by every
+// translation unit, a header wrapped in an include guard or marked with
+// #pragma once is skipped without being looked at again
+bool preprocessor_run(const InputFile *input_file,
+                      const CompileOptions *options, InputFile *output);
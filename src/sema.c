@@ -0,0 +1,456 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "arena.h"
+#include "ast.h"
+#include "const_eval.h"
+#include "diagnostics.h"
+#include "interner.h"
+#include "sema.h"
+#include "symbol_table.h"
+#include "type.h"
+
+Sema sema_new(ASTRoot *root, bool wrapv) {
+    return (Sema){
+        .root = root,
+        .wrapv = wrapv,
+        .symbol_table = symbol_table_new(),
+        .main_atom = interner_intern("main", 4),
+    };
+}
+
+// Integer promotions, anything narrower than int is computed as an int
+static TypeId sema_promote(TypeId type) {
+    return type_is_integer(type) &&
+                   type_integer_rank(type) < type_integer_rank(TY_INT)
+               ? TY_INT
+               : type;
+}
+
+// Usual arithmetic conversions
+static TypeId sema_common_type(TypeId lhs_type, TypeId rhs_type) {
+    if (type_is_float(lhs_type) || type_is_float(rhs_type)) {
+        return lhs_type > rhs_type ? lhs_type : rhs_type;
+    }
+
+    lhs_type = sema_promote(lhs_type);
+    rhs_type = sema_promote(rhs_type);
+
+    if (type_is_unsigned(lhs_type) == type_is_unsigned(rhs_type)) {
+        return type_integer_rank(lhs_type) > type_integer_rank(rhs_type)
+                   ? lhs_type
+                   : rhs_type;
+    }
+
+    TypeId unsigned_type = type_is_unsigned(lhs_type) ? lhs_type : rhs_type;
+    TypeId signed_type = type_is_unsigned(lhs_type) ? rhs_type : lhs_type;
+
+    if (type_integer_rank(unsigned_type) >= type_integer_rank(signed_type)) {
+        return unsigned_type;
+    }
+
+    // The signed type wins only when it can hold every unsigned value
+    if (type_integer_bits(signed_type) > type_integer_bits(unsigned_type)) {
+        return signed_type;
+    }
+
+    return type_to_unsigned(signed_type);
+}
+
+static SymbolId sema_new_symbol(Sema *sema) {
+    return sema->root->symbol_count++;
+}
+
+// Returns the expression converted to the type, wrapped in an EK_CAST node
+// unless it already has that type
+static ASTIndex sema_convert(Sema *sema, ASTIndex expr, TypeId type) {
+    ASTRoot *root = sema->root;
+
+    TypeId expr_type = root->exprs.types[expr];
+
+    if (expr_type == type) {
+        return expr;
+    }
+
+    if (!type_is_arithmetic(expr_type) || !type_is_arithmetic(type)) {
+        errorf(root->exprs.locs[expr], "incompatible types in conversion");
+
+        diagnostics_fail();
+    }
+
+    ASTIndex cast = ast_add_expr(root, EK_CAST, root->exprs.locs[expr],
+                                 (ASTExprValue){.cast = {.operand = expr}});
+
+    root->exprs.types[cast] = type;
+
+    const_eval_fold(root, cast, sema->context.constant_only, sema->wrapv);
+
+    return cast;
+}
+
+static void sema_expect_arithmetic(Sema *sema, ASTIndex expr) {
+    if (!type_is_arithmetic(sema->root->exprs.types[expr])) {
+        errorf(sema->root->exprs.locs[expr], "expected an arithmetic operand");
+
+        diagnostics_fail();
+    }
+}
+
+static void sema_analyze_expr(Sema *sema, ASTIndex expr);
+
+static TypeId sema_analyze_call(Sema *sema, ASTIndex expr, ASTCall *call) {
+    ASTRoot *root = sema->root;
+    SourceLoc loc = root->exprs.locs[expr];
+
+    if (sema->context.constant_only) {
+        errorf(loc, "expected a constant expression only");
+
+        diagnostics_fail();
+    }
+
+    sema_analyze_expr(sema, call->callable);
+
+    TypeId callable_type = root->exprs.types[call->callable];
+
+    if (type_kind(callable_type) != TY_FUNCTION) {
+        errorf(loc, "expected a callable");
+
+        diagnostics_fail();
+    }
+
+    const FunctionPrototype *prototype = &type_get(callable_type)->prototype;
+
+    if (call->arguments.count != prototype->parameter_count &&
+        !(prototype->variadic &&
+          call->arguments.count > prototype->parameter_count)) {
+        errorf(loc, "expected %d %s got %d", prototype->parameter_count,
+               prototype->parameter_count != 1 ? "arguments" : "argument",
+               call->arguments.count);
+
+        diagnostics_fail();
+    }
+
+    for (size_t i = 0; i < call->arguments.count; i++) {
+        ASTIndex argument = root->extra.items[call->arguments.start + i];
+
+        sema_analyze_expr(sema, argument);
+
+        TypeId parameter_type = TY_VOID;
+
+        if (i < prototype->parameter_count) {
+            parameter_type = prototype->parameters[i];
+        } else {
+            // Default argument promotions for the variadic part
+            sema_expect_arithmetic(sema, argument);
+
+            parameter_type = root->exprs.types[argument] == TY_FLOAT
+                                 ? TY_DOUBLE
+                                 : sema_promote(root->exprs.types[argument]);
+        }
+
+        root->extra.items[call->arguments.start + i] =
+            sema_convert(sema, argument, parameter_type);
+    }
+
+    return prototype->return_type;
+}
+
+// Values are copied out of the pools before recursing, analyzing children can
+// add cast nodes which may move the pools
+static void sema_analyze_expr(Sema *sema, ASTIndex expr) {
+    ASTRoot *root = sema->root;
+
+    ASTExprValue value = root->exprs.values[expr];
+    TypeId type = TY_VOID;
+
+    switch (root->exprs.kinds[expr]) {
+    // The parser gives literals their type, which depends on the suffix
+    case EK_INT:
+    case EK_FLOAT:
+        type = root->exprs.types[expr];
+        break;
+
+    case EK_IDENTIFIER: {
+        if (sema->context.constant_only) {
+            errorf(root->exprs.locs[expr],
+                   "expected a constant expression only");
+
+            diagnostics_fail();
+        }
+
+        Symbol symbol =
+            symbol_table_lookup(&sema->symbol_table, value.identifier.name);
+
+        value.identifier.symbol = symbol.id;
+        type = symbol.type;
+
+        break;
+    }
+
+    case EK_UNARY_OPERATION:
+        sema_analyze_expr(sema, value.unary.rhs);
+        sema_expect_arithmetic(sema, value.unary.rhs);
+
+        if (value.unary.unary_operator == UO_BANG) {
+            type = TY_INT;
+        } else {
+            type = sema_promote(root->exprs.types[value.unary.rhs]);
+            value.unary.rhs = sema_convert(sema, value.unary.rhs, type);
+        }
+
+        break;
+
+    case EK_BINARY_OPERATION:
+        sema_analyze_expr(sema, value.binary.lhs);
+        sema_analyze_expr(sema, value.binary.rhs);
+        sema_expect_arithmetic(sema, value.binary.lhs);
+        sema_expect_arithmetic(sema, value.binary.rhs);
+
+        type = sema_common_type(root->exprs.types[value.binary.lhs],
+                                root->exprs.types[value.binary.rhs]);
+
+        if (value.binary.binary_operator == BO_PERCENT &&
+            !type_is_integer(type)) {
+            errorf(root->exprs.locs[expr], "expected integer operands to '%%'");
+
+            diagnostics_fail();
+        }
+
+        value.binary.lhs = sema_convert(sema, value.binary.lhs, type);
+        value.binary.rhs = sema_convert(sema, value.binary.rhs, type);
+
+        break;
+
+    case EK_CALL:
+        type = sema_analyze_call(sema, expr, &value.call);
+        break;
+
+    case EK_CAST:
+        return;
+
+    default:
+        assert(false && "unreachable");
+    }
+
+    root->exprs.values[expr] = value;
+    root->exprs.types[expr] = type;
+
+    // Operands were folded first, so whole constant subtrees collapse bottom up
+    const_eval_fold(root, expr, sema->context.constant_only, sema->wrapv);
+}
+
+static void sema_analyze_return_stmt(Sema *sema, ASTIndex stmt) {
+    ASTRoot *root = sema->root;
+
+    ASTIndex ret = root->stmts.values[stmt].ret;
+    TypeId return_type = sema->context.function->prototype.return_type;
+
+    if (ret == AST_NONE) {
+        if (return_type != TY_VOID) {
+            errorf(root->stmts.locs[stmt], "expected non-void return type");
+
+            diagnostics_fail();
+        }
+
+        return;
+    }
+
+    if (return_type == TY_VOID) {
+        errorf(root->stmts.locs[stmt],
+               "a 'void' function cannot return a value");
+
+        diagnostics_fail();
+    }
+
+    sema_analyze_expr(sema, ret);
+
+    root->stmts.values[stmt].ret = sema_convert(sema, ret, return_type);
+}
+
+static void sema_analyze_variable(Sema *sema, ASTVariable *variable,
+                                  SymbolLinkage linkage) {
+    if (variable->type == TY_VOID) {
+        errorf(variable->name.loc,
+               "a variable cannot have incomplete type 'void'");
+
+        diagnostics_fail();
+    }
+
+    if (variable->value != AST_NONE) {
+        sema->context.constant_only = linkage == SL_GLOBAL;
+
+        sema_analyze_expr(sema, variable->value);
+
+        variable->value = sema_convert(sema, variable->value, variable->type);
+
+        sema->context.constant_only = false;
+
+        // Only literals and operations on them get here, and those are all
+        // folded, codegen emits global initializers as plain constants
+        assert(linkage != SL_GLOBAL ||
+               const_eval_is_literal(sema->root, variable->value));
+    }
+
+    variable->symbol = sema_new_symbol(sema);
+
+    Symbol symbol = {.type = variable->type,
+                     .name = variable->name,
+                     .linkage = linkage,
+                     .id = variable->symbol,
+                     .defined = true};
+
+    symbol_table_set(&sema->symbol_table, symbol);
+}
+
+static void sema_analyze_stmt(Sema *sema, ASTIndex stmt) {
+    ASTRoot *root = sema->root;
+    const ASTStmtValue *value = &root->stmts.values[stmt];
+
+    switch (root->stmts.kinds[stmt]) {
+    case SK_RETURN:
+        sema_analyze_return_stmt(sema, stmt);
+        break;
+
+    case SK_VARIABLE_DECLARATION:
+        sema_analyze_variable(
+            sema, &root->variables.items[value->variable_declaration],
+            SL_LOCAL);
+        break;
+
+    case SK_EXPR:
+        sema_analyze_expr(sema, value->expr);
+
+        if (root->exprs.kinds[value->expr] != EK_CALL) {
+            warnf(root->exprs.locs[value->expr],
+                  "expression is not used, thus it will not be compiled");
+        }
+
+        break;
+
+    default:
+        assert(false && "unreachable");
+    }
+}
+
+// A function may be declared any number of times with the same type, all the
+// declarations share one symbol and at most one of them has a body
+static void sema_declare_function(Sema *sema,
+                                  ASTFunctionPrototype *prototype) {
+    Symbol *previous = symbol_table_find(&sema->symbol_table, SN_ORDINARY,
+                                         prototype->name.atom);
+
+    if (previous != NULL && type_kind(previous->type) == TY_FUNCTION) {
+        if (previous->type != prototype->type) {
+            errorf(prototype->name.loc, "conflicting types for '%s'",
+                   interner_text(prototype->name.atom));
+
+            diagnostics_fail();
+        }
+
+        if (previous->defined && prototype->definition) {
+            errorf(prototype->name.loc, "redifinition of '%s'",
+                   interner_text(prototype->name.atom));
+
+            diagnostics_fail();
+        }
+
+        previous->defined |= prototype->definition;
+        prototype->symbol = previous->id;
+
+        return;
+    }
+
+    prototype->symbol = sema_new_symbol(sema);
+
+    Symbol symbol = {.type = prototype->type,
+                     .name = prototype->name,
+                     .linkage = SL_GLOBAL,
+                     .id = prototype->symbol,
+                     .defined = prototype->definition};
+
+    symbol_table_set(&sema->symbol_table, symbol);
+}
+
+static void sema_analyze_function(Sema *sema, ASTFunction *function) {
+    ASTRoot *root = sema->root;
+    ASTFunctionPrototype *prototype = &function->prototype;
+    ASTFunctionParameter *parameters =
+        &root->parameters.items[prototype->parameters.start];
+
+    if (prototype->name.atom == sema->main_atom &&
+        prototype->return_type != TY_INT) {
+        warnf(prototype->name.loc, "return type of 'main' is not 'int'");
+    }
+
+    ArenaCheckpoint checkpoint = arena_checkpoint(root->arena);
+
+    TypeId *parameter_types = arena_alloc(
+        root->arena, prototype->parameters.count * sizeof(TypeId));
+
+    for (size_t i = 0; i < prototype->parameters.count; i++) {
+        parameter_types[i] = parameters[i].expected_type;
+    }
+
+    prototype->type =
+        type_function(prototype->return_type, parameter_types,
+                      prototype->parameters.count, prototype->variadic);
+
+    arena_rollback(root->arena, checkpoint);
+
+    sema_declare_function(sema, prototype);
+
+    if (!prototype->definition) {
+        return;
+    }
+
+    sema->context.function = function;
+
+    // Parameters share the outermost block scope of the function body
+    symbol_table_push_scope(&sema->symbol_table);
+
+    for (size_t i = 0; i < prototype->parameters.count; i++) {
+        parameters[i].symbol = sema_new_symbol(sema);
+
+        Symbol symbol = {.type = parameters[i].expected_type,
+                         .name = parameters[i].name,
+                         .linkage = SL_LOCAL,
+                         .id = parameters[i].symbol,
+                         .defined = true};
+
+        symbol_table_set(&sema->symbol_table, symbol);
+    }
+
+    for (size_t i = 0; i < function->body.count; i++) {
+        sema_analyze_stmt(sema, root->extra.items[function->body.start + i]);
+    }
+
+    symbol_table_pop_scope(&sema->symbol_table);
+
+    sema->context.function = NULL;
+}
+
+void sema_analyze_root(Sema *sema) {
+    ASTRoot *root = sema->root;
+
+    for (size_t i = 0; i < root->declarations.count; i++) {
+        ASTIndex index = root->declarations.indices[i];
+
+        switch (root->declarations.kinds[i]) {
+        case DK_FUNCTION:
+            sema_analyze_function(sema, &root->functions.items[index]);
+            break;
+
+        case DK_VARIABLE:
+            sema_analyze_variable(sema, &root->variables.items[index],
+                                  SL_GLOBAL);
+            break;
+
+        default:
+            assert(false && "unreachable");
+        }
+    }
+}
+
+void sema_free(Sema *sema) { symbol_table_free(&sema->symbol_table); }
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "ast.h"
+#include "interner.h"
+#include "symbol_table.h"
+
+typedef struct {
+    const ASTFunction *function;
+    bool constant_only;
+} SemaContext;
+
+// Runs between the parser and the code generator: resolves every name to its
+// symbol, computes the type of every expression once and makes implicit
+// conversions explicit as EK_CAST nodes, so codegen never has to infer
+// anything
+typedef struct {
+    ASTRoot *root;
+
+    SymbolTable symbol_table;
+
+    Atom main_atom;
+
+    bool wrapv; // -fwrapv, signed overflow of constants is not reported
+
+    SemaContext context;
+} Sema;
+
+Sema sema_new(ASTRoot *root, bool wrapv);
+void sema_analyze_root(Sema *sema);
+void sema_free(Sema *sema);
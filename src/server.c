@@ -0,0 +1,471 @@
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "compile_options.h"
+#include "dynamic_array.h"
+#include "server.h"
+#include "target.h"
+
+// A request is a ServerHeader sent together with the standard input, output
+// and error of the client as SCM_RIGHTS, then the payload: the arguments, the
+// working directory and the environment entries, each '\0' terminated. The
+// reply is the exit status as an int32_t
+#define SERVER_STREAM_COUNT 3
+#define SERVER_MAX_PAYLOAD (16 * 1024 * 1024)
+
+typedef struct {
+    uint32_t length; // Of the payload
+    uint32_t argument_count;
+} ServerHeader;
+
+// A request being compiled by a child, the server keeps the connection to
+// send the exit status once the child is reaped
+typedef struct {
+    pid_t pid;
+    int connection;
+    uint64_t id;
+    struct timespec start;
+} ServerRequest;
+
+typedef struct {
+    ServerRequest *items;
+    size_t count;
+    size_t capacity;
+} ServerRequests;
+
+const char *server_default_socket_path(void) {
+    static char path[sizeof(((struct sockaddr_un *)NULL)->sun_path)];
+
+    const char *directory = getenv("XDG_RUNTIME_DIR");
+
+    if (directory != NULL && directory[0] != '\0') {
+        snprintf(path, sizeof(path), "%s/ycc.sock", directory);
+    } else {
+        snprintf(path, sizeof(path), "/tmp/ycc-%u.sock", (unsigned)getuid());
+    }
+
+    return path;
+}
+
+static bool server_address(const char *socket_path,
+                           struct sockaddr_un *address) {
+    *address = (struct sockaddr_un){.sun_family = AF_UNIX};
+
+    if (strlen(socket_path) >= sizeof(address->sun_path)) {
+        fprintf(stderr, "error: socket path '%s' is too long\n", socket_path);
+        return false;
+    }
+
+    strcpy(address->sun_path, socket_path);
+
+    return true;
+}
+
+static bool server_read_all(int fd, void *data, size_t length) {
+    char *bytes = data;
+
+    while (length > 0) {
+        ssize_t count = read(fd, bytes, length);
+
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (count <= 0) {
+            return false;
+        }
+
+        bytes += count;
+        length -= count;
+    }
+
+    return true;
+}
+
+static bool server_write_all(int fd, const void *data, size_t length) {
+    const char *bytes = data;
+
+    while (length > 0) {
+        ssize_t count = write(fd, bytes, length);
+
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (count < 0) {
+            return false;
+        }
+
+        bytes += count;
+        length -= count;
+    }
+
+    return true;
+}
+
+static double server_milliseconds_since(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) * 1e3 +
+           (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+// Runs in the child forked for a request, takes over the streams, working
+// directory and environment of the client and never returns
+static void server_handle(int connection, ServerCompile compile) {
+    ServerHeader request;
+    int streams[SERVER_STREAM_COUNT];
+
+    char control[CMSG_SPACE(sizeof(streams))];
+    struct iovec vector = {.iov_base = &request, .iov_len = sizeof(request)};
+    struct msghdr message = {
+        .msg_iov = &vector,
+        .msg_iovlen = 1,
+        .msg_control = control,
+        .msg_controllen = sizeof(control),
+    };
+
+    if (recvmsg(connection, &message, MSG_WAITALL) != sizeof(request)) {
+        _exit(1);
+    }
+
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+
+    if (header == NULL || header->cmsg_type != SCM_RIGHTS ||
+        header->cmsg_len != CMSG_LEN(sizeof(streams)) ||
+        request.length > SERVER_MAX_PAYLOAD) {
+        _exit(1);
+    }
+
+    uint32_t length = request.length;
+
+    memcpy(streams, CMSG_DATA(header), sizeof(streams));
+
+    char *payload = malloc(length + 1);
+
+    if (payload == NULL || !server_read_all(connection, payload, length)) {
+        _exit(1);
+    }
+
+    payload[length] = '\0';
+    close(connection);
+
+    for (int i = 0; i < SERVER_STREAM_COUNT; i++) {
+        dup2(streams[i], i);
+        close(streams[i]);
+    }
+
+    const char **argv = malloc((request.argument_count + 1) * sizeof(char *));
+
+    if (argv == NULL) {
+        _exit(1);
+    }
+
+    size_t offset = 0;
+    uint32_t argc = 0;
+
+    for (; argc < request.argument_count && offset < length; argc++) {
+        argv[argc] = payload + offset;
+        offset += strlen(payload + offset) + 1;
+    }
+
+    argv[argc] = NULL;
+
+    const char *directory = payload + offset;
+
+    if (argc == 0 || argc != request.argument_count || offset >= length ||
+        chdir(directory) < 0) {
+        fprintf(stderr, "error: invalid compile server request\n");
+        _exit(1);
+    }
+
+    // The cache directory, TMPDIR and the PATH the linker is found on are
+    // the client's, the strings stay alive until the child exits
+    clearenv();
+
+    for (offset += strlen(directory) + 1; offset < length;
+         offset += strlen(payload + offset) + 1) {
+        putenv(payload + offset);
+    }
+
+    exit(compile(argc, argv));
+}
+
+static void server_reap(ServerRequests *requests) {
+    int status;
+    pid_t pid;
+
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        for (size_t i = 0; i < requests->count; i++) {
+            ServerRequest *request = &requests->items[i];
+
+            if (request->pid != pid) {
+                continue;
+            }
+
+            int32_t exit_status = WIFEXITED(status)
+                                      ? WEXITSTATUS(status)
+                                      : 128 + WTERMSIG(status);
+
+            // A client killed during its request is a normal disconnect,
+            // SIGPIPE is ignored so the write fails with EPIPE
+            bool delivered = server_write_all(
+                request->connection, &exit_status, sizeof(exit_status));
+            close(request->connection);
+
+            fprintf(stderr,
+                    "ycc: request %lu finished in %.2f ms, status %d%s\n",
+                    (unsigned long)request->id,
+                    server_milliseconds_since(&request->start), exit_status,
+                    delivered ? "" : ", client disconnected");
+
+            *request = requests->items[--requests->count];
+            break;
+        }
+    }
+}
+
+// Every request runs in a child forked from the server, so it starts with
+// libLLVM loaded and relocated, the targets registered and the host target
+// resolved, and requests never share mutable state
+int server_run(const char *socket_path, ServerCompile compile) {
+    struct sockaddr_un address;
+
+    if (!server_address(socket_path, &address)) {
+        return 1;
+    }
+
+    target_initialize();
+
+    CompileOptions options = {0};
+    Target target = target_select(&options);
+    LLVMDisposeTargetMachine(target_create_machine(&target, &options));
+    target_free(&target);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    unlink(socket_path);
+
+    // Requests run as the server's user, so only that user may connect: the
+    // socket is created without access for anyone else, whatever the umask
+    mode_t mask = umask(0077);
+
+    bool bound =
+        listener >= 0 &&
+        bind(listener, (struct sockaddr *)&address, sizeof(address)) == 0;
+
+    umask(mask);
+
+    if (!bound || listen(listener, SOMAXCONN) < 0) {
+        fprintf(stderr, "error: cannot listen on '%s': %s\n", socket_path,
+                strerror(errno));
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    sigset_t child_signal;
+    sigemptyset(&child_signal);
+    sigaddset(&child_signal, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &child_signal, NULL);
+
+    int child_fd = signalfd(-1, &child_signal, SFD_CLOEXEC | SFD_NONBLOCK);
+
+    fprintf(stderr, "ycc: listening on '%s'\n", socket_path);
+
+    ServerRequests requests = {0};
+    uint64_t request_count = 0;
+
+    for (;;) {
+        struct pollfd fds[] = {
+            {.fd = listener, .events = POLLIN},
+            {.fd = child_fd, .events = POLLIN},
+        };
+
+        if (poll(fds, 2, -1) < 0 && errno != EINTR) {
+            fprintf(stderr, "error: poll: %s\n", strerror(errno));
+            return 1;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            struct signalfd_siginfo info;
+
+            while (read(child_fd, &info, sizeof(info)) == sizeof(info)) {
+            }
+
+            server_reap(&requests);
+        }
+
+        if (!(fds[0].revents & POLLIN)) {
+            continue;
+        }
+
+        int connection = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+
+        if (connection < 0) {
+            continue;
+        }
+
+        // Also checked on every connection, the socket may have been made
+        // accessible after it was created
+        struct ucred peer;
+        socklen_t peer_length = sizeof(peer);
+
+        if (getsockopt(connection, SOL_SOCKET, SO_PEERCRED, &peer,
+                       &peer_length) < 0 ||
+            peer.uid != getuid()) {
+            close(connection);
+            continue;
+        }
+
+        ServerRequest request = {.connection = connection,
+                                 .id = ++request_count};
+
+        clock_gettime(CLOCK_MONOTONIC, &request.start);
+
+        request.pid = fork();
+
+        if (request.pid == 0) {
+            close(listener);
+            close(child_fd);
+            sigprocmask(SIG_UNBLOCK, &child_signal, NULL);
+            signal(SIGPIPE, SIG_DFL);
+
+            server_handle(connection, compile);
+        }
+
+        if (request.pid < 0) {
+            fprintf(stderr, "error: fork: %s\n", strerror(errno));
+            close(connection);
+            continue;
+        }
+
+        da_append(&requests, request);
+    }
+}
+
+bool server_forward(const char *socket_path, int argc, const char **argv,
+                    int *status) {
+    struct sockaddr_un address;
+
+    if (!server_address(socket_path, &address)) {
+        return false;
+    }
+
+    int connection = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    if (connection < 0 ||
+        connect(connection, (struct sockaddr *)&address, sizeof(address)) <
+            0) {
+        if (connection >= 0) {
+            close(connection);
+        }
+
+        return false;
+    }
+
+    // Once connected the request may already be running, so failures are
+    // reported instead of compiling a second time locally
+    *status = 1;
+
+    char *cwd = getcwd(NULL, 0);
+
+    if (cwd == NULL) {
+        perror("error");
+        close(connection);
+        return true;
+    }
+
+    size_t length = strlen(cwd) + 1;
+
+    for (int i = 0; i < argc; i++) {
+        length += strlen(argv[i]) + 1;
+    }
+
+    for (char **entry = environ; *entry != NULL; entry++) {
+        length += strlen(*entry) + 1;
+    }
+
+    char *payload = malloc(length);
+
+    if (payload == NULL || length > SERVER_MAX_PAYLOAD) {
+        fprintf(stderr, "error: command line too long for the compile "
+                        "server\n");
+        free(payload);
+        free(cwd);
+        close(connection);
+        return true;
+    }
+
+    size_t offset = 0;
+
+    for (int i = 0; i < argc; i++) {
+        size_t size = strlen(argv[i]) + 1;
+
+        memcpy(payload + offset, argv[i], size);
+        offset += size;
+    }
+
+    memcpy(payload + offset, cwd, strlen(cwd) + 1);
+    offset += strlen(cwd) + 1;
+    free(cwd);
+
+    for (char **entry = environ; *entry != NULL; entry++) {
+        size_t size = strlen(*entry) + 1;
+
+        memcpy(payload + offset, *entry, size);
+        offset += size;
+    }
+
+    ServerHeader request = {.length = length, .argument_count = argc};
+    int streams[SERVER_STREAM_COUNT] = {STDIN_FILENO, STDOUT_FILENO,
+                                        STDERR_FILENO};
+
+    char control[CMSG_SPACE(sizeof(streams))] = {0};
+    struct iovec vector = {.iov_base = &request, .iov_len = sizeof(request)};
+    struct msghdr message = {
+        .msg_iov = &vector,
+        .msg_iovlen = 1,
+        .msg_control = control,
+        .msg_controllen = sizeof(control),
+    };
+
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(streams));
+    memcpy(CMSG_DATA(header), streams, sizeof(streams));
+
+    int32_t exit_status;
+
+    bool forwarded =
+        sendmsg(connection, &message, 0) == sizeof(request) &&
+        server_write_all(connection, payload, length) &&
+        server_read_all(connection, &exit_status, sizeof(exit_status));
+
+    free(payload);
+    close(connection);
+
+    if (forwarded) {
+        *status = exit_status;
+    } else {
+        fprintf(stderr, "error: lost the connection to the compile server\n");
+    }
+
+    return true;
+}
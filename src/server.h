@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdbool.h>
+
+// Compiles with the arguments of a command line and returns the exit status
+typedef int (*ServerCompile)(int argc, const char **argv);
+
+// Socket used by --server and by clients when no path is given
+const char *server_default_socket_path(void);
+
+// Serves compile requests on the socket until the process is killed
+int server_run(const char *socket_path, ServerCompile compile);
+
+// Has the server at the socket run the command line with the standard
+// streams, working directory and environment of this process, returns false
+// when no server accepts the connection
+bool server_forward(const char *socket_path, int argc, const char **argv,
+                    int *status);
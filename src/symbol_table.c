@@ -1,46 +1,189 @@
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
 
 #include "ast.h"
 #include "diagnostics.h"
 #include "dynamic_array.h"
+#include "hash.h"
+#include "interner.h"
 #include "symbol_table.h"
 
+#define SYMBOL_NONE UINT32_MAX
+#define SYMBOL_SLOT_EMPTY UINT64_MAX
+
 SymbolTable symbol_table_new() { return (SymbolTable){}; }
 
-void symbol_table_set(SymbolTable *symbol_table, Symbol symbol) {
-    for (size_t i = 0; i < symbol_table->symbols.count; i++) {
-        if (strcmp(symbol_table->symbols.items[i].name.buffer,
-                   symbol.name.buffer) == 0) {
-            errorf(symbol.name.loc, "redifinition of '%s'",
-                   symbol_table->symbols.items[i].name.buffer);
+static inline uint64_t symbol_table_key(SymbolNamespace namespace, Atom atom) {
+    return (uint64_t)namespace << 32 | atom;
+}
+
+// Returns the slot holding the key, or the empty slot where it would go
+static uint32_t symbol_table_probe(const SymbolTable *symbol_table,
+                                   uint64_t key) {
+    size_t mask = symbol_table->slot_count - 1;
+    size_t slot = hash_u64(key) & mask;
+
+    while (symbol_table->slots[slot].key != key &&
+           symbol_table->slots[slot].key != SYMBOL_SLOT_EMPTY) {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+static void symbol_table_grow(SymbolTable *symbol_table) {
+    SymbolSlot *old_slots = symbol_table->slots;
+    size_t old_slot_count = symbol_table->slot_count;
+
+    symbol_table->slot_count = old_slot_count == 0 ? 64 : old_slot_count * 2;
+    symbol_table->slots =
+        malloc(symbol_table->slot_count * sizeof(SymbolSlot));
+
+    if (symbol_table->slots == NULL) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    for (size_t i = 0; i < symbol_table->slot_count; i++) {
+        symbol_table->slots[i].key = SYMBOL_SLOT_EMPTY;
+    }
+
+    // Slot positions change, so the undo log has to follow them
+    uint32_t *moved = malloc((old_slot_count + 1) * sizeof(uint32_t));
+
+    if (moved == NULL) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    for (size_t i = 0; i < old_slot_count; i++) {
+        if (old_slots[i].key != SYMBOL_SLOT_EMPTY) {
+            uint32_t slot = symbol_table_probe(symbol_table, old_slots[i].key);
 
-            exit(1);
+            symbol_table->slots[slot] = old_slots[i];
+            moved[i] = slot;
         }
     }
 
+    for (size_t i = 0; i < symbol_table->undo_log.count; i++) {
+        symbol_table->undo_log.items[i].slot =
+            moved[symbol_table->undo_log.items[i].slot];
+    }
+
+    free(moved);
+    free(old_slots);
+}
+
+void symbol_table_push_scope(SymbolTable *symbol_table) {
+    SymbolScope scope = {
+        .undo_log_start = symbol_table->undo_log.count,
+        .symbols_start = symbol_table->symbols.count,
+    };
+
+    da_append(&symbol_table->scopes, scope);
+}
+
+// Only touches the symbols defined in the scope being left
+void symbol_table_pop_scope(SymbolTable *symbol_table) {
+    SymbolScope scope =
+        symbol_table->scopes.items[--symbol_table->scopes.count];
+
+    while (symbol_table->undo_log.count > scope.undo_log_start) {
+        SymbolUndo undo =
+            symbol_table->undo_log.items[--symbol_table->undo_log.count];
+
+        symbol_table->slots[undo.slot].symbol = undo.previous_symbol;
+    }
+
+    symbol_table->symbols.count = scope.symbols_start;
+}
+
+void symbol_table_set(SymbolTable *symbol_table, Symbol symbol) {
+    if (symbol_table->used_slot_count * 2 >= symbol_table->slot_count) {
+        symbol_table_grow(symbol_table);
+    }
+
+    uint64_t key = symbol_table_key(symbol.namespace, symbol.name.atom);
+    uint32_t slot = symbol_table_probe(symbol_table, key);
+
+    uint32_t depth = symbol_table->scopes.count;
+
+    if (symbol_table->slots[slot].key == SYMBOL_SLOT_EMPTY) {
+        symbol_table->slots[slot] =
+            (SymbolSlot){.key = key, .symbol = SYMBOL_NONE};
+        symbol_table->used_slot_count++;
+    }
+
+    uint32_t previous_symbol = symbol_table->slots[slot].symbol;
+
+    if (previous_symbol != SYMBOL_NONE &&
+        symbol_table->symbols.items[previous_symbol].depth == depth) {
+        errorf(symbol.name.loc, "redifinition of '%s'",
+               interner_text(symbol.name.atom));
+
+        diagnostics_fail();
+    }
+
+    // Symbols of the outermost scope are never removed, so they need no undo
+    if (depth != 0) {
+        SymbolUndo undo = {.slot = slot, .previous_symbol = previous_symbol};
+
+        da_append(&symbol_table->undo_log, undo);
+    }
+
+    symbol.depth = depth;
+
     da_append(&symbol_table->symbols, symbol);
+
+    symbol_table->slots[slot].symbol = symbol_table->symbols.count - 1;
 }
 
-void symbol_table_reset(SymbolTable *symbol_table) {
-    for (size_t i = 0; i < symbol_table->symbols.count; i++) {
-        if (symbol_table->symbols.items[i].linkage != SL_GLOBAL) {
-            symbol_table->symbols.items[i] =
-                symbol_table->symbols.items[--symbol_table->symbols.count];
-        }
+Symbol *symbol_table_find(SymbolTable *symbol_table, SymbolNamespace namespace,
+                          Atom atom) {
+    if (symbol_table->slot_count == 0) {
+        return NULL;
     }
+
+    uint32_t slot =
+        symbol_table_probe(symbol_table, symbol_table_key(namespace, atom));
+
+    if (symbol_table->slots[slot].key == SYMBOL_SLOT_EMPTY ||
+        symbol_table->slots[slot].symbol == SYMBOL_NONE) {
+        return NULL;
+    }
+
+    return &symbol_table->symbols.items[symbol_table->slots[slot].symbol];
 }
 
-Symbol symbol_table_lookup(SymbolTable *symbol_table, Name name) {
-    for (size_t i = 0; i < symbol_table->symbols.count; i++) {
-        if (strcmp(symbol_table->symbols.items[i].name.buffer, name.buffer) ==
-            0) {
-            return symbol_table->symbols.items[i];
-        }
+static Symbol symbol_table_lookup_in(SymbolTable *symbol_table,
+                                     SymbolNamespace namespace, Name name) {
+    Symbol *symbol = symbol_table_find(symbol_table, namespace, name.atom);
+
+    if (symbol == NULL) {
+        errorf(name.loc, "undefined '%s'", interner_text(name.atom));
+
+        diagnostics_fail();
     }
 
-    errorf(name.loc, "undefined '%s'", name.buffer);
+    return *symbol;
+}
+
+Symbol symbol_table_lookup(SymbolTable *symbol_table, Name name) {
+    return symbol_table_lookup_in(symbol_table, SN_ORDINARY, name);
+}
+
+Symbol symbol_table_lookup_tag(SymbolTable *symbol_table, Name name) {
+    return symbol_table_lookup_in(symbol_table, SN_TAG, name);
+}
+
+void symbol_table_free(SymbolTable *symbol_table) {
+    da_free(symbol_table->symbols);
+    da_free(symbol_table->undo_log);
+    da_free(symbol_table->scopes);
+    free(symbol_table->slots);
 
-    exit(1);
+    *symbol_table = (SymbolTable){0};
 }
@@ -1,8 +1,7 @@
 #pragma once
 
-#include <llvm-c/Types.h>
-
 #include <stddef.h>
+#include <stdint.h>
 
 #include "ast.h"
 #include "type.h"
@@ -12,11 +11,22 @@ typedef enum {
     SL_LOCAL,
 } SymbolLinkage;
 
+// Tags (struct, union and enum names) do not clash with ordinary identifiers
+typedef enum {
+    SN_ORDINARY,
+    SN_TAG,
+} SymbolNamespace;
+
 typedef struct {
-    Type type;
+    TypeId type;
     Name name;
     SymbolLinkage linkage;
-    LLVMValueRef llvm_value;
+    SymbolNamespace namespace;
+    SymbolId id;
+    bool defined;
+
+    // Set by the symbol table, the scope depth the symbol was defined in
+    uint32_t depth;
 } Symbol;
 
 typedef struct {
@@ -25,11 +35,56 @@ typedef struct {
     size_t capacity;
 } Symbols;
 
+// Hash table slot, maps a (namespace, atom) key to the index of the innermost
+// visible symbol with that key (or SYMBOL_NONE once it went out of scope)
+typedef struct {
+    uint64_t key;
+    uint32_t symbol;
+} SymbolSlot;
+
+// What a slot held before a symbol shadowed it, replayed in reverse to leave a
+// scope
+typedef struct {
+    uint32_t slot;
+    uint32_t previous_symbol;
+} SymbolUndo;
+
+typedef struct {
+    SymbolUndo *items;
+    size_t count;
+    size_t capacity;
+} SymbolUndoLog;
+
+typedef struct {
+    size_t undo_log_start;
+    size_t symbols_start;
+} SymbolScope;
+
+typedef struct {
+    SymbolScope *items;
+    size_t count;
+    size_t capacity;
+} SymbolScopes;
+
 typedef struct {
     Symbols symbols;
+
+    SymbolSlot *slots;
+    size_t slot_count;
+    size_t used_slot_count;
+
+    SymbolUndoLog undo_log;
+    SymbolScopes scopes;
 } SymbolTable;
 
 SymbolTable symbol_table_new();
+void symbol_table_push_scope(SymbolTable *symbol_table);
+void symbol_table_pop_scope(SymbolTable *symbol_table);
 void symbol_table_set(SymbolTable *symbol_table, Symbol symbol);
-void symbol_table_reset(SymbolTable *symbol_table);
+
+// Returns NULL when no symbol with that name is visible
+Symbol *symbol_table_find(SymbolTable *symbol_table, SymbolNamespace namespace,
+                          Atom atom);
 Symbol symbol_table_lookup(SymbolTable *symbol_table, Name name);
+Symbol symbol_table_lookup_tag(SymbolTable *symbol_table, Name name);
+void symbol_table_free(SymbolTable *symbol_table);
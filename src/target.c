@@ -0,0 +1,176 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <llvm-c/Core.h>
+#include <llvm-c/Target.h>
+#include <llvm-c/TargetMachine.h>
+
+#include "compile_options.h"
+#include "diagnostics.h"
+#include "optimizer.h"
+#include "target.h"
+
+static pthread_once_t target_initialize_once = PTHREAD_ONCE_INIT;
+
+static void target_initialize_all(void) {
+    LLVMInitializeAllTargetInfos();
+    LLVMInitializeAllTargets();
+    LLVMInitializeAllTargetMCs();
+    LLVMInitializeAllAsmParsers();
+    LLVMInitializeAllAsmPrinters();
+}
+
+// Registers the targets with LLVM the first time any thread needs them
+void target_initialize(void) {
+    pthread_once(&target_initialize_once, target_initialize_all);
+}
+
+// Strings of a target are all released with LLVMDisposeMessage
+static char *target_strdup(const char *s) {
+    return LLVMCreateMessage(s);
+}
+
+// -mattr= features are applied after the ones implied by the CPU, so they can
+// turn them off again
+static char *target_join_features(char *features, const char *extra) {
+    if (extra == NULL || extra[0] == '\0') {
+        return features;
+    }
+
+    if (features[0] == '\0') {
+        LLVMDisposeMessage(features);
+
+        return target_strdup(extra);
+    }
+
+    size_t length = strlen(features) + 1 + strlen(extra) + 1;
+    char *joined = malloc(length);
+
+    if (joined == NULL) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    snprintf(joined, length, "%s,%s", features, extra);
+
+    char *result = target_strdup(joined);
+
+    free(joined);
+    LLVMDisposeMessage(features);
+
+    return result;
+}
+
+Target target_select(const CompileOptions *options) {
+    Target target = {0};
+
+    if (options->target_triple != NULL) {
+        target.triple = LLVMNormalizeTargetTriple(options->target_triple);
+    } else {
+        target.triple = LLVMGetDefaultTargetTriple();
+    }
+
+    char *error = NULL;
+
+    if (LLVMGetTargetFromTriple(target.triple, &target.llvm_target, &error)) {
+        fprintf(stderr, "error: unsupported target '%s': %s\n", target.triple,
+                error);
+
+        LLVMDisposeMessage(error);
+        diagnostics_fail();
+    }
+
+    // The host CPU brings its exact feature set, a named CPU implies its own
+    if (options->cpu != NULL && strcmp(options->cpu, "native") == 0) {
+        target.cpu = LLVMGetHostCPUName();
+        target.features = LLVMGetHostCPUFeatures();
+    } else {
+        target.cpu =
+            target_strdup(options->cpu != NULL ? options->cpu : "generic");
+        target.features = target_strdup("");
+    }
+
+    target.features = target_join_features(target.features, options->features);
+
+    return target;
+}
+
+static bool target_has(const char *text, const char *part) {
+    return strstr(text, part) != NULL;
+}
+
+// long is as wide as a pointer except on Windows, long double is what the
+// system compilers of the target make of it
+TypeTargetLayout target_type_layout(const CompileOptions *options) {
+    char *triple = options->target_triple != NULL
+                       ? LLVMNormalizeTargetTriple(options->target_triple)
+                       : LLVMGetDefaultTargetTriple();
+
+    size_t arch_length = strcspn(triple, "-");
+    char arch[32];
+
+    snprintf(arch, sizeof(arch), "%.*s", (int)arch_length, triple);
+
+    const char *system = triple + arch_length;
+
+    bool windows =
+        target_has(system, "-windows") || target_has(system, "-win32");
+    bool msvc = windows && !target_has(system, "-gnu");
+    bool apple =
+        target_has(system, "-apple") || target_has(system, "-darwin") ||
+        target_has(system, "-macos") || target_has(system, "-ios");
+    bool wide = (target_has(arch, "64") || strcmp(arch, "s390x") == 0 ||
+                 strcmp(arch, "sparcv9") == 0) &&
+                !target_has(system, "x32");
+
+    if (strcmp(arch, "avr") == 0 || strcmp(arch, "msp430") == 0) {
+        fprintf(stderr, "error: unsupported target '%s': int is not 32 bits\n",
+                triple);
+        exit(1);
+    }
+
+    TypeTargetLayout layout = {
+        .long_bits = wide && !windows ? 64 : 32,
+        .long_double = TLD_DOUBLE,
+    };
+
+    if (strcmp(arch, "x86_64") == 0 ||
+        (arch[0] == 'i' && strcmp(arch + 2, "86") == 0)) {
+        layout.long_double = msvc ? TLD_DOUBLE : TLD_X86_FP80;
+    } else if (strncmp(arch, "aarch64", 7) == 0 ||
+               strncmp(arch, "arm64", 5) == 0) {
+        layout.long_double = apple || windows ? TLD_DOUBLE : TLD_FP128;
+    } else if (strncmp(arch, "powerpc", 7) == 0 ||
+               strncmp(arch, "ppc", 3) == 0) {
+        layout.long_double = TLD_PPC_FP128;
+    } else if (strncmp(arch, "riscv", 5) == 0 ||
+               strncmp(arch, "wasm", 4) == 0 || strcmp(arch, "s390x") == 0 ||
+               strcmp(arch, "loongarch64") == 0 ||
+               strncmp(arch, "mips64", 6) == 0 ||
+               strcmp(arch, "sparcv9") == 0) {
+        layout.long_double = TLD_FP128;
+    }
+
+    LLVMDisposeMessage(triple);
+
+    return layout;
+}
+
+LLVMTargetMachineRef target_create_machine(const Target *target,
+                                           const CompileOptions *options) {
+    return LLVMCreateTargetMachine(
+        target->llvm_target, target->triple, target->cpu, target->features,
+        optimizer_codegen_level(options->optimization_level), LLVMRelocDefault,
+        LLVMCodeModelDefault);
+}
+
+void target_free(Target *target) {
+    LLVMDisposeMessage(target->triple);
+    LLVMDisposeMessage(target->cpu);
+    LLVMDisposeMessage(target->features);
+
+    *target = (Target){0};
+}
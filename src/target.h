@@ -0,0 +1,26 @@
+#pragma once
+
+#include <llvm-c/TargetMachine.h>
+
+#include "compile_options.h"
+#include "type.h"
+
+// The target code is generated for, resolved from --target=, -march=, -mcpu=
+// and -mattr=
+typedef struct {
+    LLVMTargetRef llvm_target;
+
+    char *triple;
+    char *cpu;
+    char *features; // Comma separated '+feature' and '-feature' list
+} Target;
+
+void target_initialize(void);
+Target target_select(const CompileOptions *options);
+
+// The layout of the C types of the target the options select, from the
+// triple alone so the targets need not be initialized
+TypeTargetLayout target_type_layout(const CompileOptions *options);
+LLVMTargetMachineRef target_create_machine(const Target *target,
+                                           const CompileOptions *options);
+void target_free(Target *target);
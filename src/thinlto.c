@@ -0,0 +1,649 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <llvm-c/BitReader.h>
+#include <llvm-c/Core.h>
+#include <llvm-c/Linker.h>
+
+#include "arena.h"
+#include "cache.h"
+#include "diagnostics.h"
+#include "dynamic_array.h"
+#include "hash.h"
+#include "interner.h"
+#include "jobs.h"
+#include "thinlto.h"
+
+#define THINLTO_SUMMARY_NAME "ycc.summary"
+
+// Functions of up to this many instructions are imported, the limit shrinks
+// to 7/10 for each call level below the function that imports them, as in
+// LLVM's own ThinLTO
+#define THINLTO_IMPORT_LIMIT 100
+
+#define THINLTO_NO_MODULE UINT32_MAX
+
+typedef struct {
+    LLVMValueRef *items;
+    size_t count;
+    size_t capacity;
+} ThinLTOValues;
+
+typedef struct {
+    uint32_t module;
+    uint32_t entry;
+} ThinLTODefinition;
+
+static bool thinlto_is_intrinsic(const char *name) {
+    return strncmp(name, "llvm.", 5) == 0;
+}
+
+static const char *thinlto_name(LLVMValueRef value) {
+    size_t length;
+
+    return LLVMGetValueName2(value, &length);
+}
+
+static bool thinlto_is_local(LLVMValueRef value) {
+    LLVMLinkage linkage = LLVMGetLinkage(value);
+
+    return linkage == LLVMInternalLinkage || linkage == LLVMPrivateLinkage;
+}
+
+// Globals are referenced directly or from inside constant expressions
+static void thinlto_add_reference(LLVMValueRef value,
+                                  ThinLTOValues *references) {
+    if (LLVMIsAGlobalValue(value)) {
+        for (size_t i = 0; i < references->count; i++) {
+            if (references->items[i] == value) {
+                return;
+            }
+        }
+
+        da_append(references, value);
+    } else if (LLVMIsAConstant(value)) {
+        int operand_count = LLVMGetNumOperands(value);
+
+        for (int i = 0; i < operand_count; i++) {
+            thinlto_add_reference(LLVMGetOperand(value, i), references);
+        }
+    }
+}
+
+static size_t thinlto_collect_function(LLVMValueRef function,
+                                       ThinLTOValues *references) {
+    size_t instruction_count = 0;
+
+    for (LLVMBasicBlockRef block = LLVMGetFirstBasicBlock(function);
+         block != NULL; block = LLVMGetNextBasicBlock(block)) {
+        for (LLVMValueRef instruction = LLVMGetFirstInstruction(block);
+             instruction != NULL;
+             instruction = LLVMGetNextInstruction(instruction)) {
+            int operand_count = LLVMGetNumOperands(instruction);
+
+            for (int i = 0; i < operand_count; i++) {
+                LLVMValueRef operand = LLVMGetOperand(instruction, i);
+
+                if (operand != NULL) {
+                    thinlto_add_reference(operand, references);
+                }
+            }
+
+            instruction_count++;
+        }
+    }
+
+    return instruction_count;
+}
+
+// Each definition is a node of its name, flags, instruction count and the
+// names it references
+static void thinlto_write_entry(LLVMModuleRef module, LLVMValueRef value,
+                                bool function) {
+    size_t name_length;
+    const char *name = LLVMGetValueName2(value, &name_length);
+
+    if (LLVMIsDeclaration(value) || thinlto_is_intrinsic(name)) {
+        return;
+    }
+
+    ThinLTOValues references = {0};
+    size_t instruction_count = 0;
+
+    if (function) {
+        instruction_count = thinlto_collect_function(value, &references);
+    } else {
+        thinlto_add_reference(LLVMGetInitializer(value), &references);
+    }
+
+    unsigned flags = function ? THINLTO_FUNCTION : 0;
+
+    if (thinlto_is_local(value)) {
+        flags |= THINLTO_LOCAL;
+    }
+
+    LLVMContextRef llvm_context = LLVMGetModuleContext(module);
+
+    LLVMMetadataRef *operands =
+        malloc((3 + references.count) * sizeof(LLVMMetadataRef));
+
+    if (operands == NULL) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    size_t operand_count = 3;
+
+    for (size_t i = 0; i < references.count; i++) {
+        size_t reference_length;
+        const char *reference =
+            LLVMGetValueName2(references.items[i], &reference_length);
+
+        if (thinlto_is_intrinsic(reference)) {
+            continue;
+        }
+
+        if (thinlto_is_local(references.items[i])) {
+            flags |= THINLTO_REFERENCES_LOCAL;
+        }
+
+        operands[operand_count++] =
+            LLVMMDStringInContext2(llvm_context, reference, reference_length);
+    }
+
+    operands[0] = LLVMMDStringInContext2(llvm_context, name, name_length);
+    operands[1] = LLVMValueAsMetadata(
+        LLVMConstInt(LLVMInt32TypeInContext(llvm_context), flags, false));
+    operands[2] = LLVMValueAsMetadata(LLVMConstInt(
+        LLVMInt64TypeInContext(llvm_context), instruction_count, false));
+
+    LLVMAddNamedMetadataOperand(
+        module, THINLTO_SUMMARY_NAME,
+        LLVMMetadataAsValue(llvm_context,
+                            LLVMMDNodeInContext2(llvm_context, operands,
+                                                 operand_count)));
+
+    free(operands);
+    da_free(references);
+}
+
+void thinlto_write_summary(LLVMModuleRef module) {
+    for (LLVMValueRef function = LLVMGetFirstFunction(module);
+         function != NULL; function = LLVMGetNextFunction(function)) {
+        thinlto_write_entry(module, function, true);
+    }
+
+    for (LLVMValueRef global = LLVMGetFirstGlobal(module); global != NULL;
+         global = LLVMGetNextGlobal(global)) {
+        thinlto_write_entry(module, global, false);
+    }
+}
+
+static LLVMModuleRef thinlto_parse(LLVMContextRef llvm_context,
+                                   LLVMMemoryBufferRef bitcode) {
+    LLVMModuleRef module;
+
+    // Errors are reported through the diagnostic handler of the context
+    if (LLVMParseBitcodeInContext2(llvm_context, bitcode, &module)) {
+        fprintf(stderr, "error: cannot read bitcode\n");
+        diagnostics_fail();
+    }
+
+    return module;
+}
+
+// Takes the buffer
+static LLVMModuleRef thinlto_parse_lazily(LLVMContextRef llvm_context,
+                                          LLVMMemoryBufferRef bitcode) {
+    LLVMModuleRef module;
+
+    if (LLVMGetBitcodeModuleInContext2(llvm_context, bitcode, &module)) {
+        fprintf(stderr, "error: cannot read bitcode\n");
+        diagnostics_fail();
+    }
+
+    return module;
+}
+
+static Atom thinlto_intern_string(LLVMValueRef string) {
+    unsigned length;
+    const char *text = LLVMGetMDString(string, &length);
+
+    return interner_intern(text, length);
+}
+
+static ThinLTOSummaryEntry thinlto_read_entry(Arena *arena,
+                                              LLVMValueRef node) {
+    unsigned operand_count = LLVMGetMDNodeNumOperands(node);
+
+    if (operand_count < 3) {
+        fprintf(stderr, "error: invalid ThinLTO summary\n");
+        diagnostics_fail();
+    }
+
+    LLVMValueRef *operands = malloc(operand_count * sizeof(LLVMValueRef));
+
+    if (operands == NULL) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    LLVMGetMDNodeOperands(node, operands);
+
+    ThinLTOSummaryEntry entry = {
+        .name = thinlto_intern_string(operands[0]),
+        .flags = LLVMConstIntGetZExtValue(operands[1]),
+        .instruction_count = LLVMConstIntGetZExtValue(operands[2]),
+        .references = arena_alloc(arena, (operand_count - 3) * sizeof(Atom)),
+        .reference_count = operand_count - 3,
+    };
+
+    for (size_t i = 0; i < entry.reference_count; i++) {
+        entry.references[i] = thinlto_intern_string(operands[3 + i]);
+    }
+
+    free(operands);
+
+    return entry;
+}
+
+// Only the summary is needed, so the module is loaded lazily and its function
+// bodies are never parsed
+static void thinlto_read_summary(void *context, size_t index) {
+    ThinLTOModule *module = &((ThinLTOIndex *)context)->modules[index];
+
+    const char *start = LLVMGetBufferStart(module->bitcode);
+    size_t size = LLVMGetBufferSize(module->bitcode);
+
+    module->hash = hash_bytes(start, size, 0);
+    module->arena = arena_new(false);
+
+    LLVMContextRef llvm_context = LLVMContextCreate();
+
+    // The lazy module takes the buffer, so it gets one of its own
+    LLVMModuleRef llvm_module = thinlto_parse_lazily(
+        llvm_context,
+        LLVMCreateMemoryBufferWithMemoryRange(start, size, "bitcode", false));
+
+    unsigned node_count =
+        LLVMGetNamedMetadataNumOperands(llvm_module, THINLTO_SUMMARY_NAME);
+
+    LLVMValueRef *nodes = malloc(node_count * sizeof(LLVMValueRef));
+
+    if (nodes == NULL && node_count != 0) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    LLVMGetNamedMetadataOperands(llvm_module, THINLTO_SUMMARY_NAME, nodes);
+
+    for (unsigned i = 0; i < node_count; i++) {
+        arena_da_append(&module->arena, &module->summary,
+                        thinlto_read_entry(&module->arena, nodes[i]));
+    }
+
+    free(nodes);
+
+    LLVMDisposeModule(llvm_module);
+    LLVMContextDispose(llvm_context);
+}
+
+static bool thinlto_is_imported(const ThinLTOImport *imports,
+                                size_t import_count, Atom name) {
+    for (size_t i = 0; i < import_count; i++) {
+        if (imports[i].name == name) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void thinlto_import(ThinLTOIndex *index,
+                           const ThinLTODefinition *definitions, size_t module,
+                           Atom name, size_t limit) {
+    if (name >= index->atom_count) {
+        return;
+    }
+
+    ThinLTODefinition definition = definitions[name];
+
+    if (definition.module == THINLTO_NO_MODULE || definition.module == module) {
+        return;
+    }
+
+    ThinLTOSummaryEntry *entry =
+        &index->modules[definition.module].summary.items[definition.entry];
+
+    if (!(entry->flags & THINLTO_FUNCTION) ||
+        (entry->flags & THINLTO_REFERENCES_LOCAL) ||
+        entry->instruction_count > limit) {
+        return;
+    }
+
+    ThinLTOImports *imports = &index->modules[module].imports;
+
+    if (thinlto_is_imported(imports->items, imports->count, name)) {
+        return;
+    }
+
+    da_append(imports, ((ThinLTOImport){.module = definition.module,
+                                        .name = name}));
+
+    for (size_t i = 0; i < entry->reference_count; i++) {
+        thinlto_import(index, definitions, module, entry->references[i],
+                       limit * 7 / 10);
+    }
+}
+
+static int thinlto_compare_imports(const void *a, const void *b) {
+    const ThinLTOImport *first = a;
+    const ThinLTOImport *second = b;
+
+    if (first->module != second->module) {
+        return first->module < second->module ? -1 : 1;
+    }
+
+    // Atoms depend on the order the threads interned the names in, the
+    // backend keys must not
+    return strcmp(interner_text(first->name), interner_text(second->name));
+}
+
+// A definition stays visible when another module refers to it, directly or
+// through a function it imports
+static void thinlto_export(ThinLTOIndex *index,
+                           const ThinLTODefinition *definitions,
+                           size_t module, Atom name) {
+    if (name >= index->atom_count) {
+        return;
+    }
+
+    if (definitions[name].module != THINLTO_NO_MODULE &&
+        definitions[name].module != module) {
+        index->exported[name] = true;
+    }
+}
+
+ThinLTOIndex thinlto_index(LLVMMemoryBufferRef *bitcode, size_t module_count,
+                           unsigned thread_count) {
+    ThinLTOIndex index = {
+        .modules = calloc(module_count, sizeof(ThinLTOModule)),
+        .module_count = module_count,
+    };
+
+    if (index.modules == NULL) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    for (size_t i = 0; i < module_count; i++) {
+        index.modules[i].bitcode = bitcode[i];
+    }
+
+    if (!jobs_run(module_count, thread_count, thinlto_read_summary, &index)) {
+        diagnostics_fail();
+    }
+
+    Atom main_atom = interner_intern("main", 4);
+
+    index.atom_count = main_atom + 1;
+
+    for (size_t i = 0; i < module_count; i++) {
+        ThinLTOSummary *summary = &index.modules[i].summary;
+
+        for (size_t j = 0; j < summary->count; j++) {
+            ThinLTOSummaryEntry *entry = &summary->items[j];
+
+            if (entry->name >= index.atom_count) {
+                index.atom_count = entry->name + 1;
+            }
+
+            for (size_t k = 0; k < entry->reference_count; k++) {
+                if (entry->references[k] >= index.atom_count) {
+                    index.atom_count = entry->references[k] + 1;
+                }
+            }
+        }
+    }
+
+    ThinLTODefinition *definitions =
+        malloc(index.atom_count * sizeof(ThinLTODefinition));
+    index.exported = calloc(index.atom_count, sizeof(bool));
+
+    if (definitions == NULL || index.exported == NULL) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    for (Atom atom = 0; atom < index.atom_count; atom++) {
+        definitions[atom].module = THINLTO_NO_MODULE;
+    }
+
+    // Local definitions of different modules may share a name, so only the
+    // others can be found by name
+    for (size_t i = 0; i < module_count; i++) {
+        ThinLTOSummary *summary = &index.modules[i].summary;
+
+        for (size_t j = 0; j < summary->count; j++) {
+            Atom name = summary->items[j].name;
+
+            if (!(summary->items[j].flags & THINLTO_LOCAL) &&
+                definitions[name].module == THINLTO_NO_MODULE) {
+                definitions[name] = (ThinLTODefinition){i, j};
+            }
+        }
+    }
+
+    index.exported[main_atom] = true;
+
+    for (size_t i = 0; i < module_count; i++) {
+        ThinLTOSummary *summary = &index.modules[i].summary;
+
+        for (size_t j = 0; j < summary->count; j++) {
+            ThinLTOSummaryEntry *entry = &summary->items[j];
+
+            for (size_t k = 0; k < entry->reference_count; k++) {
+                thinlto_import(&index, definitions, i, entry->references[k],
+                               THINLTO_IMPORT_LIMIT);
+                thinlto_export(&index, definitions, i, entry->references[k]);
+            }
+        }
+
+        ThinLTOImports *imports = &index.modules[i].imports;
+
+        // An imported function may stay a call when it is not inlined, and
+        // it now refers to its own references from this module
+        for (size_t j = 0; j < imports->count; j++) {
+            ThinLTODefinition definition = definitions[imports->items[j].name];
+            ThinLTOSummaryEntry *entry =
+                &index.modules[definition.module]
+                     .summary.items[definition.entry];
+
+            index.exported[entry->name] = true;
+
+            for (size_t k = 0; k < entry->reference_count; k++) {
+                thinlto_export(&index, definitions, i, entry->references[k]);
+            }
+        }
+
+        qsort(imports->items, imports->count, sizeof(ThinLTOImport),
+              thinlto_compare_imports);
+    }
+
+    free(definitions);
+
+    return index;
+}
+
+static Atom thinlto_value_atom(LLVMValueRef value) {
+    size_t length;
+    const char *name = LLVMGetValueName2(value, &length);
+
+    return interner_intern(name, length);
+}
+
+static void thinlto_internalize(const ThinLTOIndex *index, LLVMValueRef value) {
+    if (LLVMIsDeclaration(value) || thinlto_is_local(value) ||
+        thinlto_is_intrinsic(thinlto_name(value))) {
+        return;
+    }
+
+    Atom atom = thinlto_value_atom(value);
+
+    // Definitions missing from the summaries are left alone
+    if (atom >= index->atom_count || index->exported[atom]) {
+        return;
+    }
+
+    LLVMSetLinkage(value, LLVMInternalLinkage);
+    LLVMSetVisibility(value, LLVMDefaultVisibility);
+}
+
+// The C API cannot delete the body of a function, so its uses move to a new
+// declaration which takes its name. Bodies of the lazily loaded source module
+// that are parsed later refer to the declaration, as the bitcode reader
+// tracks its values through replacements
+static void thinlto_declare(LLVMModuleRef module, LLVMValueRef function) {
+    Atom name = thinlto_value_atom(function);
+
+    LLVMValueRef declaration =
+        LLVMAddFunction(module, "", LLVMGlobalGetValueType(function));
+
+    LLVMReplaceAllUsesWith(function, declaration);
+    LLVMDeleteFunction(function);
+
+    LLVMSetValueName2(declaration, interner_text(name), interner_length(name));
+}
+
+// Leaves the imported functions of the source module as available_externally
+// definitions, which may be inlined but are never emitted, and everything else
+// as external declarations. Imported functions never refer to local
+// definitions, so the declarations made of those stay unused
+
+static void thinlto_strip(LLVMModuleRef source, const ThinLTOImport *imports,
+                          size_t import_count) {
+    LLVMValueRef function = LLVMGetFirstFunction(source);
+
+    while (function != NULL) {
+        LLVMValueRef next = LLVMGetNextFunction(function);
+
+        if (LLVMIsDeclaration(function)) {
+            // Already a declaration
+        } else if (thinlto_is_imported(imports, import_count,
+                                       thinlto_value_atom(function))) {
+            LLVMSetLinkage(function, LLVMAvailableExternallyLinkage);
+        } else {
+            thinlto_declare(source, function);
+        }
+
+        function = next;
+    }
+
+    for (LLVMValueRef global = LLVMGetFirstGlobal(source); global != NULL;
+         global = LLVMGetNextGlobal(global)) {
+        if (!LLVMIsDeclaration(global) &&
+            !thinlto_is_intrinsic(thinlto_name(global))) {
+            LLVMSetInitializer(global, NULL);
+            LLVMSetLinkage(global, LLVMExternalLinkage);
+        }
+    }
+}
+
+LLVMModuleRef thinlto_load(const ThinLTOIndex *index, size_t module,
+                           LLVMContextRef llvm_context) {
+    const ThinLTOModule *thin_module = &index->modules[module];
+
+    LLVMModuleRef llvm_module =
+        thinlto_parse(llvm_context, thin_module->bitcode);
+
+    for (LLVMValueRef function = LLVMGetFirstFunction(llvm_module);
+         function != NULL; function = LLVMGetNextFunction(function)) {
+        thinlto_internalize(index, function);
+    }
+
+    for (LLVMValueRef global = LLVMGetFirstGlobal(llvm_module); global != NULL;
+         global = LLVMGetNextGlobal(global)) {
+        thinlto_internalize(index, global);
+    }
+
+    const ThinLTOImports *imports = &thin_module->imports;
+
+    for (size_t first = 0; first < imports->count;) {
+        size_t source = imports->items[first].module;
+        size_t last = first;
+
+        while (last < imports->count && imports->items[last].module == source) {
+            last++;
+        }
+
+        // Only the bodies of the imported functions are ever parsed, when
+        // the linker moves them
+        const char *start = LLVMGetBufferStart(index->modules[source].bitcode);
+        size_t size = LLVMGetBufferSize(index->modules[source].bitcode);
+
+        LLVMModuleRef source_module = thinlto_parse_lazily(
+            llvm_context,
+            LLVMCreateMemoryBufferWithMemoryRange(start, size, "bitcode",
+                                                  false));
+
+        thinlto_strip(source_module, &imports->items[first], last - first);
+
+        if (LLVMLinkModules2(llvm_module, source_module)) {
+            diagnostics_fail();
+        }
+
+        first = last;
+    }
+
+    return llvm_module;
+}
+
+static void thinlto_key_update(CacheKey *key, const void *data,
+                               size_t length) {
+    key->high = hash_bytes(data, length, key->high);
+    key->low = hash_bytes(data, length, key->low);
+}
+
+// The object depends on the bitcode of the module, the functions it imports
+// and which of its definitions are internalized
+CacheKey thinlto_backend_key(const ThinLTOIndex *index, size_t module,
+                             CacheKey options_key) {
+    const ThinLTOModule *thin_module = &index->modules[module];
+
+    CacheKey key = options_key;
+
+    thinlto_key_update(&key, &thin_module->hash, sizeof(thin_module->hash));
+
+    for (size_t i = 0; i < thin_module->imports.count; i++) {
+        ThinLTOImport import = thin_module->imports.items[i];
+
+        thinlto_key_update(&key, &index->modules[import.module].hash,
+                           sizeof(uint64_t));
+        thinlto_key_update(&key, interner_text(import.name),
+                           interner_length(import.name) + 1);
+    }
+
+    for (size_t i = 0; i < thin_module->summary.count; i++) {
+        Atom name = thin_module->summary.items[i].name;
+        bool exported = index->exported[name];
+
+        thinlto_key_update(&key, interner_text(name), interner_length(name));
+        thinlto_key_update(&key, &exported, sizeof(exported));
+    }
+
+    return key;
+}
+
+void thinlto_free(ThinLTOIndex *index) {
+    for (size_t i = 0; i < index->module_count; i++) {
+        arena_free(&index->modules[i].arena);
+        da_free(index->modules[i].imports);
+    }
+
+    free(index->modules);
+    free(index->exported);
+}
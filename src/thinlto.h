@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <llvm-c/Types.h>
+
+#include "arena.h"
+#include "cache.h"
+#include "interner.h"
+
+// Bitcode compiled with -flto=thin carries a summary of its definitions, the
+// link decides from the summaries alone which functions each module imports
+// from the others, then every module is optimized and emitted on its own
+
+#define THINLTO_FUNCTION 1
+#define THINLTO_LOCAL 2
+#define THINLTO_REFERENCES_LOCAL 4 // Cannot be imported into another module
+
+typedef struct {
+    Atom name;
+    unsigned flags;
+    size_t instruction_count;
+
+    Atom *references;
+    size_t reference_count;
+} ThinLTOSummaryEntry;
+
+typedef struct {
+    ThinLTOSummaryEntry *items;
+    size_t count;
+    size_t capacity;
+} ThinLTOSummary;
+
+typedef struct {
+    size_t module;
+    Atom name;
+} ThinLTOImport;
+
+typedef struct {
+    ThinLTOImport *items;
+    size_t count;
+    size_t capacity;
+} ThinLTOImports;
+
+typedef struct {
+    LLVMMemoryBufferRef bitcode; // Owned by the caller of thinlto_index
+    uint64_t hash;
+
+    Arena arena;
+    ThinLTOSummary summary;
+
+    ThinLTOImports imports; // Sorted by module
+} ThinLTOModule;
+
+typedef struct {
+    ThinLTOModule *modules;
+    size_t module_count;
+
+    // Indexed by atom, definitions that are not exported are internalized
+    bool *exported;
+    Atom atom_count;
+} ThinLTOIndex;
+
+void thinlto_write_summary(LLVMModuleRef module);
+
+// Reads the summaries on up to thread_count threads, the bitcode must outlive
+// the index
+ThinLTOIndex thinlto_index(LLVMMemoryBufferRef *bitcode, size_t module_count,
+                           unsigned thread_count);
+
+// Parses the module into the context with its imports linked in and its
+// definitions no other module refers to internalized
+LLVMModuleRef thinlto_load(const ThinLTOIndex *index, size_t module,
+                           LLVMContextRef llvm_context);
+
+// Identifies the result of thinlto_load for a backend cache
+CacheKey thinlto_backend_key(const ThinLTOIndex *index, size_t module,
+                             CacheKey options_key);
+
+void thinlto_free(ThinLTOIndex *index);
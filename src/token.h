@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
 
 typedef enum {
     TOK_EOF,
@@ -15,6 +16,7 @@ typedef enum {
     TOK_MINUS,
     TOK_STAR,
     TOK_FORWARD_SLASH,
+    TOK_PERCENT,
     TOK_BANG,
     TOK_ASSIGN,
 
@@ -33,15 +35,23 @@ typedef enum {
     TOK_KEYWORD_LONG,
     TOK_KEYWORD_FLOAT,
     TOK_KEYWORD_DOUBLE,
+    TOK_KEYWORD_SIGNED,
+    TOK_KEYWORD_UNSIGNED,
     TOK_KEYWORD_RETURN,
 } TokenKind;
 
-typedef struct {
-    size_t start;
-    size_t end;
-} BufferLoc;
+#define TOKEN_MAX_LENGTH UINT16_MAX
 
+// Tokens refer back to the buffer they were lexed from by byte offset, a
+// token longer than TOKEN_MAX_LENGTH is lexed as TOK_INVALID
 typedef struct {
-    TokenKind kind;
-    BufferLoc loc;
+    uint32_t start;
+    uint16_t length;
+    uint8_t kind;
 } Token;
+
+typedef struct {
+    Token *items;
+    size_t count;
+    size_t capacity;
+} Tokens;
@@ -0,0 +1,200 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "hash.h"
+#include "type.h"
+
+#define TYPE_CHUNK_BITS 12
+#define TYPE_CHUNK_SIZE (1 << TYPE_CHUNK_BITS)
+#define TYPE_MAX_CHUNKS (1 << (32 - TYPE_CHUNK_BITS))
+
+typedef struct {
+    Type type;
+    uint32_t hash;
+} TypeEntry;
+
+// Laid out like the interner: derived types live in fixed size chunks which
+// are never moved, and the slots of the hash table hold index + 1 so that zero
+// marks an empty slot, it is shared by the threads compiling translation
+// units, so interning takes the lock
+typedef struct {
+    pthread_mutex_t lock;
+    Arena storage;
+
+    TypeEntry *chunks[TYPE_MAX_CHUNKS];
+    uint32_t count;
+
+    uint32_t *slots;
+    uint32_t slot_mask;
+} TypePool;
+
+static TypePool type_pool = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+TypeTargetLayout type_target_layout = {.long_bits = 64,
+                                       .long_double = TLD_X86_FP80};
+
+#define TYPE_PRIMITIVE(k) [k] = {.kind = k}
+
+static const Type type_primitives[TYPE_FIRST_DERIVED] = {
+    TYPE_PRIMITIVE(TY_VOID),
+    TYPE_PRIMITIVE(TY_CHAR),
+    TYPE_PRIMITIVE(TY_UNSIGNED_CHAR),
+    TYPE_PRIMITIVE(TY_SHORT),
+    TYPE_PRIMITIVE(TY_UNSIGNED_SHORT),
+    TYPE_PRIMITIVE(TY_INT),
+    TYPE_PRIMITIVE(TY_UNSIGNED_INT),
+    TYPE_PRIMITIVE(TY_LONG),
+    TYPE_PRIMITIVE(TY_UNSIGNED_LONG),
+    TYPE_PRIMITIVE(TY_LONG_LONG),
+    TYPE_PRIMITIVE(TY_UNSIGNED_LONG_LONG),
+    TYPE_PRIMITIVE(TY_FLOAT),
+    TYPE_PRIMITIVE(TY_DOUBLE),
+    TYPE_PRIMITIVE(TY_LONG_DOUBLE),
+};
+
+static TypeEntry *type_entry(uint32_t index) {
+    return &type_pool.chunks[index >> TYPE_CHUNK_BITS]
+                            [index & (TYPE_CHUNK_SIZE - 1)];
+}
+
+static uint32_t type_hash(const Type *type) {
+    const FunctionPrototype *prototype = &type->prototype;
+
+    uint64_t hash = hash_u64((uint64_t)type->kind << 33 |
+                             (uint64_t)prototype->variadic << 32 |
+                             prototype->return_type);
+
+    return hash_bytes(prototype->parameters,
+                      prototype->parameter_count * sizeof(TypeId), hash);
+}
+
+static bool type_equals(const Type *a, const Type *b) {
+    return a->kind == b->kind &&
+           a->prototype.return_type == b->prototype.return_type &&
+           a->prototype.variadic == b->prototype.variadic &&
+           a->prototype.parameter_count == b->prototype.parameter_count &&
+           memcmp(a->prototype.parameters, b->prototype.parameters,
+                  a->prototype.parameter_count * sizeof(TypeId)) == 0;
+}
+
+static void type_insert_slot(uint32_t index, uint32_t hash) {
+    uint32_t slot = hash & type_pool.slot_mask;
+
+    while (type_pool.slots[slot] != 0) {
+        slot = (slot + 1) & type_pool.slot_mask;
+    }
+
+    type_pool.slots[slot] = index + 1;
+}
+
+static void type_grow_slots(void) {
+    uint32_t slot_count =
+        type_pool.slots == NULL ? 256 : (type_pool.slot_mask + 1) * 2;
+
+    free(type_pool.slots);
+
+    type_pool.slots = calloc(slot_count, sizeof(uint32_t));
+    type_pool.slot_mask = slot_count - 1;
+
+    if (type_pool.slots == NULL) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    for (uint32_t index = 0; index < type_pool.count; index++) {
+        type_insert_slot(index, type_entry(index)->hash);
+    }
+}
+
+static TypeId type_intern(const Type *type) {
+    uint32_t hash = type_hash(type);
+
+    if (type_pool.slots != NULL) {
+        for (uint32_t slot = hash & type_pool.slot_mask;
+             type_pool.slots[slot] != 0;
+             slot = (slot + 1) & type_pool.slot_mask) {
+            uint32_t index = type_pool.slots[slot] - 1;
+            TypeEntry *entry = type_entry(index);
+
+            if (entry->hash == hash && type_equals(&entry->type, type)) {
+                return TYPE_FIRST_DERIVED + index;
+            }
+        }
+    }
+
+    if (type_pool.count % TYPE_CHUNK_SIZE == 0) {
+        if (type_pool.count / TYPE_CHUNK_SIZE == TYPE_MAX_CHUNKS - 1) {
+            printf("too many types\n");
+            exit(1);
+        }
+
+        type_pool.chunks[type_pool.count / TYPE_CHUNK_SIZE] = arena_alloc(
+            &type_pool.storage, TYPE_CHUNK_SIZE * sizeof(TypeEntry));
+    }
+
+    uint32_t index = type_pool.count;
+
+    TypeEntry *entry = type_entry(index);
+
+    *entry = (TypeEntry){.type = *type, .hash = hash};
+
+    // The caller's parameters may be temporary, the pool keeps its own copy
+    if (type->prototype.parameter_count != 0) {
+        entry->type.prototype.parameters = arena_memdup(
+            &type_pool.storage, type->prototype.parameters,
+            type->prototype.parameter_count * sizeof(TypeId));
+    }
+
+    type_pool.count++;
+
+    if (type_pool.slots == NULL || type_pool.count * 2 > type_pool.slot_mask) {
+        type_grow_slots();
+    } else {
+        type_insert_slot(index, hash);
+    }
+
+    return TYPE_FIRST_DERIVED + index;
+}
+
+TypeId type_function(TypeId return_type, const TypeId *parameters,
+                     size_t parameter_count, bool variadic) {
+    Type type = {
+        .kind = TY_FUNCTION,
+        .prototype = {.return_type = return_type,
+                      .parameters = parameters,
+                      .parameter_count = parameter_count,
+                      .variadic = variadic},
+    };
+
+    pthread_mutex_lock(&type_pool.lock);
+
+    TypeId id = type_intern(&type);
+
+    pthread_mutex_unlock(&type_pool.lock);
+
+    return id;
+}
+
+const Type *type_get(TypeId type) {
+    if (type < TYPE_FIRST_DERIVED) {
+        return &type_primitives[type];
+    }
+
+    return &type_entry(type - TYPE_FIRST_DERIVED)->type;
+}
+
+size_t type_count(void) {
+    pthread_mutex_lock(&type_pool.lock);
+
+    size_t count = TYPE_FIRST_DERIVED + type_pool.count;
+
+    pthread_mutex_unlock(&type_pool.lock);
+
+    return count;
+}
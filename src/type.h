@@ -2,39 +2,125 @@
 
 #include <stdbool.h>
 #include <stddef.h>
-
-typedef struct Type Type;
-
-typedef struct {
-    Type *items;
-    size_t count;
-    size_t capacity;
-} Types;
-
-typedef struct {
-    Type *return_type;
-    Types parameters;
-    bool variadic;
-} FunctionPrototype;
-
-typedef union {
-    FunctionPrototype prototype;
-} TypeData;
+#include <stdint.h>
 
 typedef enum {
     TY_VOID,
+
+    // Each signed integer type is directly followed by its unsigned
+    // counterpart
     TY_CHAR,
+    TY_UNSIGNED_CHAR,
     TY_SHORT,
+    TY_UNSIGNED_SHORT,
     TY_INT,
+    TY_UNSIGNED_INT,
     TY_LONG,
+    TY_UNSIGNED_LONG,
     TY_LONG_LONG,
+    TY_UNSIGNED_LONG_LONG,
+
     TY_FLOAT,
     TY_DOUBLE,
     TY_LONG_DOUBLE,
     TY_FUNCTION,
 } TypeKind;
 
-struct Type {
+// How the target stores long double
+typedef enum {
+    TLD_DOUBLE,
+    TLD_X86_FP80,
+    TLD_FP128,
+    TLD_PPC_FP128, // A pair of doubles
+} TypeLongDouble;
+
+// The parts of the C ABI that differ between the supported targets, the same
+// for every unit of a process, so it is set before anything is compiled
+typedef struct {
+    unsigned long_bits;
+    TypeLongDouble long_double;
+} TypeTargetLayout;
+
+extern TypeTargetLayout type_target_layout;
+
+// Identifier of a canonical type, structurally equal types always get the same
+// id, so types are compared with == and can index side tables, the id of a
+// primitive type is its kind
+typedef uint32_t TypeId;
+
+// The first id given to a type which is not primitive
+#define TYPE_FIRST_DERIVED TY_FUNCTION
+
+typedef struct {
+    TypeId return_type;
+    const TypeId *parameters;
+    uint32_t parameter_count;
+    bool variadic;
+} FunctionPrototype;
+
+typedef struct {
     TypeKind kind;
-    TypeData data;
-};
+    FunctionPrototype prototype;
+} Type;
+
+TypeId type_function(TypeId return_type, const TypeId *parameters,
+                     size_t parameter_count, bool variadic);
+
+// Types stay valid and never move for the rest of the process
+const Type *type_get(TypeId type);
+
+// One more than the largest id given so far
+size_t type_count(void);
+
+static inline TypeKind type_kind(TypeId type) {
+    return type < TYPE_FIRST_DERIVED ? (TypeKind)type : type_get(type)->kind;
+}
+
+static inline bool type_is_integer(TypeId type) {
+    return type >= TY_CHAR && type <= TY_UNSIGNED_LONG_LONG;
+}
+
+static inline bool type_is_unsigned(TypeId type) {
+    return type_is_integer(type) && (type - TY_CHAR) % 2 == 1;
+}
+
+static inline TypeId type_to_unsigned(TypeId type) {
+    return type_is_unsigned(type) ? type : type + 1;
+}
+
+static inline TypeId type_to_signed(TypeId type) {
+    return type_is_unsigned(type) ? type - 1 : type;
+}
+
+// Conversion rank of an integer type, equal for both signednesses
+static inline unsigned type_integer_rank(TypeId type) {
+    return (type - TY_CHAR) / 2 + 1;
+}
+
+static inline bool type_is_float(TypeId type) {
+    return type >= TY_FLOAT && type <= TY_LONG_DOUBLE;
+}
+
+static inline bool type_is_arithmetic(TypeId type) {
+    return type_is_integer(type) || type_is_float(type);
+}
+
+// Width of an integer type on the target
+static inline unsigned type_integer_bits(TypeId type) {
+    switch (type_to_signed(type)) {
+    case TY_CHAR:
+        return 8;
+
+    case TY_SHORT:
+        return 16;
+
+    case TY_INT:
+        return 32;
+
+    case TY_LONG:
+        return type_target_layout.long_bits;
+
+    default:
+        return 64;
+    }
+}
@@ -0,0 +1,52 @@
+// Parses each input and prints its token count and the memory the parser
+// touched while building the tree, which covers the nodes and whatever
+// growing their arrays left behind. Only the parser API that predates the
+// index-based AST is used, so the same program measures both trees.
+//
+// Usage: ast_memory_bench <files...>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "input_file.h"
+#include "parser.h"
+
+static size_t ast_memory_bench_resident(void) {
+    FILE *statm = fopen("/proc/self/statm", "r");
+    unsigned long size = 0;
+    unsigned long resident = 0;
+
+    if (statm == NULL || fscanf(statm, "%lu %lu", &size, &resident) != 2) {
+        fprintf(stderr, "error: cannot read /proc/self/statm\n");
+        exit(1);
+    }
+
+    fclose(statm);
+
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+int main(int argc, const char **argv) {
+    for (int i = 1; i < argc; i++) {
+        InputFile input_file = input_file_read(argv[i]);
+        Arena arena = arena_new(false);
+
+        Parser parser = parser_new(&arena, input_file.file_content,
+                                   input_file.file_length);
+
+        size_t before = ast_memory_bench_resident();
+
+        parser_parse_root(&parser);
+
+        size_t after = ast_memory_bench_resident();
+
+        printf("%zu %zu\n", parser.tokens.count, after - before);
+
+        arena_free(&arena);
+        input_file_free(&input_file);
+    }
+
+    return 0;
+}
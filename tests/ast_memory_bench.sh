@@ -0,0 +1,62 @@
+#!/bin/sh
+# Reports the bytes of syntax tree per source token, for this tree and for
+# the revision before the index-based AST. The harness is built a second time
+# against the sources of that revision, with $CC and llvm-config.
+#
+# Usage: ast_memory_bench.sh <ast_memory_bench> [<baseline revision>]
+
+set -u
+
+ast_memory_bench=$1
+baseline=${2:-2794131^}
+
+tests=$(cd "$(dirname "$0")" && pwd)
+root=$(dirname "$tests")
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# Functions with parameters, locals, calls and nested arithmetic, in the
+# subset of the language both trees parse
+awk 'BEGIN {
+    for (i = 0; i < 20000; i++) {
+        printf "long f%d(long a, long b, double c) {\n", i
+        printf "    long d = a * b + %d - b / 3;\n", i
+        printf "    double e = c * 2.5 - a;\n"
+        printf "    long g = f%d(d, a + b, e) * -d;\n", i
+        printf "    return g + d * a - b;\n"
+        printf "}\n\n"
+    }
+}' > "$work/input.c"
+
+mkdir "$work/baseline"
+
+if ! git -C "$root" archive "$baseline" src |
+    tar -x -C "$work/baseline"; then
+    echo "error: cannot check out the baseline revision $baseline"
+    exit 1
+fi
+
+if ! ${CC:-cc} -O2 -pthread $(llvm-config --cflags) \
+    -I"$work/baseline/src" \
+    $(ls "$work"/baseline/src/*.c | grep -v '/main\.c$') \
+    "$tests/ast_memory_bench.c" -o "$work/baseline_bench" \
+    $(llvm-config --ldflags --libs core target all-targets passes bitwriter \
+                  irreader linker orcjit --system-libs); then
+    echo "error: cannot build the harness against $baseline"
+    exit 1
+fi
+
+echo "                  tokens  tree bytes  bytes/token"
+
+for build in baseline current; do
+    if [ $build = baseline ]; then
+        bench="$work/baseline_bench"
+    else
+        bench=$ast_memory_bench
+    fi
+
+    "$bench" "$work/input.c" | awk -v build="$build" '{
+        printf "%-10s %13d %11d %12.1f\n", build, $1, $2, $2 / $1
+    }'
+done
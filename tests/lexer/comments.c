@@ -0,0 +1,152 @@
+/**/int a;/***/int b;/* * / */int c;
+// line comment at the start
+int d; // trailing comment
+/* a block comment
+   spanning several lines with * and / inside // and /* nested openers
+*/ int e;
+/* comment */ /* after */ /* another one that is a little bit longer */
+//
+///
+//// comment made of slashes ////////////////////////////////////////////////
+/*********************************************************************/
+int f; /* short */ int g; /* a longer comment that crosses a 32 byte boundary */
+//
+//c
+//co
+//com
+//comm
+//comme
+//commen
+//comment
+//comment 
+//comment t
+//comment te
+//comment tex
+//comment text
+//comment text 
+//comment text c
+//comment text co
+//comment text com
+//comment text comm
+//comment text comme
+//comment text commen
+//comment text comment
+//comment text comment 
+//comment text comment t
+//comment text comment te
+//comment text comment tex
+//comment text comment text
+//comment text comment text 
+//comment text comment text c
+//comment text comment text co
+//comment text comment text com
+//comment text comment text comm
+//comment text comment text comme
+//comment text comment text commen
+//comment text comment text comment
+//comment text comment text comment 
+//comment text comment text comment t
+//comment text comment text comment te
+//comment text comment text comment tex
+//comment text comment text comment text
+//comment text comment text comment text 
+//comment text comment text comment text c
+//comment text comment text comment text co
+//comment text comment text comment text com
+//comment text comment text comment text comm
+//comment text comment text comment text comme
+//comment text comment text comment text commen
+//comment text comment text comment text comment
+//comment text comment text comment text comment 
+//comment text comment text comment text comment t
+//comment text comment text comment text comment te
+//comment text comment text comment text comment tex
+//comment text comment text comment text comment text
+//comment text comment text comment text comment text 
+//comment text comment text comment text comment text c
+//comment text comment text comment text comment text co
+//comment text comment text comment text comment text com
+//comment text comment text comment text comment text comm
+//comment text comment text comment text comment text comme
+//comment text comment text comment text comment text commen
+//comment text comment text comment text comment text comment
+//comment text comment text comment text comment text comment 
+//comment text comment text comment text comment text comment t
+//comment text comment text comment text comment text comment te
+//comment text comment text comment text comment text comment tex
+//comment text comment text comment text comment text comment text
+//comment text comment text comment text comment text comment text 
+//comment text comment text comment text comment text comment text c
+//comment text comment text comment text comment text comment text co
+//comment text comment text comment text comment text comment text com
+//comment text comment text comment text comment text comment text comm
+/**/ x0;
+/***/ x1;
+/** */ x2;
+/** b*/ x3;
+/** bl*/ x4;
+/** blo*/ x5;
+/** bloc*/ x6;
+/** block*/ x7;
+/** block/*/ x8;
+/** block/ */ x9;
+/** block/ **/ x10;
+/** block/ * */ x11;
+/** block/ * b*/ x12;
+/** block/ * bl*/ x13;
+/** block/ * blo*/ x14;
+/** block/ * bloc*/ x15;
+/** block/ * block*/ x16;
+/** block/ * block/*/ x17;
+/** block/ * block/ */ x18;
+/** block/ * block/ **/ x19;
+/** block/ * block/ * */ x20;
+/** block/ * block/ * b*/ x21;
+/** block/ * block/ * bl*/ x22;
+/** block/ * block/ * blo*/ x23;
+/** block/ * block/ * bloc*/ x24;
+/** block/ * block/ * block*/ x25;
+/** block/ * block/ * block/*/ x26;
+/** block/ * block/ * block/ */ x27;
+/** block/ * block/ * block/ **/ x28;
+/** block/ * block/ * block/ * */ x29;
+/** block/ * block/ * block/ * b*/ x30;
+/** block/ * block/ * block/ * bl*/ x31;
+/** block/ * block/ * block/ * blo*/ x32;
+/** block/ * block/ * block/ * bloc*/ x33;
+/** block/ * block/ * block/ * block*/ x34;
+/** block/ * block/ * block/ * block/*/ x35;
+/** block/ * block/ * block/ * block/ */ x36;
+/** block/ * block/ * block/ * block/ **/ x37;
+/** block/ * block/ * block/ * block/ * */ x38;
+/** block/ * block/ * block/ * block/ * b*/ x39;
+/** block/ * block/ * block/ * block/ * bl*/ x40;
+/** block/ * block/ * block/ * block/ * blo*/ x41;
+/** block/ * block/ * block/ * block/ * bloc*/ x42;
+/** block/ * block/ * block/ * block/ * block*/ x43;
+/** block/ * block/ * block/ * block/ * block/*/ x44;
+/** block/ * block/ * block/ * block/ * block/ */ x45;
+/** block/ * block/ * block/ * block/ * block/ **/ x46;
+/** block/ * block/ * block/ * block/ * block/ * */ x47;
+/** block/ * block/ * block/ * block/ * block/ * b*/ x48;
+/** block/ * block/ * block/ * block/ * block/ * bl*/ x49;
+/** block/ * block/ * block/ * block/ * block/ * blo*/ x50;
+/** block/ * block/ * block/ * block/ * block/ * bloc*/ x51;
+/** block/ * block/ * block/ * block/ * block/ * block*/ x52;
+/** block/ * block/ * block/ * block/ * block/ * block/*/ x53;
+/** block/ * block/ * block/ * block/ * block/ * block/ */ x54;
+/** block/ * block/ * block/ * block/ * block/ * block/ **/ x55;
+/** block/ * block/ * block/ * block/ * block/ * block/ * */ x56;
+/** block/ * block/ * block/ * block/ * block/ * block/ * b*/ x57;
+/** block/ * block/ * block/ * block/ * block/ * block/ * bl*/ x58;
+/** block/ * block/ * block/ * block/ * block/ * block/ * blo*/ x59;
+/** block/ * block/ * block/ * block/ * block/ * block/ * bloc*/ x60;
+/** block/ * block/ * block/ * block/ * block/ * block/ * block*/ x61;
+/** block/ * block/ * block/ * block/ * block/ * block/ * block/*/ x62;
+/** block/ * block/ * block/ * block/ * block/ * block/ * block/ */ x63;
+/** block/ * block/ * block/ * block/ * block/ * block/ * block/ **/ x64;
+/** block/ * block/ * block/ * block/ * block/ * block/ * block/ * */ x65;
+/** block/ * block/ * block/ * block/ * block/ * block/ * block/ * b*/ x66;
+/** block/ * block/ * block/ * block/ * block/ * block/ * block/ * bl*/ x67;
+/** block/ * block/ * block/ * block/ * block/ * block/ * block/ * blo*/ x68;
+/** block/ * block/ * block/ * block/ * block/ * block/ * block/ * bloc*/ x69;
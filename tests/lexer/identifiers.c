@@ -0,0 +1,119 @@
+int i = 9;
+int id = 99;
+int ide = 999;
+int iden = 9999;
+int ident = 99999;
+int identi = 999999;
+int identif = 9999999;
+int identifi = 99999999;
+int identifie = 999999999;
+int identifier = 9999999999;
+int identifier_ = 99999999999;
+int identifier_0 = 999999999999;
+int identifier_01 = 9999999999999;
+int identifier_012 = 99999999999999;
+int identifier_0123 = 999999999999999;
+int identifier_01234 = 9999999999999999;
+int identifier_012345 = 99999999999999999;
+int identifier_0123456 = 999999999999999999;
+int identifier_01234567 = 999999999999999999;
+int identifier_012345678 = 999999999999999999;
+int identifier_0123456789 = 999999999999999999;
+int identifier_0123456789d = 999999999999999999;
+int identifier_0123456789de = 999999999999999999;
+int identifier_0123456789den = 999999999999999999;
+int identifier_0123456789dent = 999999999999999999;
+int identifier_0123456789denti = 999999999999999999;
+int identifier_0123456789dentif = 999999999999999999;
+int identifier_0123456789dentifi = 999999999999999999;
+int identifier_0123456789dentifie = 999999999999999999;
+int identifier_0123456789dentifier = 999999999999999999;
+int identifier_0123456789dentifier_ = 999999999999999999;
+int identifier_0123456789dentifier_0 = 999999999999999999;
+int identifier_0123456789dentifier_01 = 999999999999999999;
+int identifier_0123456789dentifier_012 = 999999999999999999;
+int identifier_0123456789dentifier_0123 = 999999999999999999;
+int identifier_0123456789dentifier_01234 = 999999999999999999;
+int identifier_0123456789dentifier_012345 = 999999999999999999;
+int identifier_0123456789dentifier_0123456 = 999999999999999999;
+int identifier_0123456789dentifier_01234567 = 999999999999999999;
+int identifier_0123456789dentifier_012345678 = 999999999999999999;
+int identifier_0123456789dentifier_0123456789 = 999999999999999999;
+int identifier_0123456789dentifier_0123456789d = 999999999999999999;
+int identifier_0123456789dentifier_0123456789de = 999999999999999999;
+int identifier_0123456789dentifier_0123456789den = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dent = 999999999999999999;
+int identifier_0123456789dentifier_0123456789denti = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentif = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifi = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifie = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier_ = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier_0 = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier_01 = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier_012 = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier_0123 = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier_01234 = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier_012345 = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier_0123456 = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier_01234567 = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier_012345678 = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier_0123456789 = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier_0123456789d = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier_0123456789de = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier_0123456789den = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier_0123456789dent = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier_0123456789denti = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier_0123456789dentif = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier_0123456789dentifi = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier_0123456789dentifie = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier_0123456789dentifier = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier_0123456789dentifier_ = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier_0123456789dentifier_0 = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier_0123456789dentifier_01 = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier_0123456789dentifier_012 = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier_0123456789dentifier_0123 = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier_0123456789dentifier_01234 = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier_0123456789dentifier_012345 = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier_0123456789dentifier_0123456 = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier_0123456789dentifier_01234567 = 999999999999999999;
+int identifier_0123456789dentifier_0123456789dentifier_0123456789dentifier_012345678 = 999999999999999999;
+double d1 = 1.2e1;
+double d2 = 11.22e2;
+double d3 = 111.222e3;
+double d4 = 1111.2222e4;
+double d5 = 11111.22222e0;
+double d6 = 111111.222222e1;
+double d7 = 1111111.2222222e2;
+double d8 = 11111111.22222222e3;
+double d9 = 111111111.222222222e4;
+double d10 = 1111111111.2222222222e0;
+double d11 = 11111111111.22222222222e1;
+double d12 = 111111111111.222222222222e2;
+double d13 = 1111111111111.2222222222222e3;
+double d14 = 11111111111111.22222222222222e4;
+double d15 = 111111111111111.222222222222222e0;
+double d16 = 1111111111111111.2222222222222222e1;
+double d17 = 11111111111111111.22222222222222222e2;
+double d18 = 111111111111111111.222222222222222222e3;
+double d19 = 1111111111111111111.2222222222222222222e4;
+double d20 = 11111111111111111111.22222222222222222222e0;
+double d21 = 111111111111111111111.222222222222222222222e1;
+double d22 = 1111111111111111111111.2222222222222222222222e2;
+double d23 = 11111111111111111111111.22222222222222222222222e3;
+double d24 = 111111111111111111111111.222222222222222222222222e4;
+double d25 = 1111111111111111111111111.2222222222222222222222222e0;
+double d26 = 11111111111111111111111111.22222222222222222222222222e1;
+double d27 = 111111111111111111111111111.222222222222222222222222222e2;
+double d28 = 1111111111111111111111111111.2222222222222222222222222222e3;
+double d29 = 11111111111111111111111111111.22222222222222222222222222222e4;
+double d30 = 111111111111111111111111111111.222222222222222222222222222222e0;
+double d31 = 1111111111111111111111111111111.2222222222222222222222222222222e1;
+double d32 = 11111111111111111111111111111111.22222222222222222222222222222222e2;
+double d33 = 111111111111111111111111111111111.222222222222222222222222222222222e3;
+double d34 = 1111111111111111111111111111111111.2222222222222222222222222222222222e4;
+double d35 = 11111111111111111111111111111111111.22222222222222222222222222222222222e0;
+double d36 = 111111111111111111111111111111111111.222222222222222222222222222222222222e1;
+double d37 = 1111111111111111111111111111111111111.2222222222222222222222222222222222222e2;
+double d38 = 11111111111111111111111111111111111111.22222222222222222222222222222222222222e3;
+double d39 = 111111111111111111111111111111111111111.222222222222222222222222222222222222222e4;
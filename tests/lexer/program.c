@@ -0,0 +1,14 @@
+// A small program touching every kind of token
+long square(long x) { return x * x; }
+
+/* Unsigned arithmetic wraps */
+unsigned int wrap(unsigned int a, unsigned int b) { return a - b; }
+
+double half(double value) { return value / 2.0; }
+
+int main() {
+    signed char c = 'x' % 7;
+    short s = -3;
+    float f = 1.5e3 + .25;
+    return !square(s) + wrap(1, 2) % 3 + (int)half(f) + c;
+}
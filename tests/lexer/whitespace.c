@@ -0,0 +1,242 @@
+ab;
+ a	b
+
+;
+  a		b
+
+
+
+;
+   a			b
+
+
+;
+    a				b
+;
+     a					b
+
+
+;
+      a						b
+
+;
+       a							b
+
+
+
+;
+        a								b
+
+;
+         ab
+;
+          a	b
+
+
+;
+           a		b
+
+
+
+
+;
+            a			b;
+             a				b
+
+;
+              a					b
+
+
+
+;
+               a						b
+
+
+;
+                a							b
+;
+                 a								b
+
+
+;
+                  ab
+
+;
+                   a	b
+
+
+
+;
+                    a		b
+
+;
+                     a			b
+;
+                      a				b
+
+
+;
+                       a					b
+
+
+
+
+;
+                        a						b;
+                         a							b
+
+;
+                          a								b
+
+
+
+;
+                           ab
+
+
+;
+                            a	b
+;
+                             a		b
+
+
+;
+                              a			b
+
+;
+                               a				b
+
+
+
+;
+                                a					b
+
+;
+                                 a						b
+;
+                                  a							b
+
+
+;
+                                   a								b
+
+
+
+
+;
+                                    ab;
+                                     a	b
+
+;
+                                      a		b
+
+
+
+;
+                                       a			b
+
+
+;
+                                        a				b
+;
+                                         a					b
+
+
+;
+                                          a						b
+
+;
+                                           a							b
+
+
+
+;
+                                            a								b
+
+;
+                                             ab
+;
+                                              a	b
+
+
+;
+                                               a		b
+
+
+
+
+;
+                                                a			b;
+                                                 a				b
+
+;
+                                                  a					b
+
+
+
+;
+                                                   a						b
+
+
+;
+                                                    a							b
+;
+                                                     a								b
+
+
+;
+                                                      ab
+
+;
+                                                       a	b
+
+
+
+;
+                                                        a		b
+
+;
+                                                         a			b
+;
+                                                          a				b
+
+
+;
+                                                           a					b
+
+
+
+
+;
+                                                            a						b;
+                                                             a							b
+
+;
+                                                              a								b
+
+
+
+;
+                                                               ab
+
+
+;
+                                                                a	b
+;
+                                                                 a		b
+
+
+;
+                                                                  a			b
+
+;
+                                                                   a				b
+
+
+
+;
+                                                                    a					b
+
+;
+                                                                     a						b
+;
@@ -0,0 +1,52 @@
+// Lexes each input a few times and prints its size, its token count and the
+// fastest time, so the time per byte can be compared across input sizes
+//
+// Usage: lexer_bench <files...>
+
+#include <stdio.h>
+#include <time.h>
+
+#include "arena.h"
+#include "input_file.h"
+#include "lexer.h"
+
+#define LEXER_BENCH_RUNS 3
+
+static double lexer_bench_seconds(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int main(int argc, const char **argv) {
+    for (int i = 1; i < argc; i++) {
+        InputFile input_file = input_file_read(argv[i]);
+        double best = 0;
+        size_t token_count = 0;
+
+        for (int run = 0; run < LEXER_BENCH_RUNS; run++) {
+            Arena arena = arena_new(false);
+            double start = lexer_bench_seconds();
+
+            Tokens tokens = lexer_tokenize(&arena, input_file.file_content,
+                                           input_file.file_length);
+
+            double elapsed = lexer_bench_seconds() - start;
+
+            if (run == 0 || elapsed < best) {
+                best = elapsed;
+            }
+
+            token_count = tokens.count;
+            arena_free(&arena);
+        }
+
+        printf("%zu %zu %.6f\n", input_file.file_length, token_count, best);
+
+        input_file_free(&input_file);
+    }
+
+    return 0;
+}
@@ -0,0 +1,64 @@
+#!/bin/sh
+# Measures lexing throughput on generated inputs of 1, 10 and 100 MB. The
+# lexer runs in linear time when the time per byte stays flat as the input
+# grows, the benchmark fails when it more than doubles between the smallest
+# and the largest input.
+#
+# Usage: lexer_bench.sh <lexer_bench>
+
+set -u
+
+lexer_bench=$1
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+inputs=""
+
+for megabytes in 1 10 100; do
+    input="$work/input_$megabytes.c"
+
+    # Copies of a function with a comment and a mix of keywords, identifiers,
+    # numbers and operators, renamed on every copy so identifiers do not
+    # repeat
+    awk -v target=$((megabytes * 1024 * 1024)) 'BEGIN {
+        for (i = 0; size < target; i++) {
+            text = sprintf("/* Copy %d of the benchmark function */\n" \
+                           "long bench_%d(long value, unsigned int scale) {\n" \
+                           "    double ratio = 1.5e3 / scale + .25;\n" \
+                           "    long result = value * %d %% 97 - -value;\n" \
+                           "    return result + (long)ratio; // Truncated\n" \
+                           "}\n\n", i, i, i)
+            printf "%s", text
+            size += length(text)
+        }
+    }' > "$input"
+
+    inputs="$inputs $input"
+done
+
+echo "    bytes     tokens   seconds     MB/s  ns/byte"
+
+"$lexer_bench" $inputs | awk '
+{
+    ns_per_byte = $3 * 1e9 / $1
+    printf "%9d %10d %9.4f %8.1f %8.3f\n", $1, $2, $3,
+           $1 / 1048576 / $3, ns_per_byte
+
+    if (NR == 1) {
+        first = ns_per_byte
+    }
+
+    last = ns_per_byte
+}
+END {
+    if (NR == 0) {
+        exit 1
+    }
+
+    if (last > 2 * first) {
+        printf "FAIL: %.3f ns/byte at the largest input, %.3f at the " \
+               "smallest\n", last, first
+        exit 1
+    }
+}'
@@ -0,0 +1,67 @@
+#!/bin/sh
+# Lexes every corpus file with each set of scanning kernels the CPU supports
+# and compares the tokens with those of the scalar kernels. Every file is
+# lexed behind 0 to 63 leading spaces, so its tokens meet the 16 and 32 byte
+# boundaries of the vectorized loads at every offset, and a token longer than
+# TOKEN_MAX_LENGTH is added to the corpus.
+#
+# Usage: lexer_scan_check.sh <ycc> <corpus files...>
+
+set -u
+
+ycc=$1
+shift
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# 70000 characters, longer than TOKEN_MAX_LENGTH
+awk 'BEGIN { s = "int "; for (i = 0; i < 7000; i++) s = s "identifier"; \
+             print s " = 1; int after;" }' > "$work/long_token.c"
+
+kernels=""
+
+for candidate in sse2 avx2; do
+    if echo | YCC_LEXER_SCAN=$candidate "$ycc" --dump-tokens - \
+        > /dev/null 2>&1; then
+        kernels="$kernels $candidate"
+    else
+        echo "skipping $candidate kernels, not supported here"
+    fi
+done
+
+failures=0
+checks=0
+
+for file in "$@" "$work/long_token.c"; do
+    inputs=""
+    shift_count=0
+
+    while [ $shift_count -lt 64 ]; do
+        input="$work/shifted_$shift_count.c"
+
+        printf "%${shift_count}s" "" > "$input"
+        cat "$file" >> "$input"
+
+        inputs="$inputs $input"
+        shift_count=$((shift_count + 1))
+    done
+
+    # One run lexes every shifted copy, their dumps follow each other
+    YCC_LEXER_SCAN=scalar "$ycc" --dump-tokens $inputs > "$work/scalar"
+
+    for kernel in $kernels; do
+        YCC_LEXER_SCAN=$kernel "$ycc" --dump-tokens $inputs > "$work/$kernel"
+        checks=$((checks + 1))
+
+        if ! cmp -s "$work/scalar" "$work/$kernel"; then
+            echo "FAIL: $file, $kernel kernels differ from scalar"
+            diff "$work/scalar" "$work/$kernel" | head -n 10
+            failures=$((failures + 1))
+        fi
+    done
+done
+
+echo "$checks comparisons, $failures failed"
+
+[ $failures -eq 0 ]
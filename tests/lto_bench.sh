@@ -0,0 +1,84 @@
+#!/bin/sh
+# Builds the program of lto_bench_modules.sh per unit, with full LTO and with
+# ThinLTO, and prints the build time and the best of five run times of each.
+# Every build starts from an empty cache, ThinLTO is then built again with
+# every backend cached. All builds must compute the same result.
+#
+# Usage: lto_bench.sh <ycc> [<ycc options...>]
+
+set -u
+
+ycc=$1
+shift
+
+tests=$(cd "$(dirname "$0")" && pwd)
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+"$tests/lto_bench_modules.sh" "$work/src"
+
+sources=$(ls "$work"/src/*.c)
+
+lto_bench_now() {
+    date +%s%N
+}
+
+# Prints the elapsed seconds since the given lto_bench_now
+lto_bench_since() {
+    echo "$1 $(lto_bench_now)" | awk '{ printf "%.3f", ($2 - $1) / 1e9 }'
+}
+
+failures=0
+expected=""
+
+echo "build             build s    run s  result"
+
+for build in per-unit full-lto thinlto thinlto-cached; do
+    case $build in
+    per-unit) options="" ;;
+    full-lto) options="-flto" ;;
+    *) options="-flto=thin" ;;
+    esac
+
+    if [ $build != thinlto-cached ]; then
+        export YCC_CACHE_DIR="$work/cache-$build"
+    fi
+
+    start=$(lto_bench_now)
+
+    if ! "$ycc" -O2 $options "$@" $sources -o "$work/$build" \
+        > "$work/output" 2>&1; then
+        echo "FAIL: the $build build does not compile"
+        head -n 10 "$work/output"
+        failures=$((failures + 1))
+        continue
+    fi
+
+    build_time=$(lto_bench_since "$start")
+
+    best=""
+
+    for run in 1 2 3 4 5; do
+        start=$(lto_bench_now)
+        "$work/$build"
+        result=$?
+        run_time=$(lto_bench_since "$start")
+
+        if [ -z "$best" ] ||
+            [ "$(echo "$run_time $best" | awk '{ print $1 < $2 }')" = 1 ]; then
+            best=$run_time
+        fi
+    done
+
+    printf "%-16s %8s %8s %7d\n" $build "$build_time" "$best" $result
+
+    if [ -z "$expected" ]; then
+        expected=$result
+    elif [ "$result" != "$expected" ]; then
+        echo "FAIL: the $build build computes $result, not $expected"
+        failures=$((failures + 1))
+    fi
+done
+
+[ $failures -eq 0 ]
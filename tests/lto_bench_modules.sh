@@ -0,0 +1,51 @@
+#!/bin/sh
+# Writes the program the link-time optimization benchmark builds: 48 modules
+# of 150 functions each, m0.c to m47.c, and main.c. The functions form 24
+# levels of 300. Each one calls two functions of the next level, which
+# usually live in other modules, so the calls only inline with cross-module
+# optimization. main calls the first function, which makes 2^24 calls in
+# total.
+#
+# Usage: lto_bench_modules.sh <directory>
+
+set -u
+
+directory=$1
+
+mkdir -p "$directory"
+
+awk -v directory="$directory" 'BEGIN {
+    modules = 48
+    levels = 24
+    width = 300
+
+    for (level = 0; level < levels; level++) {
+        for (slot = 0; slot < width; slot++) {
+            index_ = level * width + slot
+            file = sprintf("%s/m%d.c", directory, index_ % modules)
+
+            if (level + 1 == levels) {
+                printf "long f%d(long x) { return x * %d %% 1009 + %d; }\n\n",
+                       index_, slot + 3, level >> file
+                continue
+            }
+
+            first = (level + 1) * width + slot * 2 % width
+            second = (level + 1) * width + (slot * 2 + 1) % width
+
+            printf "long f%d(long x);\nlong f%d(long x);\n\n",
+                   first, second >> file
+            printf "long f%d(long x) {\n", index_ >> file
+            printf "    long y = x * %d %% 65521;\n", slot + 2 >> file
+            printf "    return f%d(y + 1) + f%d(y - %d) %% 257;\n",
+                   first, second, level >> file
+            printf "}\n\n" >> file
+        }
+    }
+
+    file = directory "/main.c"
+    printf "long f0(long x);\n\n" > file
+    printf "// Read at run time, so nothing is folded into main\n" >> file
+    printf "long seed = 7;\n\n" >> file
+    printf "int main() { return f0(seed) %% 256; }\n" >> file
+}'
@@ -0,0 +1,73 @@
+#!/bin/sh
+# Compares the preprocessing time of ycc -E with cpp on units that include
+# <stdio.h>, <stdlib.h> and <string.h>. One unit measures a cold header
+# cache. Twenty units are preprocessed by one ycc invocation, where every
+# unit after the first is served from the header cache, and by twenty cpp
+# runs. Each time is the best of five.
+#
+# Usage: preprocessor_bench.sh <ycc> [<cpp>]
+
+set -u
+
+ycc=$1
+cpp=${2:-cpp}
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# The system headers need the compiler's own stddef.h and stdarg.h
+include=$("$cpp" -print-file-name=include)
+
+units=""
+
+for unit in $(seq 1 20); do
+    printf '#include <stdio.h>\n#include <stdlib.h>\n#include <string.h>\n' \
+        > "$work/unit_$unit.c"
+    printf 'long unit_%d = %d;\n' $unit $unit >> "$work/unit_$unit.c"
+
+    units="$units $work/unit_$unit.c"
+done
+
+preprocessor_bench_now() {
+    date +%s%N
+}
+
+# Runs the command five times and prints its best time in milliseconds
+preprocessor_bench_best() {
+    best=""
+
+    for run in 1 2 3 4 5; do
+        start=$(preprocessor_bench_now)
+
+        if ! "$@" > /dev/null 2> "$work/output"; then
+            echo "FAIL: $*" >&2
+            head -n 10 "$work/output" >&2
+            exit 1
+        fi
+
+        elapsed=$((($(preprocessor_bench_now) - start) / 1000))
+
+        if [ -z "$best" ] || [ $elapsed -lt $best ]; then
+            best=$elapsed
+        fi
+    done
+
+    echo $best | awk '{ printf "%.1f", $1 / 1000 }'
+}
+
+# cpp takes one unit per run
+preprocessor_bench_cpp_all() {
+    for unit in $units; do
+        "$cpp" "$unit" || return 1
+    done
+}
+
+ycc_one=$(preprocessor_bench_best "$ycc" -E -I"$include" "$work/unit_1.c") ||
+    exit 1
+cpp_one=$(preprocessor_bench_best "$cpp" "$work/unit_1.c") || exit 1
+ycc_all=$(preprocessor_bench_best "$ycc" -E -I"$include" $units) || exit 1
+cpp_all=$(preprocessor_bench_best preprocessor_bench_cpp_all) || exit 1
+
+echo "units    ycc ms    cpp ms"
+printf "%5d %9s %9s\n" 1 "$ycc_one" "$cpp_one"
+printf "%5d %9s %9s\n" 20 "$ycc_all" "$cpp_all"
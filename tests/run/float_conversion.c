@@ -0,0 +1,15 @@
+// 2^53 + 2^30 + 1 rounds to 2^53 + 2^30 as a float, but to 2^53 when it is
+// rounded to double first, so the folded and run time conversions must both
+// round once
+float folded = 9007199791611905;
+float folded_sum = 9007199791611904 + 1;
+
+int main() {
+    long value = 9007199791611905;
+    float converted = value;
+    float difference = converted - folded;
+    float sum_difference = converted - folded_sum;
+    int result = difference / 1073741824 + sum_difference / 1073741824;
+
+    return result;
+}
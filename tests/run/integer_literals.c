@@ -0,0 +1,17 @@
+// Constants take the first type of C11 6.4.4.1 that holds them, so the
+// largest unsigned long is unsigned and wraps to 1, folded and at run time,
+// and 4294967295u is an unsigned int which wraps to 0
+unsigned long largest = 18446744073709551615u;
+unsigned long folded = 18446744073709551615u + 2;
+
+int main() {
+    unsigned long wrapped = largest + 2;
+    long hexadecimal = 0x10;
+    int octal = 010;
+    long long wide = 4294967296LL;
+    unsigned int unsigned_int = 4294967295u;
+    unsigned long sum = unsigned_int + 1u;
+    long wide_count = wide / 4294967296;
+
+    return wrapped + folded + hexadecimal + octal + wide_count + sum - 27;
+}
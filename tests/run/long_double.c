@@ -0,0 +1,12 @@
+// long double is wider than double on the x86 and most 64-bit targets, where
+// it holds 2^53 + 1 exactly, and long is as wide as a pointer
+long big = 1099511627776;
+
+int main() {
+    long value = 9007199254740993;
+    long double wide = value;
+    long back = wide;
+    long scaled = big / 1048576;
+
+    return back - value + scaled - 1048576;
+}
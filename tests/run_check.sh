@@ -0,0 +1,40 @@
+#!/bin/sh
+# Compiles and runs every test program, each exits with status 0 when the
+# values it computes, some folded at compile time and some at run time,
+# agree.
+#
+# Usage: run_check.sh <ycc> <test programs...>
+
+set -u
+
+ycc=$1
+shift
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+failures=0
+checks=0
+
+for file in "$@"; do
+    checks=$((checks + 1))
+
+    if ! "$ycc" "$file" -o "$work/program" > "$work/output" 2>&1; then
+        echo "FAIL: $file does not compile"
+        head -n 10 "$work/output"
+        failures=$((failures + 1))
+        continue
+    fi
+
+    "$work/program"
+    status=$?
+
+    if [ $status -ne 0 ]; then
+        echo "FAIL: $file exits with status $status"
+        failures=$((failures + 1))
+    fi
+done
+
+echo "$checks programs, $failures failed"
+
+[ $failures -eq 0 ]
@@ -0,0 +1,152 @@
+// Defines a number of global symbols, looks each of them up in a scattered
+// order, then shadows them all in a block scope, looks them up again and
+// leaves the scope. Prints the time per symbol of each phase, with O(1)
+// operations it only grows with the cache misses of a larger table.
+//
+// Usage: symbol_table_bench [<symbol count>]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "interner.h"
+#include "symbol_table.h"
+#include "type.h"
+
+static double symbol_table_bench_seconds(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void symbol_table_bench_report(const char *phase, double start,
+                                      uint32_t count) {
+    double elapsed = symbol_table_bench_seconds() - start;
+
+    printf("%-8s %9.4f s %8.1f ns/symbol\n", phase, elapsed,
+           elapsed * 1e9 / count);
+}
+
+// Visits every index once in an order unrelated to the definition order, the
+// step is odd and the count a power of two
+static uint32_t symbol_table_bench_scatter(uint32_t i, uint32_t mask) {
+    return (i * 2654435761u) & mask;
+}
+
+int main(int argc, const char **argv) {
+    uint32_t count = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 1000000;
+    uint32_t scatter_size = 1;
+
+    while (scatter_size < count) {
+        scatter_size *= 2;
+    }
+
+    Atom *atoms = malloc(count * sizeof(Atom));
+
+    if (atoms == NULL) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    double start = symbol_table_bench_seconds();
+
+    for (uint32_t i = 0; i < count; i++) {
+        char text[32];
+        int length = snprintf(text, sizeof(text), "symbol_%u", i);
+
+        atoms[i] = interner_intern(text, length);
+    }
+
+    symbol_table_bench_report("intern", start, count);
+
+    SymbolTable symbol_table = symbol_table_new();
+
+    start = symbol_table_bench_seconds();
+
+    for (uint32_t i = 0; i < count; i++) {
+        Symbol symbol = {.type = TY_INT,
+                         .name = {.atom = atoms[i]},
+                         .linkage = SL_GLOBAL,
+                         .id = i,
+                         .defined = true};
+
+        symbol_table_set(&symbol_table, symbol);
+    }
+
+    symbol_table_bench_report("define", start, count);
+
+    start = symbol_table_bench_seconds();
+
+    for (uint32_t i = 0; i < scatter_size; i++) {
+        uint32_t index = symbol_table_bench_scatter(i, scatter_size - 1);
+
+        if (index >= count) {
+            continue;
+        }
+
+        Symbol *symbol =
+            symbol_table_find(&symbol_table, SN_ORDINARY, atoms[index]);
+
+        if (symbol == NULL || symbol->id != index) {
+            fprintf(stderr, "error: symbol %u not found\n", index);
+            return 1;
+        }
+    }
+
+    symbol_table_bench_report("lookup", start, count);
+
+    start = symbol_table_bench_seconds();
+
+    symbol_table_push_scope(&symbol_table);
+
+    for (uint32_t i = 0; i < count; i++) {
+        Symbol symbol = {.type = TY_INT,
+                         .name = {.atom = atoms[i]},
+                         .linkage = SL_LOCAL,
+                         .id = count + i,
+                         .defined = true};
+
+        symbol_table_set(&symbol_table, symbol);
+    }
+
+    symbol_table_bench_report("shadow", start, count);
+
+    start = symbol_table_bench_seconds();
+
+    for (uint32_t i = 0; i < count; i++) {
+        Symbol *symbol =
+            symbol_table_find(&symbol_table, SN_ORDINARY, atoms[i]);
+
+        if (symbol == NULL || symbol->id != count + i) {
+            fprintf(stderr, "error: local symbol %u not found\n", i);
+            return 1;
+        }
+    }
+
+    symbol_table_bench_report("local", start, count);
+
+    start = symbol_table_bench_seconds();
+
+    symbol_table_pop_scope(&symbol_table);
+
+    symbol_table_bench_report("pop", start, count);
+
+    // Leaving the scope uncovers the globals again
+    for (uint32_t i = 0; i < count; i++) {
+        Symbol *symbol =
+            symbol_table_find(&symbol_table, SN_ORDINARY, atoms[i]);
+
+        if (symbol == NULL || symbol->id != i) {
+            fprintf(stderr, "error: symbol %u not restored\n", i);
+            return 1;
+        }
+    }
+
+    symbol_table_free(&symbol_table);
+    free(atoms);
+
+    return 0;
+}